@@ -34,13 +34,30 @@
 #include <string.h>
 #include <ctype.h>
 #include <time.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/stat.h>
 #ifdef _WIN32 // for Windows OS only
 #include <conio.h>
+#include <io.h>
 void clrscr(void) { // clear the screen terminal
     system("cls");
 }
 #elif __linux__ // for Linux OS only
 #include <termios.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
 void clrscr(void) // clear the screen terminal
 {
     system("clear");
@@ -79,10 +96,92 @@ char getche(void)
 // Define constants
 #define TIME_SIZE 50
 #define MAX_NAME 250
-#define PRODUCTRECORDS "product_records.bin"
-#define TELLERRECORDS "teller_records.bin"
-#define SALERECORDS "sale_records.bin"
+#define PRODUCTRECORDS "product_records.dat"
+#define PRODUCTSTRINGS "product_strings.dat"
+#define TELLERRECORDS "teller_records.dat"
+#define TELLERSTRINGS "teller_strings.dat"
+#define LEGACYPRODUCTRECORDS "product_records.bin" // fixed-size Product records of older versions
+#define LEGACYTELLERRECORDS "teller_records.bin" // fixed-size Teller records of older versions
+#define LEGACYSALERECORDS "sale_records.bin" // sale transactions with a full Product copy of older versions
+#define SALESEGMENTS "sale_segments.dat" // catalog of the monthly sale segments, its header holds the sale ID sequence
+#define SALESEGMENT "sale_records_%s.dat" // sale line items of one month, %s is the month as YYYY-MM
+#define SALEHEADERSEGMENT "sale_headers_%s.dat" // sale headers of one month, %s is the month as YYYY-MM
+#define PRODUCTINDEX "product_index.dat" // hash index from product ID to product record slot
+#define PRODUCTTRIGRAMS "product_trigrams.dat" // trigram posting log of the product names
+#define TELLERTRIGRAMS "teller_trigrams.dat" // trigram posting log of the teller names
 #define SALETRANSACTIONS "%s_sale_transaction.txt"
+#define DELETED_ID -1 // id of a deleted (tombstoned) record slot until it is compacted
+#define RECORD_MAGIC 0x534F5052 // 'RPOS' at the start of every records file
+#define SCHEMA_VERSION 1 // version of the records file formats
+#define INDEX_MAGIC 0x58444950 // 'PIDX' at the start of every hash index file
+#define INDEX_MIN_CAPACITY 64 // least count of slots of a hash index
+#define EMPTY_ID 0 // id of an empty hash index slot, IDs start at 1
+#define TRIGRAM_REMOVED 0x80000000u // flag of a trigram posting removing the record from the posting list
+#define TRIGRAM_COMPACT_MIN 4096 // least count of postings of a posting log before it is compacted
+#define TRIGRAM_DEAD_RATIO 1 // a posting log is compacted once it has this many dead postings per live one
+#define MAX_STRINGS 4 // most string offsets in a record
+#define MAX_TRIGRAMS (MAX_STRINGS * MAX_NAME) // most distinct trigrams of the strings of a record
+#define ARENA_BLOCK_SIZE (64 * 1024) // least size of an arena block
+#define ARENA_HEADER_SIZE ((sizeof(ArenaBlock) + 15) & ~(size_t)15) // size of an arena block header, keeps the buffers aligned
+#define WALFILE "pos_wal.dat" // write-ahead log of the transactions not yet checkpointed
+#define WAL_MAGIC 0x4C415750 // 'PWAL' at the start of every transaction frame of the write-ahead log
+#define WAL_CHECKPOINT_SIZE (256 * 1024) // checkpoint the write-ahead log once it grows past this size
+#define WAL_MAX_LOCKS 16 // most records files locked by one transaction
+#define WAL_RENAME -1 // offset of a logged write that renames the file named by its data to its data file
+#define LANELOCK "pos_lanes.lock" // locked shared by every running lane, exclusive while one lane reclaims the deleted records
+#define DURABILITY_FSYNC 0 // sync the write-ahead log before every durable commit is applied
+#define DURABILITY_GROUP 1 // sync the write-ahead log once for a group of commits, at the latest groupms after the last sync
+#define DURABILITY_NONE 2 // never sync, a system crash may lose the commits and leave them partly applied
+#define GROUP_COMMIT_MS 50 // default longest time between the syncs of a group commit
+#define GROUP_COMMIT_COUNT 16 // default most commits between the syncs of a group commit
+#define MONEY_SIZE 24 // size of the buffer of an amount formatted by formatMoney()
+#define MONEY_CHUNK 256 // count of line items gathered into columns per call of sumAmounts()
+#define BATCH_LINE_SIZE (MAX_NAME * 6) // longest command line of a batch file
+#define BATCH_FIELDS 8 // most fields of a batch command
+#define BATCH_GROUP_COUNT 256 // most batch commands between the syncs of the write-ahead log
+#define CSV_BUFFER_SIZE (256 * 1024) // size of the read buffer of a CSV file and of the write buffers of an import or export
+#define CSV_ROW_SIZE (MAX_NAME * 8) // longest row of a CSV file
+#define CSV_MAX_FIELDS 8 // most fields of a CSV row
+#define IMPORT_BLOCK 4096 // count of imported records written at once
+#define SALE_PAGE_SIZE 20 // count of sales displayed per page
+#define OUTPUT_MIN_CAPACITY 4096 // least size of the output buffer once allocated
+#define ALIGN_LEFT 0 // text of a table cell starts at its left edge
+#define ALIGN_CENTER 1 // text of a table cell is centered, the extra space of an odd padding goes to the left
+#define ALIGN_RIGHT 2 // text of a table cell ends at its right edge
+#define CELL_TEXT 0 // table cell of a string
+#define CELL_ID 1 // table cell of an ID, zero padded to 8 digits
+#define CELL_MONEY 2 // table cell of an amount in cents
+#define CELL_NUMBER 3 // table cell of an integer
+#define CART_MIN_CAPACITY 16 // least count of line items of a cart once allocated
+#define RECEIPT_SCREEN_ITEMS 10 // most line items of the receipt shown on screen while adding items
+#define RECEIPT_QUEUE_SIZE 64 // most receipts waiting for the receipt writer thread
+#define RECEIPT_BUFFER_SIZE (64 * 1024) // size of the write buffer of the daily transaction file
+#define SERVERSOCKET "pos.sock" // Unix domain socket of the POS server shared by the lanes
+#define SERVER_MAX_EVENTS 64 // most socket events handled per wakeup of the POS server
+#define SERVER_READ_SIZE (16 * 1024) // least room for the bytes read at once from a lane
+#define SERVER_MAX_PAYLOAD (1024 * 1024) // largest payload of a request, a checkout of about 30000 line items
+#define SERVER_PRODUCT 1 // request: look up a product by ID | reply: Product
+#define SERVER_TELLER 2 // request: look up a teller by ID | reply: Teller
+#define SERVER_ALLOCATE 3 // request: allocate id consecutive sale IDs | reply: the first ID as status
+#define SERVER_CHECKOUT 4 // request: SaleHeader followed by its line items | reply: SaleHeader as appended
+#define SCAN_CHUNK 65536 // count of line items aggregated by a scan worker at a time
+#define SCAN_MAX_THREADS 64 // most worker threads of a scan
+#define SCAN_ALIGN 64 // alignment of the partial aggregates of the scan workers, the size of a cache line
+#define SECONDS_PER_DAY 86400 // length of a day without a daylight saving change
+#define REPORT_PRODUCT 1 // revenue per product
+#define REPORT_CATEGORY 2 // revenue per category
+#define REPORT_DAY 3 // revenue per day
+#define SALEAGGREGATES "sale_aggregates.dat" // running totals of the sales per product, day, hour and teller, updated by every checkout
+#define AGGREGATE_MAGIC 0x47474153 // 'SAGG' at the start of the sale aggregates file
+#define AGGREGATE_PRODUCT 1 // totals of a product since its first sale
+#define AGGREGATE_DAY 2 // totals of a day
+#define AGGREGATE_HOUR 3 // totals of an hour of a day
+#define AGGREGATE_TELLER 4 // totals of a teller in a day
+#define STOCKRECORDS "stock_records.dat" // units on hand per product, the stock of a product is in the slot of its ID
+#define STOCK_ADD 1 // add units to the stock, negative to remove them
+#define STOCK_COUNT 2 // set the units on hand to the units counted
+#define STOCK_REORDER 3 // set the reorder level of the stock
+#define STOCK_MIN_CHANGES 64 // least count of the changes of a delivery manifest once allocated
 
 // Define Structures
 typedef struct {
@@ -91,8 +190,17 @@ typedef struct {
     char description[MAX_NAME]; // description of product
     char category[MAX_NAME]; // category of product
     char unit[MAX_NAME]; // unit of product
-    float unit_price; // unit price of product
+    long long unit_price; // unit price of product in cents
+    int version; // version of the product record, incremented on each update
 } Product; // Product Details
+typedef struct {
+    int id; // id of product
+    char name[MAX_NAME]; // name of product
+    char description[MAX_NAME]; // description of product
+    char category[MAX_NAME]; // category of product
+    char unit[MAX_NAME]; // unit of product
+    float unit_price; // unit price of product
+} LegacyProduct; // Product Details of older versions, as stored in LEGACYPRODUCTRECORDS and LEGACYSALERECORDS
 typedef struct {
     int id; // Teller id
     char first_name[MAX_NAME]; // first name of teller
@@ -101,20 +209,375 @@ typedef struct {
 } Teller; // Teller Details
 typedef struct {
     int id; // sale id
-    Product product; // product item
+    int product_id; // id of product item, its details are read from the product records
+    int product_version; // version of the product record when sold; 0 if unknown
     int quantity; // quantity of product item
-} SaleTransaction; // Sale Transaction with teller details & Item bought
+    long long unit_price; // unit price of product item in cents when sold
+    long long timestamp; // time of the sale in seconds since the epoch; 0 if unknown
+} SaleTransaction; // Sale Transaction line item, stored in the sale segment of its month
+typedef struct {
+    int id; // transaction id, from the same sequence as the sale ids of the line items
+    int teller_id; // id of the teller of the transaction; 0 if none
+    int first_item; // slot of the first line item in the sale segment of the same month
+    int item_count; // count of line items, stored in consecutive slots
+    long long timestamp; // time of the transaction in seconds since the epoch
+    long long total; // total payable amount in cents
+    long long cash; // cash given in cents
+    long long change; // change given back in cents
+} SaleHeader; // Sale Transaction header, stored in the sale header segment of its month
+typedef struct {
+    int id; // sale id
+    LegacyProduct product; // product item
+    int quantity; // quantity of product item
+} LegacySaleTransaction; // Sale Transaction with a full Product copy of older versions
+// On-disk records: the strings are kept in a string heap file and the record only holds their offsets.
+// Each heap entry is an unsigned short length followed by the characters and a null character.
+// The string offsets always follow the id so compactRecords() can rewrite them generically.
+typedef struct {
+    int id; // id of product
+    int name; // heap offset of the name of product
+    int description; // heap offset of the description of product
+    int category; // heap offset of the category of product
+    int unit; // heap offset of the unit of product
+    int version; // incremented each time the product is updated
+    long long unit_price; // unit price of product in cents
+} ProductRecord; // Product Details record in PRODUCTRECORDS
+typedef struct {
+    int id; // Teller id
+    int first_name; // heap offset of the first name of teller
+    int middle_name; // heap offset of the middle name of teller
+    int last_name; // heap offset of the last name of teller
+} TellerRecord; // Teller Details record in TELLERRECORDS
+typedef struct {
+    unsigned int magic; // RECORD_MAGIC
+    unsigned short schema_version; // SCHEMA_VERSION of the records file
+    unsigned short record_size; // size of each record/row
+    int count; // count of record slots, including the deleted ones
+    int deleted; // count of deleted record slots not yet compacted
+    int next_id; // next ID to allocate, IDs of deleted records are never reused
+    unsigned int checksum; // checksum of the fields above
+} RecordFileHeader; // Header at the start of every records file (not of the string heaps)
+typedef struct {
+    unsigned int magic; // INDEX_MAGIC
+    unsigned short schema_version; // SCHEMA_VERSION of the index file
+    unsigned short record_size; // size of each IndexEntry
+    int count; // count of slots, a power of 2
+    int used; // count of live entries
+    int deleted; // count of removed entries still taking a slot
+    unsigned int checksum; // checksum of the fields above
+} IndexFileHeader; // Header of a hash index file, starts with the same fields as RecordFileHeader
+typedef struct {
+    int id; // record ID; EMPTY_ID if the slot was never used, DELETED_ID if removed
+    int slot; // slot index of the record in its records file
+} IndexEntry; // Open addressing (linear probing) hash index slot
+typedef struct {
+    int slot; // slot index of the record in its records file
+    unsigned int trigram; // three case-folded characters, with TRIGRAM_REMOVED if the record no longer has it
+} TrigramPosting; // Entry of a trigram posting log, a records file appended on add, update and delete
+typedef struct {
+    int max_id; // highest sale id of the segment, first so a rebuilt catalog header resumes the sale ID sequence after it
+    int min_id; // lowest sale id of the segment
+    int month; // month of the segment as YYYYMM; 0 for the undated sales of older versions
+    int count; // count of line items in the segment
+    long long min_time; // time of the first sale of the segment
+    long long max_time; // time of the last sale of the segment
+} SaleSegment; // Entry of the sale segment catalog, read to skip the segments outside of a queried time range
+typedef struct {
+    unsigned int magic; // WAL_MAGIC
+    unsigned int size; // size of the writes following the frame header
+    unsigned int checksum; // checksum of the writes
+} WalFrameHeader; // Header of one committed transaction in WALFILE
+typedef struct {
+    long long offset; // byte offset of the write in the data file
+    int size; // size of the written data
+    int namelength; // length of the data file name following this header, the data follows the name
+} WalWrite; // One data file write of a transaction in WALFILE
+typedef struct {
+    FILE * fp; // open WALFILE; NULL if the writes are applied without logging
+    int durability; // DURABILITY_FSYNC | DURABILITY_GROUP | DURABILITY_NONE
+    int groupms; // group commit: longest time in ms between syncs
+    int groupcount; // group commit: most commits between syncs
+    int pending; // durable commits not yet synced
+    long long lastsync; // time of the last sync in ms
+    int depth; // nesting depth of the open transaction; 0 if none
+    int failed; // the open transaction was aborted
+    int renaming; // the open transaction renames files, its frame is synced before it is applied
+    char * buffer; // frame of the open transaction
+    size_t length; // size of the frame so far
+    size_t capacity; // allocated size of the frame buffer
+    FILE * locks[WAL_MAX_LOCKS]; // locked records files released when the transaction ends
+    int lockcount; // count of locked records files
+#ifdef __linux__
+    pthread_mutex_t mutex; // guards the log file, pending and lastsync against the flusher thread
+    pthread_cond_t wake; // wakes the flusher thread when a group commit is pending or the log is closed
+    pthread_t flusher; // flusher thread, syncs the pending group commits once their deadline has passed
+    int flushing; // 1 - the flusher thread is running
+#endif
+} WriteAheadLog; // Write-ahead log and its open transaction
+typedef struct {
+    const char * filename; // records file of the view
+    int recordsize; // size of each record/row
+    int headersize; // size of the file header before the records; 0 for string heaps
+    unsigned int magic; // magic number of the file header
+    void * map; // start of the mapped file; NULL if not mapped
+    const RecordFileHeader * header; // header of the mapped records file; NULL for string heaps
+    void * base; // start of the records (read-only)
+    size_t size; // size in bytes of the mapped file
+    int count; // count of records in the view
+    long long inode; // file identity of the mapping, changes when the file is replaced by compactRecords()
+} RecordView; // Read-only view of a records file as a typed array
+typedef struct {
+    unsigned int trigram; // three case-folded characters; 0 if the table slot is empty
+    int count; // count of record slots in the list
+    int capacity; // allocated count of record slots
+    int * slots; // sorted record slots having the trigram
+} PostingList; // Record slots having one trigram
+typedef struct {
+    RecordView view; // view of the trigram posting log
+    PostingList * lists; // open addressing table of the posting lists by trigram
+    int capacity; // count of table slots, a power of 2
+    int used; // count of posting lists in the table
+    int applied; // count of postings of the log applied to the posting lists
+    int live; // count of record slots in all the posting lists
+    long long inode; // file identity of the posting log the lists were built from
+} TrigramIndex; // In-memory posting lists of a trigram posting log
+typedef struct ArenaBlock {
+    struct ArenaBlock * next; // next block of the arena
+    size_t size; // size in bytes of the buffers area following the block header
+    size_t used; // bytes of the buffers area given out
+} ArenaBlock; // Block of an arena
+typedef struct {
+    ArenaBlock * first; // first block; NULL if no block was allocated yet
+    ArenaBlock * current; // block the buffers are taken from
+} Arena; // Bump allocator of the buffers of one operation, all freed at once by arenaReset()
+typedef struct {
+    RecordView * records; // records file view
+    RecordView * strings; // string heap view of the records
+    RecordView * index; // hash index view of the records; NULL if the records have no index
+    long long mtime; // modification time in nanoseconds of the records file when the views were refreshed
+    long long size; // size of the records file when the views were refreshed
+    long long inode; // file identity of the records file when the views were refreshed
+    long long checked; // wall-clock time in seconds when the views were refreshed
+} Catalog; // Process-wide cache of the views of a records file, refreshed only when the records file has changed
+typedef struct {
+    FILE * fp; // open CSV file
+    char buffer[CSV_BUFFER_SIZE]; // block of the file being parsed
+    size_t length; // count of bytes in the buffer
+    size_t pos; // next byte of the buffer to parse
+    int line; // line of the file where the last row read starts
+    int next; // line of the file where the next row starts
+    char row[CSV_ROW_SIZE]; // fields of the last row read, each ending with a null character
+} CsvReader; // Buffered reader of the rows of a CSV file
+typedef struct {
+    int * ids; // open addressing table of the IDs; EMPTY_ID if the slot is empty
+    int capacity; // count of table slots, a power of 2
+    int used; // count of IDs in the table
+} IdSet; // Hash set of record IDs
+typedef struct {
+    SaleSegment * segments; // sale segments overlapping the time range, sorted by month
+    int segmentCount; // count of segments
+    int segment; // index of the segment of the cursor position
+    int slot; // slot of the cursor position in its segment, the next sale read is at or after it
+    long long from; // start of the time range
+    long long to; // end of the time range (inclusive)
+    int product_id; // only the sales of this product; 0 for all the sales
+    int mapped; // index of the mapped segment; -1 if none
+    char filename[MAX_NAME]; // file of the mapped segment
+    RecordView view; // view of the mapped segment, only one segment is mapped at a time
+} SaleCursor; // Position in the sales of a time range, read one sale at a time
+typedef struct {
+    size_t partialSize; // size of the partial aggregate of each worker, zeroed before the scan
+    void (* scan)(void * partial, const SaleTransaction * sales, int count, const void * context); // aggregate line items into a partial aggregate
+    void (* merge)(void * total, const void * partial, const void * context); // add a partial aggregate to the total
+    const void * context; // read-only data of the aggregate, shared by the workers
+} SaleScanner; // Aggregate computed by scanSales() over the sale segments
+typedef struct {
+    const SaleTransaction * sales; // first line item of the chunk, in a mapped segment
+    int count; // count of line items
+} ScanChunk; // Part of a sale segment aggregated by one worker at a time
+typedef struct {
+    const SaleScanner * scanner; // aggregate computed
+    const ScanChunk * chunks; // chunks of all the segments of the time range
+    int chunkCount; // count of chunks
+#ifdef __linux__
+    atomic_int next; // index of the next chunk not taken by a worker
+#else
+    int next; // index of the next chunk, the calling thread is the only worker
+#endif
+} SaleScan; // Chunks of a scan, taken by the workers one at a time
+typedef struct {
+    SaleScan * scan; // scan shared by the workers
+    void * partial; // partial aggregate of the worker
+#ifdef __linux__
+    pthread_t thread; // thread of the worker, the first worker is the calling thread
+#endif
+} ScanWorker; // Worker of a scan with its partial aggregate
+typedef struct {
+    long long revenue; // sum of price x quantity in cents
+    long long quantity; // sum of quantities
+} RevenueTotal; // Revenue of one key (product, category or day) of a revenue report
+typedef struct {
+    long long from; // start of the time range
+    long long to; // end of the time range (inclusive)
+    int keyCount; // count of keys, each with its RevenueTotal
+    int productCount; // count of product IDs, the next product ID
+    const int * categories; // category key of each product ID, for the revenue per category
+    const long long * days; // start of each day and of the day after the last, for the revenue per day
+} RevenueReport; // Read-only context of a revenue scan, shared by the workers
+typedef struct {
+    int kind; // AGGREGATE_PRODUCT | AGGREGATE_DAY | AGGREGATE_HOUR | AGGREGATE_TELLER; EMPTY_ID if the slot is empty
+    int key; // product ID | 0 for a day | hour of the day (0-23) | teller ID, 0 for the checkouts without a teller
+    int day; // local date as YYYYMMDD; 0 for a product
+    int count; // count of checkouts; count of line items for a product
+    long long quantity; // units sold
+    long long revenue; // revenue in cents
+} SaleAggregate; // Running totals of one key, a slot of the open addressing table of SALEAGGREGATES
+typedef struct {
+    unsigned int magic; // AGGREGATE_MAGIC
+    unsigned short schema_version; // SCHEMA_VERSION of the aggregates file
+    unsigned short record_size; // size of each SaleAggregate
+    int count; // count of slots, a power of 2
+    int used; // count of aggregates
+    long long items; // count of sale line items added up, the sum of the counts of the sale segment catalog when up to date
+    unsigned int checksum; // checksum of the fields above
+} AggregateFileHeader; // Header of the sale aggregates file, starts with the same fields as RecordFileHeader
+typedef struct {
+    SaleAggregate * entries; // open addressing table; kind EMPTY_ID if the slot is empty
+    int capacity; // count of table slots, a power of 2
+    int used; // count of aggregates in the table
+} AggregateSet; // In-memory hash table of sale aggregates, added up before they are written to SALEAGGREGATES
+typedef struct {
+    int product_id; // id of product, the same as the slot of the record; EMPTY_ID if the stock of the product is not tracked
+    int quantity; // units on hand, negative if more units were sold than received
+    int reorder_level; // the stock is low once the units on hand are at or below this level
+} StockRecord; // Stock of one product in STOCKRECORDS
+typedef struct {
+    int product_id; // id of product
+    int op; // STOCK_ADD | STOCK_COUNT | STOCK_REORDER
+    int quantity; // units added or removed | units counted | reorder level
+    int sequence; // order of the change, the changes of one product are applied in this order
+} StockChange; // One change of the stock of a product, applied by applyStockChanges()
+typedef struct {
+    int width; // width of the column in characters, longer text is cut
+    int align; // ALIGN_LEFT | ALIGN_CENTER | ALIGN_RIGHT
+    int format; // CELL_TEXT | CELL_ID | CELL_MONEY | CELL_NUMBER
+} ColumnSpec; // Column of a rendered table
+typedef struct {
+    const char * text; // string of a CELL_TEXT cell
+    long long number; // ID, amount in cents or integer of the other cells
+} TableCell; // Value of one cell of a table row
+typedef struct {
+    char * data; // rendered text, not null terminated
+    size_t length; // count of characters rendered
+    size_t capacity; // allocated size of data
+} OutputBuffer; // Growable buffer of rendered text written to the terminal at once
+typedef struct {
+    SaleTransaction * items; // line items of the transaction, stored as is by appendSales()
+    size_t * offsets; // receipt offset of the sale ID of each line item, the IDs are allocated at checkout
+    size_t saleoffset; // receipt offset of the transaction ID
+    int count; // count of line items
+    int capacity; // allocated count of line items and of their receipt offsets
+} Cart; // Growable list of the line items of a sale transaction
+typedef struct {
+    char * text; // rendered receipt, freed once written; NULL for the job stopping the writer thread
+    size_t length; // length of the receipt
+    char date[TIME_SIZE]; // date of the daily transaction file, YYYY-MM-DD
+} ReceiptJob; // Receipt waiting to be written to its daily transaction file
+typedef struct {
+#ifdef __linux__
+    ReceiptJob jobs[RECEIPT_QUEUE_SIZE]; // ring of the receipts waiting to be written
+    atomic_uint head; // count of jobs taken, only moved by the writer thread
+    atomic_uint tail; // count of jobs queued, only moved by the checkout
+    sem_t filled; // count of queued jobs, the writer thread sleeps on it
+    sem_t space; // count of free ring slots, the checkout only waits on it when the ring is full
+    pthread_t thread; // writer thread
+#endif
+    int running; // 1 - the writer thread writes the receipts | 0 - the checkout writes them itself
+    FILE * fp; // open daily transaction file; NULL if none yet
+    char date[TIME_SIZE]; // date of the open transaction file
+} ReceiptWriter; // Single-producer single-consumer queue of the receipts and the thread writing them
+typedef struct {
+    int op; // SERVER_PRODUCT | SERVER_TELLER | SERVER_ALLOCATE | SERVER_CHECKOUT
+    int id; // ID looked up; count of IDs allocated; count of line items of a checkout
+    int length; // size of the payload following the request
+} ServerRequest; // Request of a lane to the POS server
+typedef struct {
+    int status; // -1 not found or error | 0 success | the allocated ID
+    int length; // size of the payload following the reply
+} ServerReply; // Reply of the POS server to a lane
+typedef struct {
+    int fd; // connection of the lane
+    int writing; // 1 - waiting until the replies can be sent | 0 - waiting for requests
+    OutputBuffer in; // bytes received, the requests not yet handled
+    OutputBuffer out; // replies not yet sent
+    size_t sent; // count of bytes of out already sent
+} ServerClient; // Lane connected to the POS server
+
+// Read-only views of the records files, refreshed before each use
+RecordView productView = { .filename = PRODUCTRECORDS, .recordsize = sizeof(ProductRecord), .headersize = sizeof(RecordFileHeader), .magic = RECORD_MAGIC };
+RecordView productStringView = { .filename = PRODUCTSTRINGS, .recordsize = 1, .headersize = 0 };
+RecordView productIndexView = { .filename = PRODUCTINDEX, .recordsize = sizeof(IndexEntry), .headersize = sizeof(IndexFileHeader), .magic = INDEX_MAGIC };
+RecordView tellerView = { .filename = TELLERRECORDS, .recordsize = sizeof(TellerRecord), .headersize = sizeof(RecordFileHeader), .magic = RECORD_MAGIC };
+RecordView tellerStringView = { .filename = TELLERSTRINGS, .recordsize = 1, .headersize = 0 };
+RecordView saleSegmentView = { .filename = SALESEGMENTS, .recordsize = sizeof(SaleSegment), .headersize = sizeof(RecordFileHeader), .magic = RECORD_MAGIC };
+RecordView saleAggregateView = { .filename = SALEAGGREGATES, .recordsize = sizeof(SaleAggregate), .headersize = sizeof(AggregateFileHeader), .magic = AGGREGATE_MAGIC };
+RecordView stockView = { .filename = STOCKRECORDS, .recordsize = sizeof(StockRecord), .headersize = sizeof(RecordFileHeader), .magic = RECORD_MAGIC };
+// Catalogs of the records read by the menus, loaded in main() and revalidated before each use
+Catalog productCatalog = { .records = &productView, .strings = &productStringView, .index = &productIndexView };
+Catalog tellerCatalog = { .records = &tellerView, .strings = &tellerStringView, .index = NULL };
+TrigramIndex productTrigrams = { .view = { .filename = PRODUCTTRIGRAMS, .recordsize = sizeof(TrigramPosting), .headersize = sizeof(RecordFileHeader), .magic = RECORD_MAGIC } };
+TrigramIndex tellerTrigrams = { .view = { .filename = TELLERTRIGRAMS, .recordsize = sizeof(TrigramPosting), .headersize = sizeof(RecordFileHeader), .magic = RECORD_MAGIC } };
+Arena recordArena; // buffers of the record sets of the current menu operation, reset after each main menu iteration
+WriteAheadLog wal = { .fp = NULL, .durability = DURABILITY_FSYNC, .groupms = GROUP_COMMIT_MS, .groupcount = GROUP_COMMIT_COUNT };
+OutputBuffer tableOutput; // rendered tables, kept allocated between the listings
+ReceiptWriter receiptWriter; // writes the receipts of the checkouts to the daily transaction files
+FILE * laneLock; // lock of the lanes sharing the records files
+int serverFd = -1; // connection of this lane to the POS server; -1 if the lane uses the records files itself
+volatile sig_atomic_t serverStop; // set by SIGINT or SIGTERM to stop the POS server
+// Columns of the listings, the same widths as their titles
+const ColumnSpec productColumns[6] = { { 11, ALIGN_CENTER, CELL_ID }, { 20, ALIGN_CENTER, CELL_TEXT }, { 20, ALIGN_CENTER, CELL_TEXT },
+    { 20, ALIGN_CENTER, CELL_TEXT }, { 20, ALIGN_CENTER, CELL_TEXT }, { 15, ALIGN_RIGHT, CELL_MONEY } };
+const ColumnSpec tellerColumns[4] = { { 11, ALIGN_CENTER, CELL_ID }, { 26, ALIGN_CENTER, CELL_TEXT }, { 26, ALIGN_CENTER, CELL_TEXT },
+    { 26, ALIGN_CENTER, CELL_TEXT } };
+const ColumnSpec saleColumns[5] = { { 11, ALIGN_CENTER, CELL_ID }, { 20, ALIGN_CENTER, CELL_TEXT }, { 20, ALIGN_CENTER, CELL_TEXT },
+    { 17, ALIGN_RIGHT, CELL_MONEY }, { 16, ALIGN_CENTER, CELL_NUMBER } };
+const ColumnSpec productRevenueColumns[4] = { { 11, ALIGN_CENTER, CELL_ID }, { 20, ALIGN_CENTER, CELL_TEXT }, { 16, ALIGN_CENTER, CELL_NUMBER },
+    { 17, ALIGN_RIGHT, CELL_MONEY } };
+const ColumnSpec revenueColumns[3] = { { 31, ALIGN_CENTER, CELL_TEXT }, { 16, ALIGN_CENTER, CELL_NUMBER }, { 17, ALIGN_RIGHT, CELL_MONEY } };
+const ColumnSpec stockColumns[4] = { { 11, ALIGN_CENTER, CELL_ID }, { 20, ALIGN_CENTER, CELL_TEXT }, { 16, ALIGN_CENTER, CELL_NUMBER },
+    { 16, ALIGN_CENTER, CELL_NUMBER } };
+const ColumnSpec hourColumns[4] = { { 11, ALIGN_CENTER, CELL_TEXT }, { 16, ALIGN_CENTER, CELL_NUMBER }, { 16, ALIGN_CENTER, CELL_NUMBER },
+    { 17, ALIGN_RIGHT, CELL_MONEY } };
+const ColumnSpec tellerSalesColumns[5] = { { 11, ALIGN_CENTER, CELL_ID }, { 26, ALIGN_CENTER, CELL_TEXT }, { 14, ALIGN_CENTER, CELL_NUMBER },
+    { 14, ALIGN_CENTER, CELL_NUMBER }, { 17, ALIGN_RIGHT, CELL_MONEY } };
 
 // Define Function Prototypes
 int CLI(void); // Command Line Interface
 void prod_menu(void); // Product Details Menu
 void teller_menu(void); // Teller Details Menu
 void sales_menu(void); // Sale Transaction Menu
+int runBatch(const char * filename); // apply the product and teller commands of a batch file without any prompt
+int splitFields(char * text, char ** fields, int max); // split a string in place into fields separated by '|'
+int batchField(char * buffer, const char * field, int lineno); // copy a field of a batch command to a name buffer
+int batchProduct(const char * verb, char ** fields, int count, int lineno); // apply one product command of a batch file
+int batchTeller(const char * verb, char ** fields, int count, int lineno); // apply one teller command of a batch file
+int runCsv(const char * command, const char * table, const char * csvname); // import or export the product or teller records as CSV, or import a stock manifest
+int importCsv(const char * csvname, RecordView * records, RecordView * heap, int stringcount, int columns, int (*convert)(char ** fields, void * record, int lineno)); // append the rows of a CSV file as new records
+int importProductColumns(char ** fields, void * record, int lineno); // set the unit price of a product record imported from CSV
+int exportCsv(const char * csvname, RecordView * records, RecordView * heap, int stringcount, const char * columns, void (*extra)(const void * record, FILE * fp)); // write the live records as CSV rows
+void exportProductColumns(const void * record, FILE * fp); // write the unit price column of a product record exported as CSV
+void writeCsvField(FILE * fp, const char * field); // write a CSV field, quoted if needed
+int csvGetc(CsvReader * reader); // read the next character of a CSV file through its buffer
+int readCsvRow(CsvReader * reader, char ** fields, int max); // read the next row of a CSV file
+int addID(IdSet * set, int id); // add a record ID to a hash set
 int prod_add(void); // Add new Product Details
 void prod_display(void); // Display all Product Details
 void prod_sud_menu(const char * request); // Product Search/Update/Delete Menu
 int prod_search_id(int id, const char * request); // Product Search/Update/Delete Request by ID
 int prod_search_name(const char * prod_name, const char * request); // Product Search/Update/Delete Request by Product Name
+void stock_menu(void); // Product Stock Menu
+void stock_update(int op); // Receive, Adjust or set the Reorder Level of the stock of one product
+void stock_low(void); // Display the products low on stock
 int teller_add(void); // Add new Teller Details
 void teller_display(void); // Display all Teller Details
 void teller_sud_menu(const char * request); // Teller Search/Update/Delete Menu
@@ -122,44 +585,281 @@ int teller_search_id(int id, const char * request); // Teller Search/Update/Dele
 int teller_search_name(const char * teller_name, const char * request); // Teller Search/Update/Delete Request by Product Name
 void sale_add(void); // add new transaction
 void sale_display(void); // Display Transactions
-float compute_payable_amount(SaleTransaction * sale, int count); // Compute Total Payable amount
-float compute_change(float payable_amount, float cash); // Compute Total Payable amount
-int getRecordCount(const char * filename, int recordsize); // Get record count from file
-int getLatestID(const char * filename, int recordsize); // get the latest maximum ID from file
-int saveProductToFile(Product * product, int count); // save product to file
-int saveTellerToFile(Teller * teller, int count); // save teller to file
-int saveSaleTransactionToFile(SaleTransaction * sale, int count); // save sale transaction to file
-void getProductData(Product * product); // get product data from file
-void getTellerData(Teller * teller); // get teller data from file
-void getSaleData(SaleTransaction * sale); // get sale transaction data from file
+void sale_report(void); // Revenue Reports
+int prepareRevenueReport(RevenueReport * report, int kind, long long from, long long to, const char *** names); // set up the keys of a revenue report
+void sale_zreport(void); // Z-Report, the register totals of a day
+SaleTransaction * addCartItem(Cart * cart); // add an empty line item to a cart
+void freeCart(Cart * cart); // free the line items of a cart
+void showReceipt(const OutputBuffer * receipt, size_t header, size_t shown, int hidden); // show a receipt with only its last line items
+int insertSaleIDs(OutputBuffer * receipt, SaleHeader * sale, Cart * cart, int first); // give a checkout its sale IDs and write them into its receipt
+int startReceiptWriter(void); // start the thread writing the receipts
+void stopReceiptWriter(void); // write the queued receipts and stop the receipt writer thread
+void queueReceipt(const char * date, char * text, size_t length); // hand a receipt over to the receipt writer
+int writeReceipt(const char * date, const char * text, size_t length); // append a receipt to the transaction file of its date
+#ifdef __linux__
+void * receiptWriterThread(void * arg); // write the queued receipts until stopped
+#endif
+int serveLanes(const char * path); // serve the lookups and checkouts of the lanes until stopped
+void stopServer(int sig); // stop the POS server at its next wakeup
+#ifdef __linux__
+int serveClient(int epfd, ServerClient * client); // read and handle the requests of a lane, then send the replies
+int writeSocket(int fd, const void * data, size_t size); // write all the bytes to a blocking socket
+int readSocket(int fd, void * data, size_t size); // read exactly size bytes from a blocking socket
+#endif
+int handleRequest(const ServerRequest * request, const char * payload, OutputBuffer * out); // handle one request of a lane and append its reply
+int connectServer(const char * path); // connect to the POS server if it runs
+void disconnectServer(void); // close the connection of this lane to the POS server
+int requestServer(int op, int id, const void * payload, int length, void * reply, int replysize); // send a request to the POS server and wait for its reply
+int allocateSaleIDs(int count); // allocate consecutive sale IDs, through the POS server if connected
+int checkoutSale(SaleHeader * sale, const SaleTransaction * sales, int count); // append a checkout, through the POS server if connected
+long long compute_payable_amount(SaleTransaction * sale, int count); // Compute Total Payable amount
+long long compute_change(long long payable_amount, long long cash); // Compute Total Payable amount
+long long floatToCents(float value); // convert an amount of older versions stored as a float to cents
+long long parseMoney(const char * text); // parse an amount typed with at most 2 decimals to cents
+char * formatMoney(char * buffer, long long cents); // format an amount in cents with 2 decimals
+long long sumAmounts(const long long * restrict prices, const int * restrict quantities, int count); // sum price x quantity over contiguous columns
+long long sumSaleAmounts(const SaleTransaction * sales, int count); // sum price x quantity of sale line items
+unsigned int fnv1a(const void * data, size_t size); // compute the FNV-1a hash of bytes
+unsigned int headerChecksum(const RecordFileHeader * header); // compute the checksum of a records file header
+void initRecordHeader(RecordFileHeader * header, int recordsize); // set up the header of an empty records file
+int initRecordFile(const char * filename, int recordsize); // create the records file if not exists, else validate its header
+int readRecordHeader(FILE * fp, const char * filename, int recordsize, RecordFileHeader * header); // read and validate the header of a records file
+void rebuildRecordHeader(FILE * fp, int recordsize, RecordFileHeader * header); // recount the header fields from the records
+int writeRecordHeader(FILE * fp, const char * filename, RecordFileHeader * header); // write the header of a records file
+int lockFile(FILE * fp, int exclusive); // lock an open file against the other processes
+int holdsLock(long long inode); // check if the open transaction holds the lock of a file
+int joinLanes(void); // lock the lanes file, exclusive if no other lane is running
+FILE * openRecordFile(const char * filename, int recordsize, RecordFileHeader * header); // lock a records file and begin a transaction
+int closeRecordFile(const char * filename, RecordFileHeader * header, int durable); // write the header of a records file and commit
+int allocateID(const char * filename, int recordsize, int count); // allocate the next IDs of a records file
+int setDurability(const char * mode); // set the durability mode of the commits
+long long nowMillis(void); // get a monotonic time in milliseconds
+int syncFile(FILE * fp); // flush an open file and force it to the disk
+int syncDirectory(void); // force the renamed entries of the records directory to the disk
+void unlockFile(FILE * fp); // release a lock taken by lockFile()
+int openLog(int redo); // open the write-ahead log, redoing its committed transactions if no other lane is running
+void closeLog(void); // checkpoint and close the write-ahead log
+int startLogFlusher(void); // start the thread syncing the group commits at their deadline
+#ifdef __linux__
+void * logFlusherThread(void * arg); // flusher thread: sync the pending group commits once their deadline has passed
+#endif
+int syncPending(void); // sync the write-ahead log if durable commits are pending
+int syncLog(void); // sync the pending commits before the lane waits for the operator
+void beginTransaction(void); // begin a transaction or join the open one
+int logWrite(const char * filename, long offset, const void * data, int size); // add a data file write to the open transaction
+int logRename(const char * from, const char * to); // add a file rename to the open transaction
+void holdLock(FILE * fp); // keep a locked file open until the transaction ends
+int commitTransaction(int durable); // log, sync and apply the writes of the open transaction
+void abortTransaction(void); // drop the writes of the open transaction
+int applyWrites(const char * writes, size_t size); // apply the writes of a transaction frame to the data files
+int replayLog(int redo); // sync the data files written by the logged transactions and truncate the log
+int writeToFileAt(const char * filename, long offset, const void * data, int size); // overwrite bytes of a file at offset through the write-ahead log
+int writeRecordAt(const char * filename, int recordsize, int index, const void * record); // overwrite one record slot in file
+int deleteRecordAt(const char * filename, int recordsize, int index); // mark one record slot as deleted (tombstone)
+int appendRecords(const char * filename, int recordsize, const void * records, int count); // append records to file, returns the slot of the first
+int compactRecords(const char * filename, int recordsize, const char * heapname, int stringcount); // reclaim the deleted record slots and unused strings of file
+const char * heapString(RecordView * heap, int offset); // get a string from a string heap by offset
+int writeHeapStrings(RecordView * heap, const char ** strings, int * offsets, const int * oldOffsets, int count); // append changed strings to a string heap
+const char * productString(int offset); // get a string of a product record
+const char * tellerString(int offset); // get a string of a teller record
+void loadProduct(const ProductRecord * record, Product * product); // copy a product record with its strings to a Product struct
+void loadTeller(const TellerRecord * record, Teller * teller); // copy a teller record with its strings to a Teller struct
+int storeProduct(const Product * product, int index); // write a Product struct to its record slot, -1 index to append
+int storeTeller(const Teller * teller, int index); // write a Teller struct to its record slot, -1 index to append
+int convertLegacyProducts(void); // convert fixed-size Product records to the product records and string heap
+int convertLegacyTellers(void); // convert fixed-size Teller records to the teller records and string heap
+int convertLegacySales(void); // convert sale transactions with a full Product copy to sale line items
+void saleSegmentName(char * filename, const char * format, int month); // get the filename of a sale segment of a month
+int appendSales(SaleHeader * sale, const SaleTransaction * sales, int count); // append one checkout to the sale segments of its month
+SaleSegment * findSaleSegments(long long from, long long to, int * count); // find the sale segments having sales in a time range
+int openSaleCursor(SaleCursor * cursor, long long from, long long to, int product_id); // open a cursor over the sales of a time range
+void closeSaleCursor(SaleCursor * cursor); // unmap the segment of a sale cursor
+int mapSaleSegment(SaleCursor * cursor, int segment); // map a segment of a sale cursor
+int saleMatches(const SaleCursor * cursor, const SaleTransaction * sale); // check if a sale is one a cursor is filtered for
+int nextSale(SaleCursor * cursor, SaleTransaction * sale); // read the next matching sale after a cursor
+int prevSale(SaleCursor * cursor, SaleTransaction * sale); // read the previous matching sale before a cursor
+int seekSale(SaleCursor * cursor, int id); // move a cursor before the first sale with an ID of at least id
+int scanSales(long long from, long long to, const SaleScanner * scanner, void * total); // aggregate the sales of a time range on worker threads
+void * scanWorker(void * arg); // aggregate the chunks of a scan until none is left
+void scanProductRevenue(void * partial, const SaleTransaction * sales, int count, const void * context); // add line items to the revenue per product
+void scanCategoryRevenue(void * partial, const SaleTransaction * sales, int count, const void * context); // add line items to the revenue per category
+void scanDailyRevenue(void * partial, const SaleTransaction * sales, int count, const void * context); // add line items to the revenue per day
+void mergeRevenue(void * total, const void * partial, const void * context); // add the revenue totals of a worker to the report
+long long startOfDay(long long t); // get the local midnight starting the day of a time
+int localDay(long long t, int * hour); // get the local date of a time as YYYYMMDD
+unsigned int hashAggregate(int kind, int key, int day); // hash the key of a sale aggregate to a table slot
+int addAggregate(AggregateSet * set, int kind, int key, int day, int count, long long quantity, long long revenue); // add totals to an in-memory aggregate
+int addSaleAggregates(AggregateSet * set, const SaleHeader * sale, const SaleTransaction * sales, int count); // add a checkout to in-memory aggregates
+const SaleAggregate * findAggregate(int kind, int key, int day); // find the running totals of a key in the sale aggregates file
+int compareAggregateKeys(const void * a, const void * b); // order sale aggregates by key
+int updateSaleAggregates(const SaleHeader * sale, const SaleTransaction * sales, int count); // add a checkout to the sale aggregates file
+int writeAggregateFile(const SaleAggregate * entries, int count, int capacity, long long items); // write a new sale aggregates file from aggregates
+int rebuildSaleAggregates(void); // rebuild the sale aggregates file from the sale segments
+int checkSaleAggregates(void); // check that the sale aggregates count every sale line item
+const StockRecord * findStock(int product_id); // find the stock of a product by ID
+int compareStockChanges(const void * a, const void * b); // order stock changes by product, then by sequence
+int applyStockChanges(StockChange * changes, int count, int track); // apply stock changes in one transaction
+int updateSaleStock(const SaleTransaction * sales, int count); // remove the units sold by a checkout from the stock
+int importStockManifest(const char * csvname); // add the units received by a delivery manifest to the stock
+long long parseDate(const char * text, int endOfDay); // parse a date as YYYY-MM-DD to a local time
+int fileExists(const char * filename); // check if file exists
+int refreshRecordView(RecordView * view); // map the records file, remapping if the file has changed
+int refreshCatalog(Catalog * catalog); // refresh the views of a catalog if its records file has changed
+void closeRecordView(RecordView * view); // unmap the records file
 int getProductByID(Product * productbuffer, int searchID); // get Product struct by search ID
+const ProductRecord * findProductRecord(int searchID); // find the product record by ID
+int getTellerByID(Teller * tellerbuffer, int searchID); // get Teller struct by search ID
+const TellerRecord * findTellerRecord(int searchID); // find the teller record by ID
+int deleteProduct(int index); // delete a product record with its hash index entry and trigram postings
+unsigned int hashID(int id); // hash a record ID to a hash index slot
+int findIndexEntry(RecordView * index, int id); // find the hash index slot of a record ID
+int updateIndexEntry(RecordView * index, int id, int slot); // add, move or remove a record ID in a hash index
+int writeIndexFile(const char * filename, const IndexEntry * entries, int count, int capacity); // write a new hash index file from index entries
+int rebuildProductIndex(void); // rebuild the product hash index from the product records
+int checkProductIndex(void); // check that the product hash index matches the product records
+int deleteTeller(int index); // delete a teller record and its trigram postings
+int collectTrigrams(const char ** strings, int count, unsigned int * trigrams); // collect the distinct case-folded trigrams of strings
+int updateTrigrams(TrigramIndex * index, int slot, const char ** oldStrings, const char ** newStrings, int count); // append the changed trigram postings of a record
+PostingList * findPostingList(TrigramIndex * index, unsigned int trigram, int create); // find the posting list of a trigram
+int refreshTrigramIndex(TrigramIndex * index); // apply the new postings of the posting log to the posting lists
+void resetTrigramIndex(TrigramIndex * index); // free the posting lists of a trigram index
+int searchTrigrams(TrigramIndex * index, const char * query, int * slots, int maxslots); // find the candidate record slots of a substring query
+int rebuildTrigramIndex(TrigramIndex * index, RecordView * records, RecordView * heap, int stringcount); // rebuild a trigram posting log from the records
+int compactTrigramLog(TrigramIndex * index); // drop the dead postings of a trigram posting log once they outnumber the live ones
+int containsIgnoreCase(const char * text, const char * query); // check if a string contains a substring ignoring the case
+void * arenaAlloc(Arena * arena, size_t size); // allocate a buffer from an arena
+void arenaReset(Arena * arena); // free all the buffers of an arena, keeping its blocks
+void arenaFree(Arena * arena); // free the blocks of an arena
 // other function prototypes
 int dscanc(int * d); // user single-input integer
 int cscanc(char * c); // user single-input char
 char * capitalize(const char * word); // Capitalize first letter of the word/string
-int maxOfInt(int * arr, int count); // get the maximum value of an int array
-char * centerTheString(const char * strval, int size); // center the string content by size of char
-char * rightAlignFloat(float value, int charsize); // right align as string from floating value in specific char size
+int reserveOutput(OutputBuffer * out, size_t size); // make room for more characters in an output buffer
+void appendOutput(OutputBuffer * out, const char * text); // append a string to an output buffer
+void appendOutputf(OutputBuffer * out, const char * format, ...); // append formatted text to an output buffer
+void renderRow(OutputBuffer * out, const ColumnSpec * columns, const TableCell * cells, int count); // render a table row to an output buffer
+void renderProductRow(OutputBuffer * out, const ProductRecord * product); // render a product record as a table row
+void renderTellerRow(OutputBuffer * out, const TellerRecord * teller); // render a teller record as a table row
+void flushOutput(OutputBuffer * out); // write an output buffer to the terminal at once
+void freeOutput(OutputBuffer * out); // free the memory of an output buffer
 void customScanfDefaultString(char * buffer, const char * defaultVal);
-void customScanfDefaultFloat(float * buffer, float defaultVal);
+void customScanfDefaultMoney(long long * buffer, long long defaultVal);
 void customScanfDefaultInt(int * buffer, int defaultVal);
 
 // main
 int main(int argc, char * argv[]) {
-    FILE * fp; // create binary files if not exists
-    if ((fp = fopen(PRODUCTRECORDS, "ab")) == NULL)
+    FILE * fp;
+    int i, alone, compacted, serve = 0, rebuild = 0, failed = 0;
+    const char * batch = NULL; // batch file applied instead of the menus
+    const char * command = NULL, * table = NULL, * csvname = NULL; // CSV import or export run instead of the menus
+    for (i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], "--durability") && i + 1 < argc && setDurability(argv[i + 1]) == 0)
+            i++;
+        else if (0 == strcmp(argv[i], "--batch") && i + 1 < argc)
+            batch = argv[++i];
+        else if (0 == strcmp(argv[i], "--serve"))
+            serve = 1;
+        else if (0 == strcmp(argv[i], "--rebuild-aggregates"))
+            rebuild = 1;
+        else if ((0 == strcmp(argv[i], "import") || 0 == strcmp(argv[i], "export")) && i + 2 < argc
+            && (0 == strcmp(argv[i + 1], "products") || 0 == strcmp(argv[i + 1], "tellers")
+            || (0 == strcmp(argv[i], "import") && 0 == strcmp(argv[i + 1], "stock")))) {
+            command = argv[i];
+            table = argv[i + 1];
+            csvname = argv[i + 2];
+            i += 2;
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--durability fsync|group[:ms[:count]]|none] [--serve | --rebuild-aggregates | --batch file | import|export products|tellers file.csv | import stock manifest.csv]\n", argv[0]);
+            exit(1);
+        }
+    }
+    // the records files may be shared by other lanes (processes), only the first lane reorganizes them
+    alone = joinLanes();
+    // redo the transactions interrupted by a crash before anything reads the records; the log of running lanes is theirs
+    if (openLog(alone) < 0)
         exit(1);
-    fclose(fp);
-    if ((fp = fopen(TELLERRECORDS, "ab")) == NULL)
+    // convert the records of older versions to the compact record format, only the first lane may replace the files
+    if (!alone && ((!fileExists(PRODUCTRECORDS) && fileExists(LEGACYPRODUCTRECORDS)) || (!fileExists(TELLERRECORDS) && fileExists(LEGACYTELLERRECORDS))
+        || (!fileExists(SALESEGMENTS) && fileExists(LEGACYSALERECORDS)))) {
+        fprintf(stderr, "THE RECORDS OF AN OLDER VERSION MUST BE CONVERTED, START ONE LANE FIRST.\n");
+        exit(1);
+    }
+    if (!fileExists(PRODUCTRECORDS) && fileExists(LEGACYPRODUCTRECORDS) && convertLegacyProducts() != 0)
+        exit(1);
+    if (!fileExists(TELLERRECORDS) && fileExists(LEGACYTELLERRECORDS) && convertLegacyTellers() != 0)
+        exit(1);
+    if (!fileExists(SALESEGMENTS) && fileExists(LEGACYSALERECORDS) && convertLegacySales() != 0)
+        exit(1);
+    // create binary files if not exists
+    if (initRecordFile(PRODUCTRECORDS, sizeof(ProductRecord)) != 0)
+        exit(1);
+    if ((fp = fopen(PRODUCTSTRINGS, "ab")) == NULL)
         exit(1);
     fclose(fp);
-    if ((fp = fopen(SALERECORDS, "ab")) == NULL)
+    if (initRecordFile(TELLERRECORDS, sizeof(TellerRecord)) != 0)
+        exit(1);
+    if ((fp = fopen(TELLERSTRINGS, "ab")) == NULL)
         exit(1);
     fclose(fp);
-    while (1) {
+    if (initRecordFile(SALESEGMENTS, sizeof(SaleSegment)) != 0) // the sale segments are created by their first sale
+        exit(1);
+    if (initRecordFile(STOCKRECORDS, sizeof(StockRecord)) != 0)
+        exit(1);
+    // reclaim the record slots deleted during the previous session, unless other lanes use the record slots
+    if (alone) {
+        compacted = compactRecords(PRODUCTRECORDS, sizeof(ProductRecord), PRODUCTSTRINGS, 4) > 0; // compaction moves the product records to new slots
+        if (compacted || checkProductIndex() != 0)
+            rebuildProductIndex();
+        if (compacted || !fileExists(PRODUCTTRIGRAMS) || initRecordFile(PRODUCTTRIGRAMS, sizeof(TrigramPosting)) != 0)
+            rebuildTrigramIndex(&productTrigrams, &productView, &productStringView, 1); // only the product name is searched
+        compacted = compactRecords(TELLERRECORDS, sizeof(TellerRecord), TELLERSTRINGS, 3) > 0;
+        if (compacted || !fileExists(TELLERTRIGRAMS) || initRecordFile(TELLERTRIGRAMS, sizeof(TrigramPosting)) != 0)
+            rebuildTrigramIndex(&tellerTrigrams, &tellerView, &tellerStringView, 3);
+        if (!rebuild && checkSaleAggregates() != 0) // missing, or sales were converted or added by an older version
+            rebuildSaleAggregates();
+        if (laneLock != NULL)
+            lockFile(laneLock, 0); // the other lanes waiting to start may run now
+    }
+    // load the catalogs once, the menus only reread them when the records files change
+    refreshCatalog(&productCatalog);
+    refreshCatalog(&tellerCatalog);
+    startReceiptWriter(); // if it does not start, the checkout writes its receipt itself
+    if (serve)
+        failed = serveLanes(SERVERSOCKET);
+    else if (rebuild)
+        failed = rebuildSaleAggregates();
+    else if (batch != NULL)
+        failed = runBatch(batch);
+    else if (command != NULL)
+        failed = runCsv(command, table, csvname);
+    else
+        serverFd = connectServer(SERVERSOCKET); // the checkouts go through the POS server if one is running
+    while (!serve && !rebuild && batch == NULL && command == NULL) {
+        arenaReset(&recordArena); // the buffers of the previous menu operation are no longer used
+        syncLog(); // the lane waits for the operator, its pending group commits are synced now
         if (CLI() == 4) // 4 = exit
             break;
     }
+    stopReceiptWriter(); // the receipts still queued are written before exit
+    disconnectServer();
+    arenaFree(&recordArena);
+    freeOutput(&tableOutput);
+    closeRecordView(&productView);
+    closeRecordView(&productStringView);
+    closeRecordView(&productIndexView);
+    closeRecordView(&tellerView);
+    closeRecordView(&tellerStringView);
+    closeRecordView(&saleSegmentView);
+    closeRecordView(&saleAggregateView);
+    closeRecordView(&stockView);
+    closeRecordView(&productTrigrams.view);
+    closeRecordView(&tellerTrigrams.view);
+    resetTrigramIndex(&productTrigrams);
+    resetTrigramIndex(&tellerTrigrams);
+    closeLog();
+    if (serve || rebuild || batch != NULL || command != NULL)
+        return failed == 0 ? 0 : 1;
     printf(" => Thank you for using this Point of Sales (POS) System. Goodbye!");
     getch(); // pause before exit
     return 0;
@@ -213,14 +913,15 @@ void prod_menu(void) {
     printf(" [3] Search\n");
     printf(" [4] Update\n");
     printf(" [5] Delete\n");
-    printf(" [6] Go Back\n");
+    printf(" [6] Stock\n");
+    printf(" [7] Go Back\n");
     printf("\n -------------------------------------\n\n");
     do {
         printf(" Choice: ");
         dscanc(&choice);
-        if (!(choice > 0 && choice < 7))
+        if (!(choice > 0 && choice < 8))
             printf(" Invalid Choice!\n");
-    } while (!(choice > 0 && choice < 7));
+    } while (!(choice > 0 && choice < 8));
     switch (choice) {
         case 1: // add new products
             char cnew;
@@ -246,6 +947,9 @@ void prod_menu(void) {
         case 5: // delete one product
             prod_sud_menu("delete");
             break;
+        case 6: // stock of the products
+            stock_menu();
+            break;
         // else go back to menu
     }
 }
@@ -308,14 +1012,16 @@ void sales_menu(void) {
     printf("\n ---------- Sale Transaction ----------\n\n");
     printf(" [1] New Transaction\n");
     printf(" [2] Display Transaction\n");
-    printf(" [3] Go Back\n");
+    printf(" [3] Revenue Reports\n");
+    printf(" [4] Z-Report\n");
+    printf(" [5] Go Back\n");
     printf("\n --------------------------------------\n\n");
     do {
         printf(" Choice: ");
-        dscanc(&choice); // single-input integer value choose from 1-3
-        if (!(choice > 0 && choice < 4))
+        dscanc(&choice); // single-input integer value choose from 1-5
+        if (!(choice > 0 && choice < 6))
             printf(" Invalid Choice!\n");
-    } while (!(choice > 0 && choice < 4));
+    } while (!(choice > 0 && choice < 6));
     switch (choice) {
         case 1: // add new sale transaction
             sale_add();
@@ -323,9 +1029,600 @@ void sales_menu(void) {
         case 2: //  display all sale transaction records
             sale_display();
             break;
+        case 3: // revenue per product, category or day
+            sale_report();
+            break;
+        case 4: // register totals of a day
+            sale_zreport();
+            break;
         // else go back to menu
     }
 }
+/**
+ * @brief Apply the product and teller commands of a batch file without any prompt
+ * Each line is one command applied as its own transaction, so a failed command does not undo the
+ * others, and a command sees the records written by the commands before it. In fsync mode the commits
+ * are synced as group commits of at most BATCH_GROUP_COUNT commands or GROUP_COMMIT_MS, and the last
+ * group before the batch is reported: a system crash may only lose the group not yet synced
+ * 
+ * @param filename batch file, one command per line:
+ * "product add name|description|category|unit|price", "product update id|name|description|category|unit|price",
+ * "product delete id", "teller add first|middle|last", "teller update id|first|middle|last", "teller delete id".
+ * Empty update fields keep the current value; empty lines and lines starting with # are skipped
+ * @return int count of failed commands | -1 if the batch file cannot be read
+ */
+int runBatch(const char * filename) {
+    FILE * fp;
+    char line[BATCH_LINE_SIZE], object[16], verb[16], * fields[BATCH_FIELDS];
+    int lineno = 0, applied = 0, failed = 0, count, offset, result, c;
+    if ((fp = fopen(filename, "r")) == NULL) {
+        fprintf(stderr, "CANNOT READ %s FILE.\n", filename);
+        return -1;
+    }
+    if (wal.durability == DURABILITY_FSYNC) { // a group mode chosen with --durability is kept as is
+        wal.durability = DURABILITY_GROUP;
+        wal.groupcount = BATCH_GROUP_COUNT;
+        wal.groupms = GROUP_COMMIT_MS;
+        startLogFlusher();
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        lineno++;
+        arenaReset(&recordArena); // a batch runs many commands in one menu operation
+        if (strchr(line, '\n') == NULL && !feof(fp)) { // skip the rest of a line too long for the buffer
+            while ((c = fgetc(fp)) != EOF && c != '\n');
+            fprintf(stderr, "LINE %d: COMMAND TOO LONG.\n", lineno);
+            failed++;
+            continue;
+        }
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[strspn(line, " \t")] == 0 || line[strspn(line, " \t")] == '#')
+            continue;
+        offset = 0;
+        if (sscanf(line, "%15s %15s %n", object, verb, &offset) != 2 || offset == 0) {
+            fprintf(stderr, "LINE %d: UNKNOWN COMMAND.\n", lineno);
+            failed++;
+            continue;
+        }
+        count = splitFields(line + offset, fields, BATCH_FIELDS);
+        if (0 == strcmp(object, "product"))
+            result = batchProduct(verb, fields, count, lineno);
+        else if (0 == strcmp(object, "teller"))
+            result = batchTeller(verb, fields, count, lineno);
+        else {
+            fprintf(stderr, "LINE %d: UNKNOWN COMMAND %s.\n", lineno, object);
+            result = -1;
+        }
+        if (result == 0)
+            applied++;
+        else
+            failed++;
+    }
+    fclose(fp);
+    if (syncLog() != 0) // the commands reported as applied are on disk
+        return -1;
+    printf(" => Batch %s: %d command(s) applied, %d failed.\n", filename, applied, failed);
+    return failed;
+}
+/**
+ * @brief Split a string in place into fields separated by '|'
+ * 
+ * @param text string, its separators are replaced by null characters
+ * @param fields buffer of the fields
+ * @param max most fields
+ * @return int count of fields; more than max if there are too many fields
+ */
+int splitFields(char * text, char ** fields, int max) {
+    int count = 0;
+    char * separator;
+    while (1) {
+        if (count < max)
+            fields[count] = text;
+        count++;
+        if ((separator = strchr(text, '|')) == NULL)
+            break;
+        *separator = 0;
+        text = separator + 1;
+    }
+    return count;
+}
+/**
+ * @brief Copy a field of a batch command to a name buffer
+ * 
+ * @param buffer name buffer of MAX_NAME characters
+ * @param field batch command field; empty to keep the buffer as is
+ * @param lineno line of the command in the batch file
+ * @return int 0 - success | -1 field too long
+ */
+int batchField(char * buffer, const char * field, int lineno) {
+    if (strlen(field) >= MAX_NAME) {
+        fprintf(stderr, "LINE %d: FIELD LONGER THAN %d CHARACTERS.\n", lineno, MAX_NAME - 1);
+        return -1;
+    }
+    if (field[0] != 0)
+        strcpy(buffer, field);
+    return 0;
+}
+/**
+ * @brief Apply one product command of a batch file
+ * 
+ * @param verb "add" | "update" | "delete"
+ * @param fields fields of the command
+ * @param count count of fields
+ * @param lineno line of the command in the batch file
+ * @return int 0 - success | -1 error
+ */
+int batchProduct(const char * verb, char ** fields, int count, int lineno) {
+    Product product;
+    const ProductRecord * record;
+    char * names[4] = { product.name, product.description, product.category, product.unit };
+    int i, id = 0, slot = -1, first = 0, update = 0 == strcmp(verb, "update");
+    memset(&product, 0, sizeof(Product));
+    if (update || 0 == strcmp(verb, "delete")) {
+        if (count != (update ? 6 : 1) || (id = atoi(fields[0])) <= 0) {
+            fprintf(stderr, "LINE %d: PRODUCT %s NEEDS %s.\n", lineno, verb, update ? "id|name|description|category|unit|price" : "id");
+            return -1;
+        }
+        if ((record = findProductRecord(id)) == NULL) {
+            fprintf(stderr, "LINE %d: PRODUCT %d NOT FOUND.\n", lineno, id);
+            return -1;
+        }
+        slot = (int)(record - (const ProductRecord *)productView.base);
+        if (!update) {
+            if (deleteProduct(slot) != 0) {
+                fprintf(stderr, "LINE %d: CANNOT DELETE PRODUCT %d.\n", lineno, id);
+                return -1;
+            }
+            return 0;
+        }
+        loadProduct(record, &product);
+        first = 1;
+    }
+    else if (0 != strcmp(verb, "add") || count != 5) {
+        fprintf(stderr, "LINE %d: PRODUCT add NEEDS name|description|category|unit|price.\n", lineno);
+        return -1;
+    }
+    for (i = 0; i < 4; i++) {
+        if (batchField(names[i], fields[first + i], lineno) != 0)
+            return -1;
+    }
+    if (fields[first + 4][0] != 0 && (product.unit_price = parseMoney(fields[first + 4])) < 0) {
+        fprintf(stderr, "LINE %d: INVALID PRICE %s.\n", lineno, fields[first + 4]);
+        return -1;
+    }
+    if (slot < 0 && (product.id = allocateID(PRODUCTRECORDS, sizeof(ProductRecord), 1)) < 0) {
+        fprintf(stderr, "LINE %d: CANNOT WRITE %s FILE.\n", lineno, PRODUCTRECORDS);
+        return -1;
+    }
+    if (storeProduct(&product, slot) != 0) {
+        fprintf(stderr, "LINE %d: CANNOT WRITE %s FILE.\n", lineno, PRODUCTRECORDS);
+        return -1;
+    }
+    return 0;
+}
+/**
+ * @brief Apply one teller command of a batch file
+ * 
+ * @param verb "add" | "update" | "delete"
+ * @param fields fields of the command
+ * @param count count of fields
+ * @param lineno line of the command in the batch file
+ * @return int 0 - success | -1 error
+ */
+int batchTeller(const char * verb, char ** fields, int count, int lineno) {
+    Teller teller;
+    const TellerRecord * record;
+    char * names[3] = { teller.first_name, teller.middle_name, teller.last_name };
+    int i, id = 0, slot = -1, first = 0, update = 0 == strcmp(verb, "update");
+    memset(&teller, 0, sizeof(Teller));
+    if (update || 0 == strcmp(verb, "delete")) {
+        if (count != (update ? 4 : 1) || (id = atoi(fields[0])) <= 0) {
+            fprintf(stderr, "LINE %d: TELLER %s NEEDS %s.\n", lineno, verb, update ? "id|first|middle|last" : "id");
+            return -1;
+        }
+        if ((record = findTellerRecord(id)) == NULL) {
+            fprintf(stderr, "LINE %d: TELLER %d NOT FOUND.\n", lineno, id);
+            return -1;
+        }
+        slot = (int)(record - (const TellerRecord *)tellerView.base);
+        if (!update) {
+            if (deleteTeller(slot) != 0) {
+                fprintf(stderr, "LINE %d: CANNOT DELETE TELLER %d.\n", lineno, id);
+                return -1;
+            }
+            return 0;
+        }
+        loadTeller(record, &teller);
+        first = 1;
+    }
+    else if (0 != strcmp(verb, "add") || count != 3) {
+        fprintf(stderr, "LINE %d: TELLER add NEEDS first|middle|last.\n", lineno);
+        return -1;
+    }
+    for (i = 0; i < 3; i++) {
+        if (batchField(names[i], fields[first + i], lineno) != 0)
+            return -1;
+    }
+    if (slot < 0 && (teller.id = allocateID(TELLERRECORDS, sizeof(TellerRecord), 1)) < 0) {
+        fprintf(stderr, "LINE %d: CANNOT WRITE %s FILE.\n", lineno, TELLERRECORDS);
+        return -1;
+    }
+    if (storeTeller(&teller, slot) != 0) {
+        fprintf(stderr, "LINE %d: CANNOT WRITE %s FILE.\n", lineno, TELLERRECORDS);
+        return -1;
+    }
+    return 0;
+}
+/**
+ * @brief Import or export the product or teller records as CSV, or import a delivery manifest to the stock
+ * 
+ * @param command "import" | "export"
+ * @param table "products" | "tellers" | "stock" (import only)
+ * @param csvname CSV file
+ * @return int count of rejected rows | -1 error
+ */
+int runCsv(const char * command, const char * table, const char * csvname) {
+    int products = 0 == strcmp(table, "products"), result;
+    if (0 == strcmp(table, "stock"))
+        return importStockManifest(csvname);
+    if (0 == strcmp(command, "export")) {
+        if (products)
+            return exportCsv(csvname, &productView, &productStringView, 4, "id,name,description,category,unit,unit_price", exportProductColumns);
+        return exportCsv(csvname, &tellerView, &tellerStringView, 3, "id,first_name,middle_name,last_name", NULL);
+    }
+    if (products) {
+        result = importCsv(csvname, &productView, &productStringView, 4, 6, importProductColumns);
+        if (result >= 0 && (rebuildProductIndex() != 0 || rebuildTrigramIndex(&productTrigrams, &productView, &productStringView, 1) != 0))
+            return -1;
+        return result;
+    }
+    result = importCsv(csvname, &tellerView, &tellerStringView, 3, 4, NULL);
+    if (result >= 0 && rebuildTrigramIndex(&tellerTrigrams, &tellerView, &tellerStringView, 3) != 0)
+        return -1;
+    return result;
+}
+/**
+ * @brief Append the rows of a CSV file as new records
+ * The rows are streamed through a fixed buffer and the new records are written IMPORT_BLOCK at a time
+ * after the last record slot, with their strings appended to the string heap. The records file stays
+ * locked during the import and its header is only written once the records and strings are on disk,
+ * so an interrupted import leaves the records as they were. The caller rebuilds the indexes.
+ * Each row is "id,string 1,...,string n[,other columns]"; an empty id allocates the next ID, and a
+ * first row starting with "id" holds the column names
+ * 
+ * @param csvname CSV file
+ * @param records records view
+ * @param heap string heap view of the records
+ * @param stringcount count of string offsets following the id in each record, from the columns after the id
+ * @param columns count of columns of each row
+ * @param convert sets the other fields of a record from the columns after its strings, prints the error
+ * and returns -1 if a column is invalid; NULL if the records only have strings
+ * @return int count of rejected rows | -1 error
+ */
+int importCsv(const char * csvname, RecordView * records, RecordView * heap, int stringcount, int columns, int (*convert)(char ** fields, void * record, int lineno)) {
+    CsvReader * reader;
+    IdSet ids = { NULL, 0, 0 };
+    RecordFileHeader header;
+    FILE * fp, * heapfp;
+    char * block, * record, * fields[CSV_MAX_FIELDS], * end;
+    int i, k, n, id, offset, blocked = 0, applied = 0, failed = 0, result = 0;
+    long heapsize;
+    unsigned short len;
+    reader = arenaAlloc(&recordArena, sizeof(CsvReader));
+    block = arenaAlloc(&recordArena, (size_t)IMPORT_BLOCK * records->recordsize);
+    if (reader == NULL || block == NULL)
+        return -1;
+    memset(reader, 0, sizeof(CsvReader));
+    reader->next = 1;
+    if ((reader->fp = fopen(csvname, "rb")) == NULL) {
+        fprintf(stderr, "CANNOT READ %s FILE.\n", csvname);
+        return -1;
+    }
+    if ((heapfp = fopen(heap->filename, "ab")) == NULL || lockFile(heapfp, 1) != 0) { // the heap is locked before the records file, as by storeProduct()
+        if (heapfp != NULL) fclose(heapfp);
+        fclose(reader->fp);
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", heap->filename);
+        return -1;
+    }
+    if ((fp = fopen(records->filename, "r+b")) == NULL) {
+        fclose(heapfp);
+        fclose(reader->fp);
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", records->filename);
+        return -1;
+    }
+    if (lockFile(fp, 1) != 0 || readRecordHeader(fp, records->filename, records->recordsize, &header) != 0) { // locked so no record is added while importing
+        fclose(fp);
+        fclose(heapfp);
+        fclose(reader->fp);
+        return -1;
+    }
+    replayLog(0); // the records are written directly, after the logged writes
+    setvbuf(heapfp, NULL, _IOFBF, CSV_BUFFER_SIZE);
+    fseek(heapfp, 0, SEEK_END);
+    heapsize = ftell(heapfp); // new strings are appended at the end of the heap
+    for (i = 0; i < header.count && result == 0; i += n) { // the IDs of the existing records are taken, read through the locked file
+        n = (int)fread(block, records->recordsize, IMPORT_BLOCK, fp);
+        if (n <= 0)
+            break;
+        for (k = 0; k < n && i + k < header.count; k++) {
+            memcpy(&id, block + (size_t)k * records->recordsize, sizeof(int)); // all record structs start with the int id
+            if (id != DELETED_ID && addID(&ids, id) < 0)
+                result = -1;
+        }
+    }
+    fseek(fp, (long)sizeof(RecordFileHeader) + (long)header.count * records->recordsize, SEEK_SET);
+    while (result == 0 && (n = readCsvRow(reader, fields, CSV_MAX_FIELDS)) != 0) {
+        if (n == 1 && fields[0][0] == 0)
+            continue; // empty line
+        if (reader->line == 1 && n > 0 && 0 == strcmp(fields[0], "id"))
+            continue; // column names
+        record = block + (size_t)blocked * records->recordsize;
+        memset(record, 0, records->recordsize);
+        if (n < 0 || n != columns) {
+            fprintf(stderr, n < 0 ? "LINE %d: ROW TOO LONG.\n" : "LINE %d: ROW NEEDS %d COLUMNS.\n", reader->line, columns);
+            failed++;
+            continue;
+        }
+        id = fields[0][0] == 0 ? header.next_id : (int)strtol(fields[0], &end, 10);
+        if (id <= 0 || (fields[0][0] != 0 && *end != 0)) {
+            fprintf(stderr, "LINE %d: INVALID ID %s.\n", reader->line, fields[0]);
+            failed++;
+            continue;
+        }
+        for (k = 0; k < stringcount && strlen(fields[k + 1]) < MAX_NAME; k++)
+            ;
+        if (k < stringcount) {
+            fprintf(stderr, "LINE %d: FIELD LONGER THAN %d CHARACTERS.\n", reader->line, MAX_NAME - 1);
+            failed++;
+            continue;
+        }
+        if (convert != NULL && convert(fields, record, reader->line) != 0) {
+            failed++;
+            continue;
+        }
+        if ((k = addID(&ids, id)) <= 0) {
+            if (k < 0) {
+                result = -1;
+                break;
+            }
+            fprintf(stderr, "LINE %d: DUPLICATE ID %d.\n", reader->line, id);
+            failed++;
+            continue;
+        }
+        if (id >= header.next_id)
+            header.next_id = id + 1;
+        memcpy(record, &id, sizeof(int));
+        for (k = 0; k < stringcount; k++) {
+            len = (unsigned short)strlen(fields[k + 1]);
+            fwrite(&len, sizeof(len), 1, heapfp);
+            fwrite(fields[k + 1], 1, len + 1, heapfp); // including the null character
+            offset = (int)heapsize;
+            heapsize += sizeof(len) + len + 1;
+            memcpy(record + sizeof(int) * (k + 1), &offset, sizeof(int));
+        }
+        applied++;
+        if (++blocked == IMPORT_BLOCK) {
+            if (fwrite(block, records->recordsize, blocked, fp) != (size_t)blocked)
+                result = -1;
+            header.count += blocked;
+            blocked = 0;
+        }
+    }
+    if (result == 0 && blocked > 0) {
+        if (fwrite(block, records->recordsize, blocked, fp) != (size_t)blocked)
+            result = -1;
+        header.count += blocked;
+    }
+    free(ids.ids);
+    fclose(reader->fp);
+    if (result == 0 && (ferror(heapfp) || fflush(heapfp) != 0 || (wal.durability != DURABILITY_NONE && (syncFile(heapfp) != 0 || syncFile(fp) != 0))))
+        result = -1; // the strings and records must be on disk before the header counts them
+    if (result == 0 && (writeRecordHeader(fp, records->filename, &header) != 0 || (wal.durability != DURABILITY_NONE && syncFile(fp) != 0)))
+        result = -1;
+    if (fclose(heapfp) != 0 || fclose(fp) != 0)
+        result = -1;
+    if (result != 0) {
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", records->filename);
+        return -1;
+    }
+    printf(" => Import %s: %d record(s) added, %d row(s) rejected.\n", csvname, applied, failed);
+    return failed;
+}
+/**
+ * @brief Set the unit price and version of a product record imported from CSV
+ * 
+ * @param fields columns of the row: id, name, description, category, unit, unit price
+ * @param record ProductRecord buffer
+ * @param lineno line of the row in the CSV file
+ * @return int 0 - success | -1 invalid price
+ */
+int importProductColumns(char ** fields, void * record, int lineno) {
+    ProductRecord * product = record;
+    if ((product->unit_price = parseMoney(fields[5])) < 0) {
+        fprintf(stderr, "LINE %d: INVALID PRICE %s.\n", lineno, fields[5]);
+        return -1;
+    }
+    product->version = 1;
+    return 0;
+}
+/**
+ * @brief Write the live records as CSV rows, one record at a time through a large output buffer
+ * 
+ * @param csvname CSV file, replaced if it exists
+ * @param records records view
+ * @param heap string heap view of the records
+ * @param stringcount count of string offsets following the id in each record
+ * @param columns column names of the first row
+ * @param extra writes the other columns of a record after its strings; NULL if the records only have strings
+ * @return int 0 - success | -1 error
+ */
+int exportCsv(const char * csvname, RecordView * records, RecordView * heap, int stringcount, const char * columns, void (*extra)(const void * record, FILE * fp)) {
+    FILE * fp;
+    const char * record;
+    int i, k, id, offset, count, exported = 0;
+    if ((fp = fopen(csvname, "wb")) == NULL) {
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", csvname);
+        return -1;
+    }
+    setvbuf(fp, NULL, _IOFBF, CSV_BUFFER_SIZE);
+    fprintf(fp, "%s\r\n", columns);
+    count = refreshRecordView(records);
+    refreshRecordView(heap);
+    for (i = 0; i < count; i++) {
+        record = (const char *)records->base + (size_t)i * records->recordsize;
+        memcpy(&id, record, sizeof(int)); // all record structs start with the int id
+        if (id == DELETED_ID)
+            continue;
+        fprintf(fp, "%d", id);
+        for (k = 0; k < stringcount; k++) {
+            memcpy(&offset, record + sizeof(int) * (k + 1), sizeof(int));
+            fputc(',', fp);
+            writeCsvField(fp, heapString(heap, offset));
+        }
+        if (extra != NULL)
+            extra(record, fp);
+        fputs("\r\n", fp);
+        exported++;
+    }
+    k = ferror(fp);
+    if (fclose(fp) != 0 || k != 0) {
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", csvname);
+        return -1;
+    }
+    printf(" => Export %s: %d record(s) written.\n", csvname, exported);
+    return 0;
+}
+/**
+ * @brief Write the unit price column of a product record exported as CSV
+ * 
+ * @param record ProductRecord
+ * @param fp CSV file
+ */
+void exportProductColumns(const void * record, FILE * fp) {
+    char money[MONEY_SIZE];
+    fputc(',', fp);
+    fputs(formatMoney(money, ((const ProductRecord *)record)->unit_price), fp);
+}
+/**
+ * @brief Write a CSV field, quoted if it has a comma, a quote or a line break
+ * 
+ * @param fp CSV file
+ * @param field 
+ */
+void writeCsvField(FILE * fp, const char * field) {
+    if (strpbrk(field, ",\"\r\n") == NULL) {
+        fputs(field, fp);
+        return;
+    }
+    fputc('"', fp);
+    for (; *field != 0; field++) {
+        if (*field == '"')
+            fputc('"', fp); // quotes are doubled
+        fputc(*field, fp);
+    }
+    fputc('"', fp);
+}
+/**
+ * @brief Read the next character of a CSV file through the buffer of its reader
+ * 
+ * @param reader CSV reader
+ * @return int the character | EOF
+ */
+int csvGetc(CsvReader * reader) {
+    if (reader->pos == reader->length) {
+        reader->length = fread(reader->buffer, 1, CSV_BUFFER_SIZE, reader->fp);
+        reader->pos = 0;
+        if (reader->length == 0)
+            return EOF;
+    }
+    return (unsigned char)reader->buffer[reader->pos++];
+}
+/**
+ * @brief Read the next row of a CSV file
+ * Fields may be quoted, with doubled quotes inside and line breaks kept; carriage returns outside of
+ * quotes are dropped. The fields point into the row buffer of the reader and are valid until the next row
+ * 
+ * @param reader CSV reader, reader->line is set to the line of the row
+ * @param fields buffer of the fields
+ * @param max most fields
+ * @return int count of fields, more than max if there are too many fields | 0 end of file | -1 row longer than CSV_ROW_SIZE
+ */
+int readCsvRow(CsvReader * reader, char ** fields, int max) {
+    size_t n = 0;
+    int c, count = 1, quoted = 0, toolong = 0;
+    reader->line = reader->next;
+    if ((c = csvGetc(reader)) == EOF)
+        return 0;
+    fields[0] = reader->row;
+    while (c != EOF) {
+        if (quoted) {
+            if (c == '"' && (c = csvGetc(reader)) != '"') {
+                quoted = 0; // closing quote, c is the character after it
+                continue;
+            }
+            if (c == '\n')
+                reader->next++;
+        }
+        else if (c == '"') {
+            quoted = 1;
+            c = csvGetc(reader);
+            continue;
+        }
+        else if (c == '\n')
+            break;
+        else if (c == '\r') {
+            c = csvGetc(reader);
+            continue;
+        }
+        else if (c == ',')
+            c = 0; // end of the field
+        if (n + 1 >= CSV_ROW_SIZE)
+            toolong = 1; // the rest of the row is skipped
+        else {
+            reader->row[n++] = (char)c;
+            if (c == 0 && count++ < max)
+                fields[count - 1] = reader->row + n;
+        }
+        c = csvGetc(reader);
+    }
+    reader->row[n] = 0;
+    reader->next++;
+    return toolong ? -1 : count;
+}
+/**
+ * @brief Add a record ID to a hash set, growing the set by doubling
+ * 
+ * @param set ID hash set
+ * @param id record ID, greater than 0
+ * @return int 1 - added | 0 - already in the set | -1 error
+ */
+int addID(IdSet * set, int id) {
+    int * ids, capacity, k;
+    unsigned int mask, i;
+    if ((set->used + 1) * 4 > set->capacity * 3) {
+        capacity = set->capacity > 0 ? set->capacity * 2 : 1024;
+        if ((ids = calloc(capacity, sizeof(int))) == NULL) // calloc zeroes the slots to EMPTY_ID
+            return -1;
+        mask = (unsigned int)capacity - 1;
+        for (k = 0; k < set->capacity; k++) {
+            if (set->ids[k] == EMPTY_ID)
+                continue;
+            for (i = hashID(set->ids[k]) & mask; ids[i] != EMPTY_ID; i = (i + 1) & mask)
+                ;
+            ids[i] = set->ids[k];
+        }
+        free(set->ids);
+        set->ids = ids;
+        set->capacity = capacity;
+    }
+    mask = (unsigned int)set->capacity - 1;
+    for (i = hashID(id) & mask; set->ids[i] != EMPTY_ID; i = (i + 1) & mask) {
+        if (set->ids[i] == id)
+            return 0;
+    }
+    set->ids[i] = id;
+    set->used++;
+    return 1;
+}
 /**
  * @brief Add new Product Details
  * 
@@ -333,39 +1630,33 @@ void sales_menu(void) {
  */
 int prod_add(void) {
     clrscr(); // clear the screen terminal
-    int count, index; // count - count of new records; index - the last count before adding one record.
     char save; // for yes or no if want to save record or not
-    index = getRecordCount(PRODUCTRECORDS, sizeof(Product)); // last count of records before appending
-    count = index + 1; // new count of records after adding one record
-    Product product[count]; // Product struct instance array with count as to how many data can store since we will add new data
-    if (index == 0) { // if record has no records at all
-        memset(&product[0], 0, sizeof(Product)); // clear/zero out the first element of product array
-    } else { // if record has records
-        memset(product, 0, sizeof(product)); // clear/zero out all the elements of product array
-        getProductData(product); // get the Product data from the .bin file and store it to products
-    }
-    product[index].id = getLatestID(PRODUCTRECORDS, sizeof(Product)); // get the latest maximum id of records in Product records
-    product[index].id++; // set product id + 1 to the latest id
+    Product product; // the new Product record which will be appended to the records file
+    memset(&product, 0, sizeof(Product)); // clear/zero out the new product
+    if ((product.id = allocateID(PRODUCTRECORDS, sizeof(ProductRecord), 1)) < 0) { // take the next id from the header of Product records
+        printf("\n => ERROR READING FILE. Product add failed.");
+        return -1;
+    }
     // display add new record fields
     printf("\n ---------- Add Product Details ----------\n\n");
-    printf(" Product ID : %d\n", product[index].id);
+    printf(" Product ID : %d\n", product.id);
     printf(" Product Name : ");
     fflush(stdin); // for scanf purposes
-    scanf("%[^\n]s", product[index].name); // %[^\n]s reads inputted text after newline or [Enter] character '\n'
+    scanf("%[^\n]s", product.name); // %[^\n]s reads inputted text after newline or [Enter] character '\n'
     fflush(stdin); // we need fflush because we use %[^\n]s format
     printf(" Product Description : ");
-    scanf("%[^\n]s", product[index].description);
+    scanf("%[^\n]s", product.description);
     fflush(stdin); // we need fflush because we use %[^\n]s format
     printf(" Product Category : ");
-    scanf("%[^\n]s", product[index].category);
+    scanf("%[^\n]s", product.category);
     fflush(stdin); // we need fflush because we use %[^\n]s format
     printf(" Product Unit : ");
-    scanf("%[^\n]s", product[index].unit);
+    scanf("%[^\n]s", product.unit);
     fflush(stdin); // we need fflush because we use %[^\n]s format
     do {
         printf(" Product Unit Price : ");
-        customScanfDefaultFloat(&product[index].unit_price, -1.0); // custom scanf with default value -1.0 if empty input or invalid input and put float value in product[index].unit_price
-    } while (product[index].unit_price < 0.0);// if inputted amount is invalid, repeat input
+        customScanfDefaultMoney(&product.unit_price, -1); // custom scanf with default value -1 if empty input or invalid input and put the amount in cents in product.unit_price
+    } while (product.unit_price < 0);// if inputted amount is invalid, repeat input
     printf("\n Save these data?\n"); // prompt to save data
     do {
         printf(" Type 'y' if yes, 'n' if no: ");
@@ -373,7 +1664,7 @@ int prod_add(void) {
         if (save == 'N' || save == 'n')
             return -1; // cancelled / not saved
     } while (!(save == 'y' || save == 'Y'));
-    if (0 == saveProductToFile(product, count)) // 0 means product has saved successfully else error has occured
+    if (0 == storeProduct(&product, -1)) // 0 means product has saved successfully else error has occured
         printf("\n => Product added successfully!\n\n");
     else {
         printf("\n => ERROR WRITING TO FILE. Product add failed.");
@@ -388,27 +1679,20 @@ int prod_add(void) {
 void prod_display(void) {
     clrscr(); // clear the screen
     int i, count = 0;
-    char name[20], desc[20], cat[20], p_unit[20], p_price[15]; // product details char buffer for center and right-align positions purposes of string
-    count = getRecordCount(PRODUCTRECORDS, sizeof(Product)); // get the record count of product records
-    Product products[count]; // declare product struct instance array with count as to how many data can be stored
+    count = refreshCatalog(&productCatalog); // get the record count of product records
+    const ProductRecord * products = productView.base; // product records are read directly from the mapped file
     if (count < 1) // if no records
         goto displayEmptyResults; // redirect to empty records
-    getProductData(products); // get product data
-    printf("\n ---------- Display Product Details ----------\n\n");
-    printf(" %s%s%s%s%s%s\n\n", "Product ID", "    Product Name    ", "Product Description ", "  Product Category  ", "    Product Unit    ", " Product Unit Price ");
+    // the whole table is rendered to one buffer and written at once
+    appendOutput(&tableOutput, "\n ---------- Display Product Details ----------\n\n"
+        " Product ID    Product Name    Product Description   Product Category      Product Unit     Product Unit Price \n\n");
     for (i = 0; i < count; i++) {
-        // copy to buffer for center positions
-        strcpy(name, centerTheString(products[i].name, sizeof(name)));
-        strcpy(desc, centerTheString(products[i].description, sizeof(desc)));
-        strcpy(cat, centerTheString(products[i].category, sizeof(cat)));
-        strcpy(p_unit, centerTheString(products[i].unit, sizeof(p_unit)));
-        // display data
-        printf("  %08d %s%s%s%s", products[i].id, name, desc, cat, p_unit);
-        // copy to buffer for right-align position
-        strcpy(p_price, rightAlignFloat(products[i].unit_price, sizeof(p_price)));
-        printf("%s\n", p_price); // display price
-    }
-    printf("\n ---------------------------------------------\n\n");
+        if (products[i].id == DELETED_ID)
+            continue; // skip deleted record slots
+        renderProductRow(&tableOutput, &products[i]);
+    }
+    appendOutput(&tableOutput, "\n ---------------------------------------------\n\n");
+    flushOutput(&tableOutput);
     getch();
     return; // end of display
     displayEmptyResults: // label for displaying empty product details
@@ -472,35 +1756,22 @@ void prod_sud_menu(const char * request) {
 int prod_search_id(int id, const char * request) {
     clrscr(); // clear the screen terminal
     int i, count, selectedIndex = -1; // selectIndex is the selected index from products struct array instance which is for updating values
-    char endchoice, name[20], desc[20], cat[20], p_unit[20], p_price[15]; // character buffer for positioning in display
-    count = getRecordCount(PRODUCTRECORDS, sizeof(Product)); // current count of records of Product Records
-    Product products[count], productSelected; // array of products with count and a selected product instance for display, update and delete
-    memset(products, 0, sizeof(products)); // clear/zero out the elements of products struct array
+    char endchoice, money[MONEY_SIZE];
+    count = refreshCatalog(&productCatalog); // current count of records of Product Records
+    const ProductRecord * products = productView.base; // product records read directly from the mapped file
+    Product productSelected; // a selected product instance for display, update and delete
     memset(&productSelected, 0, sizeof(productSelected)); // clear/zero out the selected product struct instance
     if (count < 1)
         goto NoRecords; // redirect to no records found label since record count is 0
-    getProductData(products); // read from file to products struct
     printf("\n ---------- %s Product Details ----------\n\n", capitalize(request)); // capitalize first letter of request argument
     printf(" %s%s%s%s%s%s\n\n", "Product ID", "    Product Name    ", "Product Description ", "  Product Category  ", "    Product Unit    ", " Product Unit Price ");
     for (i=0; i < count; i++) {
-        if (products[i].id == id) {
+        if (products[i].id == id && id != DELETED_ID) {
             selectedIndex = i;
             // copy to selected
-            productSelected.id = products[selectedIndex].id;
-            strcpy(productSelected.name, products[selectedIndex].name);
-            strcpy(productSelected.description, products[selectedIndex].description);
-            strcpy(productSelected.category, products[selectedIndex].category);
-            strcpy(productSelected.unit, products[selectedIndex].unit);
-            productSelected.unit_price = products[selectedIndex].unit_price;
-            // copy to display
-            strcpy(name, centerTheString(products[i].name, sizeof(name)));
-            strcpy(desc, centerTheString(products[i].description, sizeof(desc)));
-            strcpy(cat, centerTheString(products[i].category, sizeof(cat)));
-            strcpy(p_unit, centerTheString(products[i].unit, sizeof(p_unit)));
-            // display data
-            printf("  %08d %s%s%s%s", products[i].id, name, desc, cat, p_unit);
-            strcpy(p_price, rightAlignFloat(products[i].unit_price, sizeof(p_price)));
-            printf("%s\n", p_price);
+            loadProduct(&products[selectedIndex], &productSelected);
+            renderProductRow(&tableOutput, &products[i]);
+            flushOutput(&tableOutput);
             goto Found; // redirect to Found label
         }
     }
@@ -533,8 +1804,8 @@ int prod_search_id(int id, const char * request) {
             customScanfDefaultString(productSelected.category, oldData.category);
             printf(" Product Unit (%s): ", oldData.unit);
             customScanfDefaultString(productSelected.unit, oldData.unit);
-            printf(" Product Unit Price (%.2f): ", oldData.unit_price);
-            customScanfDefaultFloat(&productSelected.unit_price, oldData.unit_price);
+            printf(" Product Unit Price (%s): ", formatMoney(money, oldData.unit_price));
+            customScanfDefaultMoney(&productSelected.unit_price, oldData.unit_price);
             printf("\n Save modified data?\n");
             do {
                 printf(" Type 'y' if yes, 'n' if no: ");
@@ -543,16 +1814,9 @@ int prod_search_id(int id, const char * request) {
                     goto SearchAgain; // cancelled / not saved
                 }
             } while (!(savedata == 'y' || savedata == 'Y' || savedata == 'n' || savedata == 'N'));
-            // copy modified data to all products struct array with selected index for writing to file
-            products[selectedIndex].id = productSelected.id;
-            strcpy(products[selectedIndex].name, productSelected.name);
-            strcpy(products[selectedIndex].description, productSelected.description);
-            strcpy(products[selectedIndex].category, productSelected.category);
-            strcpy(products[selectedIndex].unit, productSelected.unit);
-            products[selectedIndex].unit_price = productSelected.unit_price;
-            // save to file with products struct array as the data source
-            if (0 != saveProductToFile(products, count)) { // and count as to how many records to write
-                printf(" Something went wrong. Try again.\n\n"); // if saveProductToFile() returns -1, it fails
+            // overwrite only the record slot of the selected product in file with the modified data
+            if (0 != storeProduct(&productSelected, selectedIndex)) {
+                printf(" Something went wrong. Try again.\n\n"); // if writeRecordAt() returns -1, it fails
                 goto SearchAgain; // redirect to SearchAgain label
             }
             // successfully updated
@@ -568,23 +1832,7 @@ int prod_search_id(int id, const char * request) {
                     goto SearchAgain; // if not redirect to search again label
             } while (!(dchoice == 'y' || dchoice == 'Y' || dchoice == 'n' || dchoice == 'N'));
             printf(" ==> Deleting Record...\n");
-            int newCount = 0, j = 0; // newCount will be the new count of the records after deleting one record
-            Product productsNew[count]; // products struct array for writing to file after delete
-            memset(productsNew, 0, sizeof(productsNew)); // clear/zero-out productsNew struct array
-            for (i = 0; i < count; i++) {
-                if (products[i].id == id) // if selected id is the products[i].id then skip
-                    continue; // skip loop if selected id is the products[i].id
-                // else copy the record/row to productsNew[i]
-                productsNew[j].id = products[i].id;
-                strcpy(productsNew[j].name, products[i].name);
-                strcpy(productsNew[j].description, products[i].description);
-                strcpy(productsNew[j].category, products[i].category);
-                strcpy(productsNew[j].unit, products[i].unit);
-                productsNew[j].unit_price = products[i].unit_price;
-                j++; // j for productsNew index
-                newCount++; // new count
-            }
-            if (0 != saveProductToFile(productsNew, newCount)) { // if returns 0, success
+            if (0 != deleteProduct(selectedIndex)) { // mark the record slot as deleted, if returns 0, success
                 printf(" Something went wrong. Try again.\n\n"); // else file write error
                 goto SearchAgain; // search again if error occured
             }
@@ -620,50 +1868,49 @@ int prod_search_id(int id, const char * request) {
  */
 int prod_search_name(const char * prod_name, const char * request) {
     clrscr();
-    int i, k, l = 0, count, selectedIndex = -1, recordsCount = 0, selectedID = -1;
-    char endchoice, name[20], desc[20], cat[20], p_unit[20], p_price[15]; // char buffer for center and right-align positions for display
-    count = getRecordCount(PRODUCTRECORDS, sizeof(Product));
-    int selectedIndexes[count]; // for storing one or more selected indexes of the searched name
-    Product products[count], productSelected[count], selectedProduct; // array of products with count
-    // clear or zero-out struct and arrays
-    memset(selectedIndexes, 0, sizeof(selectedIndexes));
-    memset(products, 0, sizeof(products));
-    memset(productSelected, 0, sizeof(productSelected));
+    int i, c, candidatesCount, l = 0, count, selectedIndex = -1, recordsCount = 0, selectedID = -1;
+    char endchoice, money[MONEY_SIZE];
+    count = refreshCatalog(&productCatalog);
+    const ProductRecord * products = productView.base; // product records read directly from the mapped file
+    int * selectedIndexes, * candidates; // for storing one or more selected indexes of the searched name
+    Product * productSelected, selectedProduct; // searched products, loaded once the search is done
+    // clear or zero-out struct
     memset(&selectedProduct, 0, sizeof(selectedProduct));
     if (count < 1)
         goto NoRecords; // no records found since count is 0
-    getProductData(products); // read from file to products struct
+    // the buffers come from the record arena, they are all freed after the menu operation
+    selectedIndexes = arenaAlloc(&recordArena, count * sizeof(int));
+    candidates = arenaAlloc(&recordArena, count * sizeof(int));
+    if (selectedIndexes == NULL || candidates == NULL) {
+        fprintf(stderr, "NOT ENOUGH MEMORY TO SEARCH %d RECORDS.\n", count);
+        goto NoRecords;
+    }
     printf("\n ---------- %s Product Details ----------\n\n", capitalize(request));
     printf(" %s%s%s%s%s%s\n\n", "Product ID", "    Product Name    ", "Product Description ", "  Product Category  ", "    Product Unit    ", " Product Unit Price ");
-    for (i=0; i < count; i++) {
-        for (k = 0; k < strlen(products[i].name); k++) {
-            if (0 == strnicmp(products[i].name + k, prod_name, strlen(prod_name))) { // products[i].name + k means begining of k index to compare prod_name with string length of prod_name
-                // copy to selected
-                productSelected[l].id = products[i].id;
-                strcpy(productSelected[l].name, products[i].name);
-                strcpy(productSelected[l].description, products[i].description);
-                strcpy(productSelected[l].category, products[i].category);
-                strcpy(productSelected[l].unit, products[i].unit);
-                productSelected[l].unit_price = products[i].unit_price;
-                // copy index i to selectedIndexes[l]
-                selectedIndexes[l] = i;
-                // copy to display
-                strcpy(name, centerTheString(products[i].name, sizeof(name)));
-                strcpy(desc, centerTheString(products[i].description, sizeof(desc)));
-                strcpy(cat, centerTheString(products[i].category, sizeof(cat)));
-                strcpy(p_unit, centerTheString(products[i].unit, sizeof(p_unit)));
-                // display data
-                printf("  %08d %s%s%s%s", products[i].id, name, desc, cat, p_unit);
-                strcpy(p_price, rightAlignFloat(products[i].unit_price, sizeof(p_price)));
-                printf("%s\n", p_price);
-                recordsCount++;
-                l++; // l for productSelected index
-                break; // break for k loop since name has been found
-            }
+    // the trigram index gives the candidate records, which are then checked against the name
+    if ((candidatesCount = searchTrigrams(&productTrigrams, prod_name, candidates, count)) < 0) {
+        for (i = 0; i < count; i++) // name search shorter than a trigram, every record is a candidate
+            candidates[i] = i;
+        candidatesCount = count;
+    }
+    for (c = 0; c < candidatesCount; c++) {
+        i = candidates[c];
+        if (i >= count || products[i].id == DELETED_ID)
+            continue; // skip deleted record slots and records added after the view was refreshed
+        if (containsIgnoreCase(productString(products[i].name), prod_name)) {
+            // copy index i to selectedIndexes[l]
+            selectedIndexes[l] = i;
+            renderProductRow(&tableOutput, &products[i]);
+            recordsCount++;
+            l++; // l for productSelected index
         }
     }
-    if (recordsCount > 0)
+    flushOutput(&tableOutput);
+    if (recordsCount > 0 && (productSelected = arenaAlloc(&recordArena, l * sizeof(Product))) != NULL) {
+        for (i = 0; i < l; i++) // copy to selected, only the found products take a Product struct
+            loadProduct(&products[selectedIndexes[i]], &productSelected[i]);
         goto Found;
+    }
     NotFound:
         goto EndNoRecTable; // no records found redirect
     Found:
@@ -724,8 +1971,8 @@ int prod_search_name(const char * prod_name, const char * request) {
                 customScanfDefaultString(selectedProduct.category, oldData.category);
                 printf(" Product Unit (%s): ", oldData.unit);
                 customScanfDefaultString(selectedProduct.unit, oldData.unit);
-                printf(" Product Unit Price (%.2f): ", oldData.unit_price);
-                customScanfDefaultFloat(&selectedProduct.unit_price, oldData.unit_price);
+                printf(" Product Unit Price (%s): ", formatMoney(money, oldData.unit_price));
+                customScanfDefaultMoney(&selectedProduct.unit_price, oldData.unit_price);
                 printf("\n Save modified data?\n");
                 do {
                     printf(" Type 'y' if yes, 'n' if no: ");
@@ -734,15 +1981,8 @@ int prod_search_name(const char * prod_name, const char * request) {
                         goto SearchAgain; // cancelled / not saved
                     }
                 } while (!(savedata == 'y' || savedata == 'Y' || savedata == 'n' || savedata == 'N'));
-                // copy modified data to all products selected index
-                products[selectedIndex].id = selectedProduct.id;
-                strcpy(products[selectedIndex].name, selectedProduct.name);
-                strcpy(products[selectedIndex].description, selectedProduct.description);
-                strcpy(products[selectedIndex].category, selectedProduct.category);
-                strcpy(products[selectedIndex].unit, selectedProduct.unit);
-                products[selectedIndex].unit_price = selectedProduct.unit_price;
-                // save to file
-                if (0 != saveProductToFile(products, count)) {
+                // overwrite only the record slot of the selected product in file with the modified data
+                if (0 != storeProduct(&selectedProduct, selectedIndex)) {
                     printf(" Something went wrong. Try again.\n\n");
                     goto SearchAgain;
                 }
@@ -756,14 +1996,18 @@ int prod_search_name(const char * prod_name, const char * request) {
                     printf(" Enter ID: ");
                     customScanfDefaultInt(&selectedID, -1);
                     for (i = 0; i < l; i++) {
-                        if (productSelected[i].id == selectedID) // if selectedID is found,
+                        if (productSelected[i].id == selectedID) { // if selectedID is found,
+                            selectedIndex = selectedIndexes[i]; // record slot of the selected product
                             goto IDSelectedDelete; // break and redirect to IDSelectedDelete label
+                        }
                     }
                     selectedID = -1;
                     printf(" ID not in selection! Please Try Again.\n");
                 } while(selectedID < 0);
-            } else
+            } else {
                 selectedID = productSelected[0].id;
+                selectedIndex = selectedIndexes[0];
+            }
             IDSelectedDelete: // ID has selected label
                 // same process with prod_search_id() for deleting
                 char dchoice;
@@ -776,23 +2020,7 @@ int prod_search_name(const char * prod_name, const char * request) {
                         goto SearchAgain;
                 } while (!(dchoice == 'y' || dchoice == 'Y' || dchoice == 'n' || dchoice == 'N'));
                 printf(" ==> Deleting Record...\n");
-                int newCount = 0, j = 0;
-                Product productsNew[count];
-                memset(productsNew, 0, sizeof(productsNew));
-                for (i = 0; i < count; i++) {
-                    if (products[i].id == selectedID)
-                        continue; // skip loop if selectedIndex is equal to i to be deleted
-                    // else copy the record/row to productsNew[i]
-                    productsNew[j].id = products[i].id;
-                    strcpy(productsNew[j].name, products[i].name);
-                    strcpy(productsNew[j].description, products[i].description);
-                    strcpy(productsNew[j].category, products[i].category);
-                    strcpy(productsNew[j].unit, products[i].unit);
-                    productsNew[j].unit_price = products[i].unit_price;
-                    j++; // j for productsNew index
-                    newCount++; // new count
-                }
-                if (0 != saveProductToFile(productsNew, newCount)) {
+                if (0 != deleteProduct(selectedIndex)) {
                     printf(" Something went wrong. Try again.\n\n");
                     goto SearchAgain;
                 }
@@ -817,6 +2045,121 @@ int prod_search_name(const char * prod_name, const char * request) {
     EndNoRec:
         return -1;
 }
+/**
+ * @brief Product Stock Menu
+ * 
+ */
+void stock_menu(void) {
+    clrscr();
+    int choice;
+    printf("\n ---------- Product Stock ----------\n\n");
+    printf(" [1] Receive\n");
+    printf(" [2] Adjust\n");
+    printf(" [3] Reorder Level\n");
+    printf(" [4] Low Stock\n");
+    printf(" [5] Go Back\n");
+    printf("\n -----------------------------------\n\n");
+    do {
+        printf(" Choice: ");
+        dscanc(&choice); // single-input integer value choose from 1-5
+        if (!(choice > 0 && choice < 6))
+            printf(" Invalid Choice!\n");
+    } while (!(choice > 0 && choice < 6));
+    switch (choice) {
+        case 1: // units delivered
+            stock_update(STOCK_ADD);
+            break;
+        case 2: // units counted on the shelf
+            stock_update(STOCK_COUNT);
+            break;
+        case 3: // low stock threshold
+            stock_update(STOCK_REORDER);
+            break;
+        case 4: // products to reorder
+            stock_low();
+            break;
+        // else go back to menu
+    }
+}
+/**
+ * @brief Receive units of a product, adjust its stock to the units counted, or set its reorder level
+ * The stock of a product is tracked from its first change, the checkouts only remove the units of the tracked products
+ * 
+ * @param op STOCK_ADD | STOCK_COUNT | STOCK_REORDER
+ */
+void stock_update(int op) {
+    clrscr();
+    int id = -1, quantity = -1;
+    Product product;
+    StockChange change;
+    const StockRecord * stock;
+    printf("\n ---------- %s ----------\n\n", op == STOCK_ADD ? "Receive Stock" : op == STOCK_COUNT ? "Adjust Stock" : "Reorder Level");
+    printf(" Product ID : ");
+    customScanfDefaultInt(&id, -1);
+    if (getProductByID(&product, id) != 0) {
+        printf(" => Product not found.\n");
+        getch();
+        return;
+    }
+    printf(" Product Name : %s\n", product.name);
+    if ((stock = findStock(id)) != NULL) {
+        printf(" On Hand : %d %s\n", stock->quantity, product.unit);
+        printf(" Reorder Level : %d\n", stock->reorder_level);
+    }
+    else
+        printf(" On Hand : (not tracked)\n");
+    printf(op == STOCK_ADD ? " Units Received : " : op == STOCK_COUNT ? " Units Counted : " : " New Reorder Level : ");
+    customScanfDefaultInt(&quantity, -1);
+    if (quantity < 0 || (op == STOCK_ADD && quantity == 0)) {
+        printf(" => Invalid quantity. Stock was not changed.\n");
+        getch();
+        return;
+    }
+    change.product_id = id;
+    change.op = op;
+    change.quantity = quantity;
+    change.sequence = 0;
+    if (applyStockChanges(&change, 1, 1) != 0) {
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", STOCKRECORDS);
+        getch();
+        return;
+    }
+    stock = findStock(id);
+    printf(" => Stock saved. On Hand : %d, Reorder Level : %d\n", stock != NULL ? stock->quantity : 0, stock != NULL ? stock->reorder_level : 0);
+    getch();
+}
+/**
+ * @brief Display the tracked products whose units on hand are at or below their reorder level
+ * 
+ */
+void stock_low(void) {
+    clrscr();
+    int i, count, low = 0;
+    const StockRecord * stock;
+    const ProductRecord * product;
+    TableCell cells[4];
+    count = refreshRecordView(&stockView);
+    stock = stockView.base;
+    appendOutput(&tableOutput, "\n ---------- Low Stock ----------\n\n"
+        " Product ID    Product Name         On Hand      Reorder Level \n\n");
+    for (i = 1; i < count; i++) { // the stock of a product is in the slot of its ID, IDs start at 1
+        if (stock[i].product_id != i || stock[i].quantity > stock[i].reorder_level)
+            continue; // not tracked, or enough units on hand
+        if ((product = findProductRecord(i)) == NULL)
+            continue; // deleted product
+        cells[0].number = i;
+        cells[1].text = productString(product->name);
+        cells[2].number = stock[i].quantity;
+        cells[3].number = stock[i].reorder_level;
+        renderRow(&tableOutput, stockColumns, cells, 4);
+        low++;
+    }
+    if (low == 0)
+        appendOutput(&tableOutput, " => No product is low on stock\n");
+    appendOutput(&tableOutput, "\n -------------------------------\n\n");
+    flushOutput(&tableOutput);
+    getch();
+}
 /**
  * @brief Add new Teller Details
  * 
@@ -825,31 +2168,25 @@ int prod_search_name(const char * prod_name, const char * request) {
 int teller_add(void) {
     // same process with prod_add except the data are different
     clrscr();
-    int count, index;
     char save;
-    index = getRecordCount(TELLERRECORDS, sizeof(Teller));
-    count = index + 1;
-    Teller teller[count];
-    if (index == 0) { // if record has no records at all
-        memset(&teller[0], 0, sizeof(Teller));
-    } else { // if record has records
-        memset(teller, 0, sizeof(teller));
-        getTellerData(teller);
-    }
+    Teller teller;
+    memset(&teller, 0, sizeof(Teller));
     fflush(stdin);
-    teller[index].id = getLatestID(TELLERRECORDS, sizeof(Teller)); // set teller id + 1 to the latest id
-    teller[index].id++;
+    if ((teller.id = allocateID(TELLERRECORDS, sizeof(TellerRecord), 1)) < 0) { // take the next id from the header of Teller records
+        printf("\n => ERROR READING FILE. Teller add failed.");
+        return -1;
+    }
     printf("\n ---------- Add Teller Details ----------\n\n");
-    printf(" Teller ID : %d\n", teller[index].id);
+    printf(" Teller ID : %d\n", teller.id);
     printf(" Teller First Name : ");
     fflush(stdin);
-    scanf("%[^\n]s", teller[index].first_name); // %[^\n]s reads inputted text after newline or [Enter] character '\n'
+    scanf("%[^\n]s", teller.first_name); // %[^\n]s reads inputted text after newline or [Enter] character '\n'
     fflush(stdin); // we need fflush because we use %[^\n]s format
     printf(" Teller Middle Name : ");
-    scanf("%[^\n]s", teller[index].middle_name);
+    scanf("%[^\n]s", teller.middle_name);
     fflush(stdin); // we need fflush because we use %[^\n]s format
     printf(" Teller Last Name : ");
-    scanf("%[^\n]s", teller[index].last_name);
+    scanf("%[^\n]s", teller.last_name);
     fflush(stdin); // we need fflush because we use %[^\n]s format
     printf("\n Save these data?\n");
     do {
@@ -858,7 +2195,7 @@ int teller_add(void) {
         if (save == 'N' || save == 'n')
             return -1; // cancelled / not saved
     } while (!(save == 'y' || save == 'Y'));
-    if (0 == saveTellerToFile(teller, count))
+    if (0 == storeTeller(&teller, -1))
         printf("\n => Teller details added successfully!\n\n");
     else
         printf("\n => ERROR WRITING TO FILE. Teller details add failed.");
@@ -872,22 +2209,19 @@ void teller_display(void) {
     // same method with prod_display except the data are different
     clrscr();
     int i, count = 0;
-    char first_name[26], middle_name[26], last_name[26];
-    count = getRecordCount(TELLERRECORDS, sizeof(Teller));
-    Teller tellers[count];
+    count = refreshCatalog(&tellerCatalog);
+    const TellerRecord * tellers = tellerView.base; // teller records read directly from the mapped file
     if (count < 1)
         goto displayEmptyResults; // redirect to empty records
-    getTellerData(tellers); // get teller records
-    printf("\n ---------- Display Teller Details ----------\n\n");
-    printf(" %s%s%s%s\n\n", "Teller ID", "     Teller First Name    ", "    Teller Middle Name    ", "     Teller Last Name     ");
+    appendOutput(&tableOutput, "\n ---------- Display Teller Details ----------\n\n"
+        " Teller ID     Teller First Name        Teller Middle Name         Teller Last Name     \n\n");
     for (i = 0; i < count; i++) {
-        strcpy(first_name, centerTheString(tellers[i].first_name, sizeof(first_name)));
-        strcpy(middle_name, centerTheString(tellers[i].middle_name, sizeof(middle_name)));
-        strcpy(last_name, centerTheString(tellers[i].last_name, sizeof(last_name)));
-        // display data
-        printf("  %08d %s%s%s\n", tellers[i].id, first_name, middle_name, last_name);
+        if (tellers[i].id == DELETED_ID)
+            continue; // skip deleted record slots
+        renderTellerRow(&tableOutput, &tellers[i]);
     }
-    printf("\n --------------------------------------------\n\n");
+    appendOutput(&tableOutput, "\n --------------------------------------------\n\n");
+    flushOutput(&tableOutput);
     getch();
     return; // end of display
     displayEmptyResults: // label for displaying empty teller details
@@ -952,30 +2286,22 @@ int teller_search_id(int id, const char * request) {
     // same method with prod_search_id except the data are different
     clrscr();
     int i, count, selectedIndex = -1;
-    char endchoice, first_name[26], middle_name[26], last_name[26];
-    count = getRecordCount(TELLERRECORDS, sizeof(Teller));
-    Teller tellers[count], tellerSelected; // array of tellers with count
-    memset(tellers, 0, sizeof(tellers));
+    char endchoice;
+    count = refreshCatalog(&tellerCatalog);
+    const TellerRecord * tellers = tellerView.base; // teller records read directly from the mapped file
+    Teller tellerSelected;
     memset(&tellerSelected, 0, sizeof(tellerSelected));
     if (count < 1)
         goto NoRecords; // no records found since count is 0
-    getTellerData(tellers); // read from file to tellers struct
     printf("\n ---------- %s Teller Details ----------\n\n", capitalize(request));
     printf(" %s%s%s%s\n\n", "Teller ID", "     Teller First Name    ", "    Teller Middle Name    ", "     Teller Last Name     ");
     for (i=0; i < count; i++) {
-        if (tellers[i].id == id) {
+        if (tellers[i].id == id && id != DELETED_ID) {
             selectedIndex = i;
             // copy to selected
-            tellerSelected.id = tellers[selectedIndex].id;
-            strcpy(tellerSelected.first_name, tellers[selectedIndex].first_name);
-            strcpy(tellerSelected.middle_name, tellers[selectedIndex].middle_name);
-            strcpy(tellerSelected.last_name, tellers[selectedIndex].last_name);
-            // copy to display
-            strcpy(first_name, centerTheString(tellers[i].first_name, sizeof(first_name)));
-            strcpy(middle_name, centerTheString(tellers[i].middle_name, sizeof(middle_name)));
-            strcpy(last_name, centerTheString(tellers[i].last_name, sizeof(last_name)));
-            // display data
-            printf("  %08d %s%s%s\n", tellers[i].id, first_name, middle_name, last_name);
+            loadTeller(&tellers[selectedIndex], &tellerSelected);
+            renderTellerRow(&tableOutput, &tellers[i]);
+            flushOutput(&tableOutput);
             goto Found; // redirect to Found label
         }
     }
@@ -1010,13 +2336,8 @@ int teller_search_id(int id, const char * request) {
                     goto SearchAgain; // cancelled / not saved
                 }
             } while (!(savedata == 'y' || savedata == 'Y' || savedata == 'n' || savedata == 'N'));
-            // copy modified data to all tellers selected index
-            tellers[selectedIndex].id = tellerSelected.id;
-            strcpy(tellers[selectedIndex].first_name, tellerSelected.first_name);
-            strcpy(tellers[selectedIndex].middle_name, tellerSelected.middle_name);
-            strcpy(tellers[selectedIndex].last_name, tellerSelected.last_name);
-            // save to file
-            if (0 != saveTellerToFile(tellers, count)) {
+            // overwrite only the record slot of the selected teller in file with the modified data
+            if (0 != storeTeller(&tellerSelected, selectedIndex)) {
                 printf(" Something went wrong. Try again.\n\n");
                 goto SearchAgain;
             }
@@ -1032,21 +2353,7 @@ int teller_search_id(int id, const char * request) {
                     goto SearchAgain;
             } while (!(dchoice == 'y' || dchoice == 'Y' || dchoice == 'n' || dchoice == 'N'));
             printf(" ==> Deleting Record...\n");
-            int newCount = 0, j = 0;
-            Teller tellersNew[count];
-            memset(tellersNew, 0, sizeof(tellersNew));
-            for (i = 0; i < count; i++) {
-                if (tellers[i].id == id)
-                    continue; // skip loop if selectedIndex is equal to i to be deleted
-                // else copy the record/row to tellersNew[i]
-                tellersNew[j].id = tellers[i].id;
-                strcpy(tellersNew[j].first_name, tellers[i].first_name);
-                strcpy(tellersNew[j].middle_name, tellers[i].middle_name);
-                strcpy(tellersNew[j].last_name, tellers[i].last_name);
-                j++; // j for tellersNew index
-                newCount++; // new count
-            }
-            if (0 != saveTellerToFile(tellersNew, newCount)) {
+            if (0 != deleteTeller(selectedIndex)) {
                 printf(" Something went wrong. Try again.\n\n");
                 goto SearchAgain;
             }
@@ -1081,95 +2388,49 @@ int teller_search_id(int id, const char * request) {
 int teller_search_name(const char * teller_name, const char * request) {
     // same method with prod_search_name except the data are different
     clrscr();
-    int i, k, l = 0, count, selectedIndex = -1, recordsCount = 0, selectedID = -1;
-    char endchoice, first_name[26], middle_name[26], last_name[26];
-    count = getRecordCount(TELLERRECORDS, sizeof(Teller));
-    int selectedIndexes[count];
-    memset(selectedIndexes, 0, sizeof(selectedIndexes));
-    Teller tellers[count], tellerSelected[count], selectedTeller; // array of tellers with count
-    memset(tellers, 0, sizeof(tellers));
-    memset(tellerSelected, 0, sizeof(tellerSelected));
+    int i, c, candidatesCount, l = 0, count, selectedIndex = -1, recordsCount = 0, selectedID = -1;
+    char endchoice;
+    count = refreshCatalog(&tellerCatalog);
+    const TellerRecord * tellers = tellerView.base; // teller records read directly from the mapped file
+    int * selectedIndexes, * candidates;
+    Teller * tellerSelected, selectedTeller; // searched tellers, loaded once the search is done
     memset(&selectedTeller, 0, sizeof(selectedTeller));
     if (count < 1)
         goto NoRecords; // no records found since count is 0
-    getTellerData(tellers); // read from file to tellers struct
+    selectedIndexes = arenaAlloc(&recordArena, count * sizeof(int));
+    candidates = arenaAlloc(&recordArena, count * sizeof(int));
+    if (selectedIndexes == NULL || candidates == NULL) {
+        fprintf(stderr, "NOT ENOUGH MEMORY TO SEARCH %d RECORDS.\n", count);
+        goto NoRecords;
+    }
     printf("\n ---------- %s Teller Details ----------\n\n", capitalize(request));
     printf(" %s%s%s%s\n\n", "Teller ID", "     Teller First Name    ", "    Teller Middle Name    ", "     Teller Last Name     ");
-    for (i=0; i < count; i++) {
-        // search for first name
-        for (k = 0; k < strlen(tellers[i].first_name); k++) {
-            if (0 == strnicmp(tellers[i].first_name + k, teller_name, strlen(teller_name))) {
-                // copy to selected
-                tellerSelected[l].id = tellers[i].id;
-                strcpy(tellerSelected[l].first_name, tellers[i].first_name);
-                strcpy(tellerSelected[l].middle_name, tellers[i].middle_name);
-                strcpy(tellerSelected[l].last_name, tellers[i].last_name);
-                // copy index i to selectedIndexes[l]
-                selectedIndexes[l] = i;
-                // copy to display
-                strcpy(first_name, centerTheString(tellers[i].first_name, sizeof(first_name)));
-                strcpy(middle_name, centerTheString(tellers[i].middle_name, sizeof(middle_name)));
-
-                strcpy(last_name, centerTheString(tellers[i].last_name, sizeof(last_name)));
-
-                // display data
-                printf("  %08d %s%s%s\n", tellers[i].id, first_name, middle_name, last_name);
-                recordsCount++;
-                l++; // l for tellerSelected index
-                break; // break for k loop since name has been found
-            }
-        }
-        // if not first name; then middle name
-        for (k = 0; k < strlen(tellers[i].middle_name); k++) {
-            if (0 == strnicmp(tellers[i].middle_name + k, teller_name, strlen(teller_name))) {
-                if (l > 0)
-                    if (tellerSelected[l-1].id == tellers[i].id)
-                        break; // already selected so skip
-                // copy to selected
-                tellerSelected[l].id = tellers[i].id;
-                strcpy(tellerSelected[l].first_name, tellers[i].first_name);
-                strcpy(tellerSelected[l].middle_name, tellers[i].middle_name);
-                strcpy(tellerSelected[l].last_name, tellers[i].last_name);
-                // copy index i to selectedIndexes[l]
-                selectedIndexes[l] = i;
-                // copy to display
-                strcpy(first_name, centerTheString(tellers[i].first_name, sizeof(first_name)));
-                strcpy(middle_name, centerTheString(tellers[i].middle_name, sizeof(middle_name)));
-                strcpy(last_name, centerTheString(tellers[i].last_name, sizeof(last_name)));
-                // display data
-                printf("  %08d %s%s%s\n", tellers[i].id, first_name, middle_name, last_name);
-                recordsCount++;
-                l++; // l for tellerSelected index
-                break; // break for k loop since name has been found
-            }
-        }
-        // if not first and middle name; then last name
-        for (k = 0; k < strlen(tellers[i].last_name); k++) {
-            if (0 == strnicmp(tellers[i].last_name + k, teller_name, strlen(teller_name))) {
-                if (l > 0)
-                    if (tellerSelected[l-1].id == tellers[i].id)
-                        break; // already selected so skip
-                // copy to selected
-                tellerSelected[l].id = tellers[i].id;
-                strcpy(tellerSelected[l].first_name, tellers[i].first_name);
-                strcpy(tellerSelected[l].middle_name, tellers[i].middle_name);
-                strcpy(tellerSelected[l].last_name, tellers[i].last_name);
-                // copy index i to selectedIndexes[l]
-                selectedIndexes[l] = i;
-                // copy to display
-                strcpy(first_name, centerTheString(tellers[i].first_name, sizeof(first_name)));
-                strcpy(middle_name, centerTheString(tellers[i].middle_name, sizeof(middle_name)));
-                strcpy(last_name, centerTheString(tellers[i].last_name, sizeof(last_name)));
-                // display data
-                printf("  %08d %s%s%s\n", tellers[i].id, first_name, middle_name, last_name);
-                recordsCount++;
-                l++; // l for tellerSelected index
-                break; // break for k loop since name has been found
-            }
+    // the trigram index gives the candidate records, which are then checked against the first, middle and last name
+    if ((candidatesCount = searchTrigrams(&tellerTrigrams, teller_name, candidates, count)) < 0) {
+        for (i = 0; i < count; i++) // name search shorter than a trigram, every record is a candidate
+            candidates[i] = i;
+        candidatesCount = count;
+    }
+    for (c = 0; c < candidatesCount; c++) {
+        i = candidates[c];
+        if (i >= count || tellers[i].id == DELETED_ID)
+            continue; // skip deleted record slots and records added after the view was refreshed
+        if (containsIgnoreCase(tellerString(tellers[i].first_name), teller_name)
+            || containsIgnoreCase(tellerString(tellers[i].middle_name), teller_name)
+            || containsIgnoreCase(tellerString(tellers[i].last_name), teller_name)) {
+            // copy index i to selectedIndexes[l]
+            selectedIndexes[l] = i;
+            renderTellerRow(&tableOutput, &tellers[i]);
+            recordsCount++;
+            l++; // l for tellerSelected index
         }
     }
-    if (recordsCount > 0)
+    flushOutput(&tableOutput);
+    if (recordsCount > 0 && (tellerSelected = arenaAlloc(&recordArena, l * sizeof(Teller))) != NULL) {
+        for (i = 0; i < l; i++) // copy to selected, only the found tellers take a Teller struct
+            loadTeller(&tellers[selectedIndexes[i]], &tellerSelected[i]);
         goto Found;
+    }
     NotFound:
         goto EndNoRecTable; // no records found redirect
     Found:
@@ -1228,13 +2489,8 @@ int teller_search_name(const char * teller_name, const char * request) {
                         goto SearchAgain; // cancelled / not saved
                     }
                 } while (!(savedata == 'y' || savedata == 'Y' || savedata == 'n' || savedata == 'N'));
-                // copy modified data to all tellers selected index
-                tellers[selectedIndex].id = selectedTeller.id;
-                strcpy(tellers[selectedIndex].first_name, selectedTeller.first_name);
-                strcpy(tellers[selectedIndex].middle_name, selectedTeller.middle_name);
-                strcpy(tellers[selectedIndex].last_name, selectedTeller.last_name);
-                // save to file
-                if (0 != saveTellerToFile(tellers, count)) {
+                // overwrite only the record slot of the selected teller in file with the modified data
+                if (0 != storeTeller(&selectedTeller, selectedIndex)) {
                     printf(" Something went wrong. Try again.\n\n");
                     goto SearchAgain;
                 }
@@ -1248,14 +2504,18 @@ int teller_search_name(const char * teller_name, const char * request) {
                     printf(" Enter ID: ");
                     customScanfDefaultInt(&selectedID, -1);
                     for (i = 0; i < l; i++) {
-                        if (tellerSelected[i].id == selectedID)
+                        if (tellerSelected[i].id == selectedID) {
+                            selectedIndex = selectedIndexes[i];
                             goto IDSelectedDelete;
+                        }
                     }
                     selectedID = -1;
                     printf(" ID not in selection! Please Try Again.\n");
                 } while(selectedID < 0);
-            } else
+            } else {
                 selectedID = tellerSelected[0].id;
+                selectedIndex = selectedIndexes[0];
+            }
             IDSelectedDelete: // ID has selected label
                 char dchoice;
                 printf(" Selected ID: %08d\n", selectedID);
@@ -1267,21 +2527,7 @@ int teller_search_name(const char * teller_name, const char * request) {
                         goto SearchAgain;
                 } while (!(dchoice == 'y' || dchoice == 'Y' || dchoice == 'n' || dchoice == 'N'));
                 printf(" ==> Deleting Record...\n");
-                int newCount = 0, j = 0;
-                Teller tellersNew[count];
-                memset(tellersNew, 0, sizeof(tellersNew));
-                for (i = 0; i < count; i++) {
-                    if (tellers[i].id == selectedID)
-                        continue; // skip loop if selectedIndex is equal to i to be deleted
-                    // else copy the record/row to tellersNew[i]
-                    tellersNew[j].id = tellers[i].id;
-                    strcpy(tellersNew[j].first_name, tellers[i].first_name);
-                    strcpy(tellersNew[j].middle_name, tellers[i].middle_name);
-                    strcpy(tellersNew[j].last_name, tellers[i].last_name);
-                    j++; // j for tellersNew index
-                    newCount++; // new count
-                }
-                if (0 != saveTellerToFile(tellersNew, newCount)) {
+                if (0 != deleteTeller(selectedIndex)) {
                     printf(" Something went wrong. Try again.\n\n");
                     goto SearchAgain;
                 }
@@ -1308,65 +2554,89 @@ int teller_search_name(const char * teller_name, const char * request) {
 }
 /**
  * @brief Add new Sale Transaction
+ * The line items and the receipt grow as needed, so a transaction may have any count of line items
  * 
  */
 void sale_add(void) {
     clrscr(); // clears the screen
     fflush(stdin); // for flushing scanf purposes
-    char choice, appendDisplay[5000], // appendDisplay will be the buffer for display
-        buffile[MAX_NAME], datenow[TIME_SIZE], timenow[TIME_SIZE], tempbuf[MAX_NAME]; // these are char buffer for date, time, filename, and temporary
-    int i, j = 0, searchID, latestID, count = 0, index = 0, tempQuantity = -1, newCount = 0; // newCount is the current new records count
-    float payable_amount, cash = -1.0, change;
+    char choice, datenow[TIME_SIZE], timenow[TIME_SIZE]; // these are char buffer for date and time
+    int searchID, tellerID = -1, tempQuantity = -1, i, first, hidden = 0; // hidden is the count of items before the ones shown on screen
+    size_t header, shown; // receipt offsets of the end of the transaction details and of the first item shown on screen
+    long long payable_amount, cash = -1, change; // amounts in cents
+    char money[MONEY_SIZE];
+    Product product; // selected product item, only its id, version and price are stored in the sale transaction
+    Teller teller; // teller of the transaction, only its id is stored in the sale header
+    SaleHeader sale; // header of the transaction with its totals, linked to its line items
+    SaleTransaction * item; // line item being added
+    const StockRecord * stock; // stock of the product of the line item; NULL if not tracked
+    Cart cart = { NULL, NULL, 0, 0, 0 }; // line items of the transaction
+    OutputBuffer receipt = { NULL, 0, 0 }; // receipt shown on screen and written to the transaction text file
     // set the time now
     time_t t;
     struct tm * tmp;
     time(&t); // set time
     tmp = localtime(&t); // set localtime
-    memset(appendDisplay, 0, sizeof(appendDisplay)); // set appendDisplay to empty string
-    memset(buffile, 0, sizeof(buffile)); // set to empty
     memset(datenow, 0, sizeof(datenow)); // set to empty
     memset(timenow, 0, sizeof(timenow)); // set to empty
-    strftime(datenow, sizeof(datenow), "%Y-%m-%d", tmp); // format will be 2022-12-25 for the filename
-    sprintf(buffile, SALETRANSACTIONS, datenow); // we will use date for the filename
-    index = getRecordCount(SALERECORDS, sizeof(SaleTransaction)); // index is the total count of records before adding one or more records
-    latestID = getLatestID(SALERECORDS, sizeof(SaleTransaction)); // set latest maximum id of SaleTransaction data
-    SaleTransaction newSale[MAX_NAME]; // for new records
-    memset(newSale, 0, sizeof(newSale));  // zero-out the sale transaction struct array instance for new records
-    strcat(appendDisplay, "\n ---------- New Transaction ----------\n"); // we append our display to appendDisplay also for writing to .txt file purposes
+    strftime(datenow, sizeof(datenow), "%Y-%m-%d", tmp); // format will be 2022-12-25, the date of the transaction file
+    memset(&sale, 0, sizeof(sale));
+    memset(&teller, 0, sizeof(teller));
+    appendOutput(&receipt, "\n ---------- New Transaction ----------\n"); // the receipt is also written to the .txt file
+    do {
+        clrscr();
+        fwrite(receipt.data, 1, receipt.length, stdout);
+        printf(" Teller ID (0 if none) : ");
+        customScanfDefaultInt(&tellerID, -1);
+    } while (tellerID != 0 && getTellerByID(&teller, tellerID) != 0); // searching for teller details by ID
+    sale.teller_id = tellerID;
+    appendOutput(&receipt, "\n");
+    cart.saleoffset = receipt.length; // the IDs are allocated at checkout
+    if (tellerID != 0)
+        appendOutputf(&receipt, " Teller : %d %s %s\n", teller.id, teller.first_name, teller.last_name);
+    header = shown = receipt.length;
     do {
-        sprintf(tempbuf, "\n Sale ID : %d\n%c", ++latestID, 0); // increment the latestID of recorded sale transaction
-        newSale[newCount].id = latestID; // put the latest ID to the SaleTransaction struct data
-        strcat(appendDisplay, tempbuf);
+        if ((item = addCartItem(&cart)) == NULL) {
+            fprintf(stderr, "NOT ENOUGH MEMORY FOR %d ITEMS. Sale Transaction was not saved", cart.count + 1);
+            goto EndSale;
+        }
+        if ((cart.count - 1) % RECEIPT_SCREEN_ITEMS == 0) { // the screen only shows the last items, so redrawing it does not slow down with the count of items
+            shown = receipt.length;
+            hidden = cart.count - 1;
+        }
+        appendOutput(&receipt, "\n");
+        cart.offsets[cart.count - 1] = receipt.length;
         do {
             clrscr(); // clears the screen
-            printf("%s", appendDisplay); // then display appendDisplay string
+            showReceipt(&receipt, header, shown, hidden);
             printf(" Product ID : "); // We will use product ID...
             customScanfDefaultInt(&searchID, -1); // ...rather than Product name for input to search the specific existing product
-        } while (getProductByID(&newSale[newCount].product, searchID) != 0); // searching for product details by ID and put it in the SaleTransaction data
-        
-        // append display to appendDisplay variable string of the selected product details     
-        sprintf(tempbuf, " Product Name : %s\n%c", newSale[newCount].product.name, 0);
-        strcat(appendDisplay, tempbuf);
-        sprintf(tempbuf, " Product Unit : %s\n%c", newSale[newCount].product.unit, 0);
-        strcat(appendDisplay, tempbuf);
-        sprintf(tempbuf, " Product Price : %.2f\n%c", newSale[newCount].product.unit_price, 0);
-        strcat(appendDisplay, tempbuf);
-        strcat(appendDisplay, " Quantity : ");
+        } while (getProductByID(&product, searchID) != 0); // searching for product details by ID
+        // the sale transaction only refers to the product, with a snapshot of its price
+        item->product_id = product.id;
+        item->product_version = product.version;
+        item->unit_price = product.unit_price;
+        // append the selected product details to the receipt
+        appendOutputf(&receipt, " Product Name : %s\n", product.name);
+        appendOutputf(&receipt, " Product Unit : %s\n", product.unit);
+        appendOutputf(&receipt, " Product Price : %s\n", formatMoney(money, product.unit_price));
+        appendOutput(&receipt, " Quantity : ");
         do {
             clrscr();
-            printf("%s", appendDisplay);
+            showReceipt(&receipt, header, shown, hidden);
             customScanfDefaultInt(&tempQuantity, -1); // defaults to -1 if empty input or invalid
             if (tempQuantity < 1) { // if the inputted quantity is not a whole number
                 printf(" => Quantity should be greater (>) than 0.\n"); // prints an error
                 getch();
             }
         } while (tempQuantity < 0); // loop if inputted quantity is not a whole number
-        newSale[newCount].quantity = tempQuantity; // copy the inputted quantity to sale transaction struct instance for storing and writing to file purposes
-        sprintf(tempbuf, "%d\n%c", newSale[newCount].quantity, 0);
-        strcat(appendDisplay, tempbuf);
+        item->quantity = tempQuantity; // copy the inputted quantity to the line item for storing and writing to file purposes
+        appendOutputf(&receipt, "%d\n", item->quantity);
         clrscr(); // clear the command line screen
-        printf("%s", appendDisplay); // display previous and current product details of selected products
-        newCount++; // increment the 
+        showReceipt(&receipt, header, shown, hidden); // display the details of the last selected products
+        if ((stock = findStock(item->product_id)) != NULL) // shown on screen only, the receipt has no stock
+            printf("\n Stock : %d %s on hand before this sale%s\n", stock->quantity, product.unit,
+                stock->quantity - item->quantity <= stock->reorder_level ? " (low stock)" : "");
         do {
             printf("\n Do you want to add another item?\n");
             printf(" Type 'y' if yes, 'n' if no: ");
@@ -1377,18 +2647,19 @@ void sale_add(void) {
         // repeat if yes
     } while (!(choice == 'n' || choice == 'N')); // if no, the continue here
     clrscr(); // clear the command line screen
-    payable_amount = compute_payable_amount(newSale, newCount); // we compute the payable amount with the recently added record from sale transaction struct instance
+    payable_amount = compute_payable_amount(cart.items, cart.count); // we compute the payable amount with the line items of the cart
     // record payable amount
-    strcat(appendDisplay, " _____________________________________\n");
-    sprintf(tempbuf, " Total Payable Amount:\t%.2f\n%c", payable_amount, 0);
-    strcat(appendDisplay, tempbuf);
-    strcat(appendDisplay, " Cash: ");
+    shown = receipt.length; // the screen shows the total without the items
+    hidden = cart.count;
+    appendOutput(&receipt, " _____________________________________\n");
+    appendOutputf(&receipt, " Total Payable Amount:\t%s\n", formatMoney(money, payable_amount));
+    appendOutput(&receipt, " Cash: ");
     do {
         clrscr();
         // display total
-        printf("%s", appendDisplay);
+        showReceipt(&receipt, header, shown, hidden);
         // get cash amount
-        customScanfDefaultFloat(&cash, -1.0);
+        customScanfDefaultMoney(&cash, -1);
         if (cash < payable_amount) {
             printf(" => Cash should be more than or equal to the total payable amount! Try again.\n");
             getch();
@@ -1396,340 +2667,4368 @@ void sale_add(void) {
     } while (cash < payable_amount);
     // compute change
     change = compute_change(payable_amount, cash);
-    sprintf(tempbuf, "%.2f\n%c", cash, 0);
-    strcat(appendDisplay, tempbuf);
-    sprintf(tempbuf, "\n Change: %.2f%c", change, 0);
-    strcat(appendDisplay, tempbuf);
-    printf("\n Change: %.2f\n", change);
+    appendOutputf(&receipt, "%s\n", formatMoney(money, cash));
+    appendOutputf(&receipt, "\n Change: %s", formatMoney(money, change));
+    printf("\n Change: %s\n", money);
     time(&t); // set time now
     tmp = localtime(&t); // set localtime
     strftime(timenow, sizeof(timenow), "%H:%M:%S", tmp); // format will be 24:59:59 for the time of transaction
-    sprintf(tempbuf, "\n\n Date: %s\n%c", datenow, 0); // we write the date to buffer
-    strcat(appendDisplay, tempbuf); // append it to display buffer
-    sprintf(tempbuf, " Time: %s\n%c", timenow, 0); // also the time
-    strcat(appendDisplay, tempbuf); // append it
-    // append new records to old records
-    count = index + newCount; // update total count of records
-    SaleTransaction sale[count]; // sale transaction struct with count as storage capacity
-    memset(sale, 0, sizeof(sale)); // zero-out the sale transaction struct array instance
-    if (index > 0) // if no previous records,
-        getSaleData(sale); // then skip getting sale data from file to sale struct instance else get the sale transaction records data
-    j = 0; // j for newSale index
-    for (i = index; i < count; i++) {
-        // sale id
-        sale[i].id = newSale[j].id;
-        // product
-        sale[i].product.id = newSale[j].product.id;
-        strcpy(sale[i].product.name,newSale[j].product.name);
-        strcpy(sale[i].product.description, newSale[j].product.description);
-        strcpy(sale[i].product.category, newSale[j].product.category);
-        strcpy(sale[i].product.unit, newSale[j].product.unit);
-        sale[i].product.unit_price = newSale[j].product.unit_price;
-        // quantity
-        sale[i].quantity = newSale[j].quantity;
-        j++; // increment j for newSale index
-    }
-    // write to bin file the saleTransaction struct array instance records
-    if (0 != saveSaleTransactionToFile(sale, count)) {
-        fprintf(stderr, "Failed to write sales transaction records file. Sale Transaction was not saved");
-        return;
+    appendOutputf(&receipt, "\n\n Date: %s\n", datenow); // we write the date to the receipt
+    appendOutputf(&receipt, " Time: %s\n", timenow); // also the time
+    for (i = 0; i < cart.count; i++)
+        cart.items[i].timestamp = (long long)t;
+    sale.timestamp = (long long)t;
+    sale.total = payable_amount;
+    sale.cash = cash;
+    sale.change = change;
+    // the transaction id and the sale ids of its line items are taken at once from the header of the sale segment catalog
+    if ((first = allocateSaleIDs(cart.count + 1)) < 0 || insertSaleIDs(&receipt, &sale, &cart, first) != 0) {
+        fprintf(stderr, "Failed to read sales transaction records file. Sale Transaction was not saved");
+        goto EndSale;
     }
-    // write to txt file the appendDisplay string (this is like a receipt to be printed)
-    FILE * fp;
-    if ((fp = fopen(buffile, "a")) == NULL) {
-        fprintf(stderr, "Failed to write transaction file. Sale Transaction saved but did not write to display transaction text file.");
-        return;
+    // append only the new records to the sale segments of this month (old records are never rewritten)
+    if (checkoutSale(&sale, cart.items, cart.count) != 0) {
+        fprintf(stderr, "Failed to write sales transaction records file. Sale Transaction was not saved");
+        goto EndSale;
     }
-    fprintf(fp, "%s", appendDisplay);
-    fclose(fp);
+    printf(" Transaction ID : %d\n", sale.id);
+    // the receipt writer appends the receipt to the txt file of the date (this is like a receipt to be printed), the next customer does not wait for it
+    queueReceipt(datenow, receipt.data, receipt.length);
+    memset(&receipt, 0, sizeof(receipt)); // the receipt now belongs to the receipt writer
     getch();
+    EndSale:
+        freeCart(&cart);
+        freeOutput(&receipt);
 }
 /**
- * @brief Display all Sale Transactions
+ * @brief Give a checkout its block of sale IDs and write them into its receipt
+ * Until the checkout, the cart keeps the receipt offset of each ID, so the IDs of a transaction are
+ * allocated in one call however many line items it has
  * 
+ * @param receipt receipt of the transaction, rebuilt with the IDs
+ * @param sale sale header, takes the first ID
+ * @param cart line items, take the next IDs in order
+ * @param first first ID of the block of cart->count + 1 IDs
+ * @return int 0 - success | -1 not enough memory
  */
-void sale_display(void) {
-    // same process with prod_display() and teller_display() but have different data
-    clrscr(); // clear the screen terminal
-    int i, j, count, size;
-    char name[20], p_unit[20], p_price[16];
-    count = getRecordCount(SALERECORDS, sizeof(SaleTransaction));
-    SaleTransaction sales[count];
-    if (count < 1)
-        goto displayEmptyResults; // redirect empty records
-    getSaleData(sales);
-    printf("\n ---------- Display Transaction ----------\n\n");
-    printf(" %s%s%s%s%s\n\n", "  Sale ID ", "    Product Name    ", "    Product Unit    ", " Product Unit Price ", " Quantity ");
-    for (i = 0; i < count; i++) {
-        strcpy(name, centerTheString(sales[i].product.name, sizeof(name)));
-        strcpy(p_unit, centerTheString(sales[i].product.unit, sizeof(p_unit)));
-        // display data
-        printf("  %08d %s%s", sales[i].id, name, p_unit);
-        strcpy(p_price, rightAlignFloat(sales[i].product.unit_price, sizeof(p_price)));
-        printf("%s  \t   %d\n", p_price, sales[i].quantity);
-    }
-    printf("\n -----------------------------------------\n");
-    getch();
-    return;
-    displayEmptyResults:
-        printf("\n ---------- Display Transaction ----------\n\n");
-        printf(" %s%s%s%s%s\n\n", "  Sale ID ", "    Product Name    ", "    Product Unit    ", " Product Unit Price ", " Quantity ");
-        printf("\n -----------------------------------------\n");
-        getch();
+int insertSaleIDs(OutputBuffer * receipt, SaleHeader * sale, Cart * cart, int first) {
+    OutputBuffer numbered = { NULL, 0, 0 };
+    size_t from = 0, at;
+    int i;
+    if (reserveOutput(&numbered, receipt->length + (size_t)(cart->count + 1) * sizeof(" Transaction ID : -2147483648\n")) != 0) // room for every ID line
+        return -1;
+    for (i = -1; i < cart->count; i++) {
+        at = i < 0 ? cart->saleoffset : cart->offsets[i];
+        memcpy(numbered.data + numbered.length, receipt->data + from, at - from);
+        numbered.length += at - from;
+        if (i < 0)
+            appendOutputf(&numbered, " Transaction ID : %d\n", sale->id = first);
+        else
+            appendOutputf(&numbered, " Sale ID : %d\n", cart->items[i].id = first + 1 + i);
+        from = at;
+    }
+    memcpy(numbered.data + numbered.length, receipt->data + from, receipt->length - from);
+    numbered.length += receipt->length - from;
+    freeOutput(receipt);
+    *receipt = numbered;
+    return 0;
 }
 /**
- * @brief Compute payable amount of sales and return the amount
+ * @brief Show the receipt of a transaction being added, with only its last line items
  * 
- * @param sale SaleTransaction structure data
- * @return float Total Payable Amount
+ * @param receipt receipt of the transaction
+ * @param header receipt offset of the end of the transaction details
+ * @param shown receipt offset of the first line item shown
+ * @param hidden count of line items before the first one shown
  */
-float compute_payable_amount(SaleTransaction * saleArray, int count) {
-    int i;
-    float sum = 0.0, unitPrice, quantity, product; // initialize sum to 0 value
-    for (i = 0; i < count; i++) {
-        // copy the value
-        unitPrice = saleArray[i].product.unit_price;
-        quantity = saleArray[i].quantity;
-        // multiply
-        product = unitPrice * quantity;
-        // add the product
-        sum += product;
-    }
-    return sum;
+void showReceipt(const OutputBuffer * receipt, size_t header, size_t shown, int hidden) {
+    fwrite(receipt->data, 1, header, stdout);
+    if (hidden > 0)
+        printf("\n ... %d earlier item(s)\n", hidden);
+    fwrite(receipt->data + shown, 1, receipt->length - shown, stdout);
 }
 /**
- * @brief Compute the change of total payable amount and cash given and return the change amount
+ * @brief Display the Sale Transactions of a time range one page at a time
+ * A cursor reads the sales of one segment at a time, so only one page of sales is held in memory
  * 
- * @param sale SaleTransaction structure data
- * @return float Total Change Amount
  */
-float compute_change(float payable_amount, float cash) {
-    return (float)(cash - payable_amount);
+void sale_display(void) {
+    clrscr(); // clear the screen terminal
+    int i, rows, choice, id, startSegment = 0, startSlot = 0, segment, slot;
+    char fromDate[MAX_NAME], toDate[MAX_NAME], filter[MAX_NAME];
+    long long from = 0, to = LLONG_MAX; // all sales, including the undated ones
+    const ProductRecord * product;
+    SaleTransaction page[SALE_PAGE_SIZE], sale;
+    TableCell cells[5];
+    SaleCursor cursor;
+    printf("\n ---------- Display Transaction ----------\n\n");
+    printf(" From Date (YYYY-MM-DD, empty for the first sale): ");
+    customScanfDefaultString(fromDate, "");
+    printf(" To Date (YYYY-MM-DD, empty for the last sale): ");
+    customScanfDefaultString(toDate, "");
+    if ((fromDate[0] != 0 && (from = parseDate(fromDate, 0)) < 0) || (toDate[0] != 0 && (to = parseDate(toDate, 1)) < 0)) {
+        printf(" => Invalid date! Try again.\n");
+        getch();
+        return;
+    }
+    openSaleCursor(&cursor, from, to, 0); // only the segments overlapping the dates are opened
+    refreshCatalog(&productCatalog); // product details are read from the product records
+    while (1) {
+        clrscr();
+        cursor.segment = startSegment; // read the page from its first sale
+        cursor.slot = startSlot;
+        for (rows = 0; rows < SALE_PAGE_SIZE && nextSale(&cursor, &page[rows]); rows++)
+            ;
+        appendOutput(&tableOutput, "\n ---------- Display Transaction ----------\n\n");
+        if (cursor.product_id != 0) {
+            snprintf(filter, sizeof(filter), " Product ID: %08d\n\n", cursor.product_id);
+            appendOutput(&tableOutput, filter);
+        }
+        appendOutput(&tableOutput, "   Sale ID     Product Name        Product Unit     Product Unit Price  Quantity \n\n");
+        for (i = 0; i < rows; i++) {
+            product = findProductRecord(page[i].product_id);
+            cells[0].number = page[i].id;
+            cells[1].text = product != NULL ? productString(product->name) : "(deleted)";
+            cells[2].text = product != NULL ? productString(product->unit) : "";
+            cells[3].number = page[i].unit_price;
+            cells[4].number = page[i].quantity;
+            renderRow(&tableOutput, saleColumns, cells, 5);
+        }
+        appendOutput(&tableOutput, "\n -----------------------------------------\n\n");
+        flushOutput(&tableOutput);
+        printf(" [1] Next Page\n");
+        printf(" [2] Previous Page\n");
+        printf(" [3] Jump to Sale ID\n");
+        printf(" [4] Filter by Product ID\n");
+        printf(" [5] Go Back\n\n");
+        do {
+            printf(" Choice: ");
+            dscanc(&choice); // single-input integer value choose from 1-5
+            if (!(choice > 0 && choice < 6))
+                printf(" Invalid Choice!\n");
+        } while (!(choice > 0 && choice < 6));
+        switch (choice) {
+            case 1: // the next page starts after the last sale of this page
+                segment = cursor.segment;
+                slot = cursor.slot;
+                if (rows == SALE_PAGE_SIZE && nextSale(&cursor, &sale)) {
+                    startSegment = segment;
+                    startSlot = slot;
+                }
+                else {
+                    printf(" => No more sale transactions.\n");
+                    getch();
+                }
+                break;
+            case 2: // the previous page ends before the first sale of this page
+                cursor.segment = startSegment;
+                cursor.slot = startSlot;
+                for (i = 0; i < SALE_PAGE_SIZE && prevSale(&cursor, &sale); i++)
+                    ;
+                if (i == 0) {
+                    printf(" => This is the first page.\n");
+                    getch();
+                }
+                startSegment = cursor.segment;
+                startSlot = cursor.slot;
+                break;
+            case 3:
+                printf("\n Enter Sale ID: ");
+                customScanfDefaultInt(&id, 0);
+                if (id > 0 && seekSale(&cursor, id)) {
+                    startSegment = cursor.segment;
+                    startSlot = cursor.slot;
+                }
+                else {
+                    printf(" => Sale ID not found!\n");
+                    getch();
+                }
+                break;
+            case 4: // the filtered sales are shown from the first one
+                printf("\n Enter Product ID (0 for all products): ");
+                customScanfDefaultInt(&id, 0);
+                cursor.product_id = id > 0 ? id : 0;
+                startSegment = 0;
+                startSlot = 0;
+                break;
+            default: // go back to menu
+                closeSaleCursor(&cursor);
+                return;
+        }
+    }
 }
 /**
- * @brief Get the Record Count from file
+ * @brief Display the revenue of a time range per product, per category or per day
+ * The line items are aggregated by scanSales() in one pass over the sale segments of the range
  * 
- * @param filename 
- * @param recordsize size of each record/row
- * @return int count of rows
  */
-int getRecordCount(const char * filename, int recordsize) {
-    FILE * fp;
-    int size=0, count = 0;
-    if ((fp = fopen(filename, "rb")) == NULL) {
-        fprintf(stderr, "Failed to open %s Records.", filename);
-        return 0;
+void sale_report(void) {
+    clrscr();
+    int i, choice;
+    char fromDate[MAX_NAME], toDate[MAX_NAME], day[TIME_SIZE], money[MONEY_SIZE];
+    long long from = 0, to = LLONG_MAX, revenue = 0, quantity = 0;
+    const char ** names = NULL;
+    const ProductRecord * product;
+    const SaleAggregate * aggregate;
+    RevenueReport report;
+    SaleScanner scanner;
+    RevenueTotal * totals;
+    TableCell cells[4];
+    time_t t;
+    printf("\n ---------- Revenue Reports ----------\n\n");
+    printf(" [1] Revenue per Product\n");
+    printf(" [2] Revenue per Category\n");
+    printf(" [3] Revenue per Day\n");
+    printf(" [4] Go Back\n");
+    printf("\n -------------------------------------\n\n");
+    do {
+        printf(" Choice: ");
+        dscanc(&choice); // single-input integer value choose from 1-4
+        if (!(choice > 0 && choice < 5))
+            printf(" Invalid Choice!\n");
+    } while (!(choice > 0 && choice < 5));
+    if (choice == 4)
+        return; // go back to menu
+    printf(" From Date (YYYY-MM-DD, empty for the first sale): ");
+    customScanfDefaultString(fromDate, "");
+    printf(" To Date (YYYY-MM-DD, empty for the last sale): ");
+    customScanfDefaultString(toDate, "");
+    if ((fromDate[0] != 0 && (from = parseDate(fromDate, 0)) < 0) || (toDate[0] != 0 && (to = parseDate(toDate, 1)) < 0)) {
+        printf(" => Invalid date! Try again.\n");
+        getch();
+        return;
     }
-    fseek(fp, 0, SEEK_END); // set cursor at the end of file
-    size = ftell(fp); // get the file size from the end cursor
-    fseek(fp, 0, SEEK_SET); // set the cursor at the start of file
-    fclose(fp); // close the file
-    if (!size)
-        return 0; // if file size is 0 return 0
-    count = size / recordsize; // get the records count by dividing the file size and the size of Teller struct
-    return count;
+    if (prepareRevenueReport(&report, choice, from, to, &names) != 0
+        || (totals = arenaAlloc(&recordArena, (report.keyCount + 1) * sizeof(RevenueTotal))) == NULL) {
+        printf(" => Not enough memory for the report.\n");
+        getch();
+        return;
+    }
+    memset(totals, 0, (report.keyCount + 1) * sizeof(RevenueTotal));
+    scanner.partialSize = report.keyCount * sizeof(RevenueTotal);
+    scanner.scan = choice == REPORT_PRODUCT ? scanProductRevenue : choice == REPORT_CATEGORY ? scanCategoryRevenue : scanDailyRevenue;
+    scanner.merge = mergeRevenue;
+    scanner.context = &report;
+    if (choice == REPORT_PRODUCT && fromDate[0] == 0 && toDate[0] == 0 && checkSaleAggregates() == 0) {
+        for (i = 0; i < report.keyCount; i++) { // the totals of all time per product are kept up to date by every checkout
+            if ((aggregate = findAggregate(AGGREGATE_PRODUCT, i, 0)) != NULL) {
+                totals[i].quantity = aggregate->quantity;
+                totals[i].revenue = aggregate->revenue;
+            }
+        }
+    }
+    else if (report.keyCount > 0)
+        scanSales(from, to, &scanner, totals);
+    clrscr();
+    appendOutput(&tableOutput, "\n ---------- Revenue Reports ----------\n\n");
+    if (choice == REPORT_PRODUCT)
+        appendOutput(&tableOutput, "  Product ID     Product Name        Quantity          Revenue    \n\n");
+    else
+        appendOutput(&tableOutput, choice == REPORT_CATEGORY ? "            Category               Quantity          Revenue    \n\n"
+            : "              Date                 Quantity          Revenue    \n\n");
+    for (i = 0; i < report.keyCount; i++) {
+        if (totals[i].quantity == 0 && totals[i].revenue == 0)
+            continue; // nothing sold
+        revenue += totals[i].revenue;
+        quantity += totals[i].quantity;
+        if (choice == REPORT_PRODUCT) {
+            product = findProductRecord(i);
+            cells[0].number = i;
+            cells[1].text = product != NULL ? productString(product->name) : "(deleted)";
+            cells[2].number = totals[i].quantity;
+            cells[3].number = totals[i].revenue;
+            renderRow(&tableOutput, productRevenueColumns, cells, 4);
+            continue;
+        }
+        if (choice == REPORT_CATEGORY)
+            cells[0].text = names[i];
+        else {
+            t = (time_t)report.days[i];
+            strftime(day, sizeof(day), "%Y-%m-%d", localtime(&t));
+            cells[0].text = day;
+        }
+        cells[1].number = totals[i].quantity;
+        cells[2].number = totals[i].revenue;
+        renderRow(&tableOutput, revenueColumns, cells, 3);
+    }
+    appendOutput(&tableOutput, "\n -------------------------------------\n\n");
+    appendOutputf(&tableOutput, " Total Quantity : %lld\n", quantity);
+    appendOutputf(&tableOutput, " Total Revenue  : %s\n", formatMoney(money, revenue));
+    flushOutput(&tableOutput);
+    getch();
 }
 /**
- * @brief Get the Latest ID from records
+ * @brief Set up the keys of a revenue report before its scan
  * 
- * @param filename 
- * @param recordsize size of each record/row
- * @return int latest maximum ID; 0 if file error
+ * @param report revenue report buffer
+ * @param kind REPORT_PRODUCT | REPORT_CATEGORY | REPORT_DAY
+ * @param from start of the range in seconds since the epoch
+ * @param to end of the range (inclusive)
+ * @param names buffer of the category names of REPORT_CATEGORY, allocated from the record arena
+ * @return int 0 - success | -1 not enough memory
  */
-int getLatestID(const char * filename, int recordsize) {
-    int i, count, maxid;
-    count = getRecordCount(filename, recordsize); // record count
-    if (count < 1)
-        return 0; // return 0 if no records
-    int ids[count];
-    if (0 == strcmp(filename, PRODUCTRECORDS)) { // if filename is PRODUCTRECORDS
-        Product temp[count]; // Product struct instance is used
-        memset(temp, 0, sizeof(temp));
-        getProductData(temp); // get all Product records to temp variable
-        for (i = 0; i < count; i++) {
-            ids[i] = temp[i].id; // store the ids of products to ids[] int array
-        }
-    } else if (0 == strcmp(filename, TELLERRECORDS)) { // if filename is TELLERRECORDS
-        Teller temp[count]; // Teller struct instance is used
-        memset(temp, 0, sizeof(temp));
-        getTellerData(temp); // get all Teller records to temp variable
+int prepareRevenueReport(RevenueReport * report, int kind, long long from, long long to, const char *** names) {
+    const ProductRecord * products;
+    const SaleSegment * segments;
+    const char * category;
+    long long first = LLONG_MAX, last = LLONG_MIN, day;
+    int i, k, count;
+    memset(report, 0, sizeof(RevenueReport));
+    report->from = from;
+    report->to = to;
+    count = refreshCatalog(&productCatalog);
+    report->productCount = productView.header != NULL ? productView.header->next_id : 0; // every product ID sold is below the next ID
+    if (kind == REPORT_PRODUCT)
+        report->keyCount = report->productCount;
+    else if (kind == REPORT_CATEGORY) { // the categories are numbered in order of their first product, 0 for the deleted products
+        report->categories = arenaAlloc(&recordArena, (report->productCount + 1) * sizeof(int));
+        if (report->categories == NULL || (*names = arenaAlloc(&recordArena, (count + 1) * sizeof(char *))) == NULL)
+            return -1;
+        memset((int *)report->categories, 0, (report->productCount + 1) * sizeof(int));
+        (*names)[0] = "(deleted)";
+        report->keyCount = 1;
+        products = productView.base;
         for (i = 0; i < count; i++) {
-            ids[i] = temp[i].id; // store the ids of products to ids[] int array
+            if (products[i].id <= 0 || products[i].id >= report->productCount)
+                continue; // deleted record slot
+            category = productString(products[i].category);
+            for (k = 1; k < report->keyCount && 0 != strcmp((*names)[k], category); k++)
+                ;
+            if (k == report->keyCount)
+                (*names)[report->keyCount++] = category;
+            ((int *)report->categories)[products[i].id] = k;
         }
-    } else if (0 == strcmp(filename, SALERECORDS)) { // if filename is SALERECORDS
-        SaleTransaction temp[count]; // SaleTransaction struct instance is used
-        memset(temp, 0, sizeof(temp));
-        getSaleData(temp); // get all SaleTransaction records to temp variable
+    }
+    else { // one key per day from the first to the last dated sale of the range
+        segments = findSaleSegments(from, to, &count);
         for (i = 0; i < count; i++) {
-            ids[i] = temp[i].id; // store the ids of products to ids[] int array
+            if (segments[i].month == 0)
+                continue; // the undated sales have no day
+            if (segments[i].min_time < first)
+                first = segments[i].min_time;
+            if (segments[i].max_time > last)
+                last = segments[i].max_time;
         }
+        first = first < from ? from : first;
+        last = last > to ? to : last;
+        if (first > last)
+            return 0; // no dated sales in the range
+        first = startOfDay(first);
+        if ((report->days = arenaAlloc(&recordArena, ((last - first) / SECONDS_PER_DAY + 3) * sizeof(long long))) == NULL)
+            return -1;
+        for (day = first; day <= last; day = startOfDay(day + SECONDS_PER_DAY + SECONDS_PER_DAY / 4)) // a quarter day past the next midnight, even on a daylight saving change
+            ((long long *)report->days)[report->keyCount++] = day;
+        ((long long *)report->days)[report->keyCount] = day; // end of the last day
     }
-    maxid = maxOfInt(ids, count); // get the maximum integer value from ids[] array
-    return maxid;
+    return 0;
 }
 /**
- * @brief Save Product struct to file
+ * @brief Z-Report: the register totals of a day per hour and per teller, read from the sale aggregates
+ * without scanning the sales, so the totals of today so far are shown at once
  * 
- * @param product Product struct array data
- * @param count count of all new data
- * @return int 0 - success | -1 error
  */
-int saveProductToFile(Product * product, int count) {
-    int i;
-    FILE * fp;
-    if ((fp = fopen(PRODUCTRECORDS, "wb")) == NULL) {
-        fprintf(stderr, "CANNOT READ PRODUCT RECORDS FILE.\n");
-        return -1;
+void sale_zreport(void) {
+    clrscr();
+    char date[MAX_NAME], name[MAX_NAME * 2], hour[TIME_SIZE], money[MONEY_SIZE];
+    long long when;
+    int i, day, count = 0;
+    const SaleAggregate * total, * aggregate;
+    const TellerRecord * teller;
+    SaleAggregate * sellers;
+    TableCell cells[5];
+    printf("\n ---------- Z-Report ----------\n\n");
+    printf(" Date (YYYY-MM-DD, empty for today): ");
+    customScanfDefaultString(date, "");
+    if (date[0] == 0)
+        when = (long long)time(NULL);
+    else if ((when = parseDate(date, 0)) < 0) {
+        printf(" => Invalid date! Try again.\n");
+        getch();
+        return;
     }
-    for (i = 0; i < count; i++) // iterate one record at a time and write to file
-        fwrite(&product[i], sizeof(Product), 1, fp);
-    fclose(fp);
-    return 0;
+    if (!fileExists(SALEAGGREGATES) || refreshRecordView(&saleAggregateView) == 0) {
+        printf(" => No sale aggregates yet. Restart the POS to rebuild them.\n");
+        getch();
+        return;
+    }
+    if ((sellers = arenaAlloc(&recordArena, saleAggregateView.count * sizeof(SaleAggregate))) == NULL) {
+        printf(" => Not enough memory for the report.\n");
+        getch();
+        return;
+    }
+    day = localDay(when, NULL);
+    total = findAggregate(AGGREGATE_DAY, 0, day);
+    clrscr();
+    appendOutputf(&tableOutput, "\n ---------- Z-Report %04d-%02d-%02d ----------\n\n", day / 10000, day / 100 % 100, day % 100);
+    appendOutput(&tableOutput, "    Hour     Transactions      Quantity         Revenue     \n\n");
+    for (i = 0; i < 24; i++) {
+        if ((aggregate = findAggregate(AGGREGATE_HOUR, i, day)) == NULL)
+            continue; // nothing sold in the hour
+        sprintf(hour, "%02d:00", i);
+        cells[0].text = hour;
+        cells[1].number = aggregate->count;
+        cells[2].number = aggregate->quantity;
+        cells[3].number = aggregate->revenue;
+        renderRow(&tableOutput, hourColumns, cells, 4);
+    }
+    appendOutput(&tableOutput, "\n Teller ID         Teller Name        Transactions    Quantity        Revenue     \n\n");
+    aggregate = saleAggregateView.base;
+    for (i = 0; i < saleAggregateView.count; i++) { // the tellers who checked out that day, even if deleted since
+        if (aggregate[i].kind == AGGREGATE_TELLER && aggregate[i].day == day)
+            sellers[count++] = aggregate[i];
+    }
+    qsort(sellers, count, sizeof(SaleAggregate), compareAggregateKeys);
+    for (i = 0; i < count; i++) {
+        if (sellers[i].key == 0)
+            strcpy(name, "(none)"); // checkouts without a teller
+        else if ((teller = findTellerRecord(sellers[i].key)) != NULL)
+            snprintf(name, sizeof(name), "%s %s", tellerString(teller->first_name), tellerString(teller->last_name));
+        else
+            strcpy(name, "(deleted)");
+        cells[0].number = sellers[i].key;
+        cells[1].text = name;
+        cells[2].number = sellers[i].count;
+        cells[3].number = sellers[i].quantity;
+        cells[4].number = sellers[i].revenue;
+        renderRow(&tableOutput, tellerSalesColumns, cells, 5);
+    }
+    appendOutput(&tableOutput, "\n -------------------------------------------\n\n");
+    appendOutputf(&tableOutput, " Transactions   : %d\n", total != NULL ? total->count : 0);
+    appendOutputf(&tableOutput, " Total Quantity : %lld\n", total != NULL ? total->quantity : 0);
+    appendOutputf(&tableOutput, " Total Revenue  : %s\n", formatMoney(money, total != NULL ? total->revenue : 0));
+    flushOutput(&tableOutput);
+    getch();
 }
 /**
- * @brief Save Teller struct to file
+ * @brief Start the thread writing the receipts to the daily transaction files
+ * Without the thread (not Linux, or it could not start), the receipts are written by the checkout itself
  * 
- * @param teller Teller struct array data
- * @param count count of all new data
- * @return int 0 - success | -1 error
+ * @return int 0 - started | -1 receipts are written synchronously
  */
-int saveTellerToFile(Teller * teller, int count) {
-    int i;
-    FILE * fp;
-    if ((fp = fopen(TELLERRECORDS, "wb")) == NULL) {
-        fprintf(stderr, "CANNOT READ TELLER RECORDS FILE.\n");
+int startReceiptWriter(void) {
+#ifdef __linux__
+    atomic_init(&receiptWriter.head, 0);
+    atomic_init(&receiptWriter.tail, 0);
+    if (sem_init(&receiptWriter.filled, 0, 0) != 0)
+        return -1;
+    if (sem_init(&receiptWriter.space, 0, RECEIPT_QUEUE_SIZE) != 0) {
+        sem_destroy(&receiptWriter.filled);
         return -1;
     }
-    for (i = 0; i < count; i++) // iterate one record at a time and write to file
-        fwrite(&teller[i], sizeof(Teller), 1, fp);
-    fclose(fp);
+    if (pthread_create(&receiptWriter.thread, NULL, receiptWriterThread, NULL) != 0) {
+        sem_destroy(&receiptWriter.filled);
+        sem_destroy(&receiptWriter.space);
+        return -1;
+    }
+    receiptWriter.running = 1;
     return 0;
+#else
+    return -1;
+#endif
 }
 /**
- * @brief Save SaleTransaction struct to file
+ * @brief Write the queued receipts, then stop the receipt writer thread and close the transaction file
  * 
- * @param teller SaleTransaction struct array data
- * @param count count of all new data
- * @return int 0 - success | -1 error
  */
-int saveSaleTransactionToFile(SaleTransaction * sale, int count) {
-    int i;
-    FILE * fp;
-    if ((fp = fopen(SALERECORDS, "wb")) == NULL) {
-        fprintf(stderr, "CANNOT READ SALE RECORDS FILE.\n");
-        return -1;
+void stopReceiptWriter(void) {
+#ifdef __linux__
+    if (receiptWriter.running) {
+        queueReceipt(NULL, NULL, 0); // the writer stops once it reaches this job, after the receipts queued before
+        pthread_join(receiptWriter.thread, NULL);
+        sem_destroy(&receiptWriter.filled);
+        sem_destroy(&receiptWriter.space);
+        receiptWriter.running = 0;
     }
-    for (i = 0; i < count; i++) // iterate one record at a time and write to file
-        fwrite(&sale[i], sizeof(SaleTransaction), 1, fp);
-    fclose(fp);
-    return 0;
-} 
+#endif
+    if (receiptWriter.fp != NULL)
+        fclose(receiptWriter.fp);
+    receiptWriter.fp = NULL;
+}
 /**
- * @brief Get the Product Data from records file
+ * @brief Hand a rendered receipt over to the receipt writer
+ * The checkout only waits if RECEIPT_QUEUE_SIZE receipts are still waiting to be written
  * 
- * @param product Product struct array buffer
+ * @param date date of the daily transaction file, YYYY-MM-DD
+ * @param text receipt allocated with malloc(), freed once written; NULL with a NULL date to stop the writer thread
+ * @param length length of the receipt
  */
-void getProductData(Product * product) {
-    FILE * fp;
-    if ((fp = fopen(PRODUCTRECORDS, "rb")) == NULL) {
-        fprintf(stderr, "CANNOT READ PRODUCT RECORDS FILE.\n");
+void queueReceipt(const char * date, char * text, size_t length) {
+#ifdef __linux__
+    ReceiptJob * job;
+    unsigned int tail;
+#endif
+    if (text == NULL && date != NULL)
+        return; // the receipt could not be rendered
+#ifdef __linux__
+    if (receiptWriter.running) {
+        while (sem_wait(&receiptWriter.space) != 0) // retry if interrupted by a signal
+            ;
+        tail = atomic_load_explicit(&receiptWriter.tail, memory_order_relaxed); // only this thread moves the tail
+        job = &receiptWriter.jobs[tail % RECEIPT_QUEUE_SIZE];
+        job->text = text;
+        job->length = length;
+        if (date != NULL)
+            strcpy(job->date, date);
+        atomic_store_explicit(&receiptWriter.tail, tail + 1, memory_order_release); // publish the job to the writer
+        sem_post(&receiptWriter.filled);
         return;
     }
-    int count, i;
-    count = getRecordCount(PRODUCTRECORDS, sizeof(Product));
-    if (count < 1)
-        return;
-    for (i = 0; i < count; i++) // iterate one record at a time and read from file
-        fread(&product[i], sizeof(Product), 1, fp); // store the data element struct to product[i]
-    fclose(fp);
+#endif
+    if (text != NULL) {
+        if (writeReceipt(date, text, length) == 0)
+            fflush(receiptWriter.fp);
+        free(text);
+    }
 }
 /**
- * @brief Get the Teller Data from file
+ * @brief Append a receipt to the transaction file of its date, switching files when the date changes
  * 
- * @param teller Teller struct array buffer
+ * @param date date of the daily transaction file, YYYY-MM-DD
+ * @param text receipt
+ * @param length length of the receipt
+ * @return int 0 - success | -1 error
  */
-void getTellerData(Teller * teller) {
-    FILE * fp;
-    if ((fp = fopen(TELLERRECORDS, "rb")) == NULL) {
-        fprintf(stderr, "CANNOT READ TELLER RECORDS FILE.\n");
-        return;
+int writeReceipt(const char * date, const char * text, size_t length) {
+    char filename[MAX_NAME];
+    if (receiptWriter.fp == NULL || 0 != strcmp(receiptWriter.date, date)) { // first receipt or past midnight
+        if (receiptWriter.fp != NULL)
+            fclose(receiptWriter.fp);
+        sprintf(filename, SALETRANSACTIONS, date);
+        if ((receiptWriter.fp = fopen(filename, "a")) == NULL) {
+            fprintf(stderr, "Failed to write transaction file. Sale Transaction saved but did not write to display transaction text file.");
+            return -1;
+        }
+        setvbuf(receiptWriter.fp, NULL, _IOFBF, RECEIPT_BUFFER_SIZE);
+        strcpy(receiptWriter.date, date);
     }
-    int count, i;
-    count = getRecordCount(TELLERRECORDS, sizeof(Teller));
-    if (count < 1)
-        return;
-    for (i = 0; i < count; i++) // iterate one record at a time and read from file
-        fread(&teller[i], sizeof(Teller), 1, fp); // store the data element struct to teller[i]
-    fclose(fp);
+    if (fwrite(text, 1, length, receiptWriter.fp) != length) {
+        fprintf(stderr, "Failed to write transaction file. Sale Transaction saved but did not write to display transaction text file.");
+        return -1;
+    }
+    return 0;
 }
+#ifdef __linux__
 /**
- * @brief Get the Sale Data from file
+ * @brief Receipt writer thread: write the queued receipts in order until the stop job
+ * The transaction file is only flushed once the queue is empty, so receipts queued together are written at once
  * 
- * @param sale SaleTransaction struct array buffer
+ * @param arg unused
+ * @return void* NULL
  */
-void getSaleData(SaleTransaction * sale) {
-    FILE * fp;
-    if ((fp = fopen(SALERECORDS, "rb")) == NULL) {
-        fprintf(stderr, "CANNOT READ SALE RECORDS FILE.\n");
-        return;
+void * receiptWriterThread(void * arg) {
+    ReceiptJob * job;
+    unsigned int head;
+    (void)arg;
+    while (1) {
+        if (sem_trywait(&receiptWriter.filled) != 0) { // queue is empty, write out the batch before waiting
+            if (receiptWriter.fp != NULL)
+                fflush(receiptWriter.fp);
+            while (sem_wait(&receiptWriter.filled) != 0) // retry if interrupted by a signal
+                ;
+        }
+        head = atomic_load_explicit(&receiptWriter.head, memory_order_relaxed); // only this thread moves the head
+        job = &receiptWriter.jobs[head % RECEIPT_QUEUE_SIZE];
+        if (job->text == NULL)
+            break; // stop job, every receipt before it was written
+        writeReceipt(job->date, job->text, job->length);
+        free(job->text);
+        atomic_store_explicit(&receiptWriter.head, head + 1, memory_order_release); // give the slot back to the checkout
+        sem_post(&receiptWriter.space);
     }
-    int count, i;
-    count = getRecordCount(SALERECORDS, sizeof(SaleTransaction));
-    if (count < 1)
-        return;
-    for (i = 0; i < count; i++) // iterate one record at a time and read from file
-        fread(&sale[i], sizeof(SaleTransaction), 1, fp); // store the data element struct to sale[i]
-    fclose(fp);
+    if (receiptWriter.fp != NULL)
+        fflush(receiptWriter.fp);
+    return NULL;
 }
+#endif
 /**
- * @brief Get the Product struct By ID
+ * @brief Serve the lookups and checkouts of the lanes on a Unix domain socket until SIGINT or SIGTERM
+ * One thread waits on epoll for all the lanes and handles their requests in the order they arrive. The
+ * catalogs stay mapped for the whole run, so a lookup is one probe of the hash index in memory
  * 
- * @param productbuffer Product struct buffer
- * @param searchID Product ID search
- * @return int 0 - success | -1 not found
+ * @param path socket file, replaced if no server answers on it
+ * @return int 0 - stopped | -1 error
  */
-int getProductByID(Product * productbuffer, int searchID) {
-    int count, i;
-    count = getRecordCount(PRODUCTRECORDS, sizeof(Product));
-    Product products[count];
-    getProductData(products); // get all product data to products struct array
-    for (i = 0; i < count; i++) {
-        if (products[i].id == searchID) {
-            // if id found, copy to product struct buffer
-            (*productbuffer).id = products[i].id;
-            strcpy((*productbuffer).name, products[i].name);
-            strcpy((*productbuffer).description, products[i].description);
-            strcpy((*productbuffer).category, products[i].category);
-            strcpy((*productbuffer).unit, products[i].unit);
-            (*productbuffer).unit_price = products[i].unit_price;
-            return 0; // found
+int serveLanes(const char * path) {
+#ifdef __linux__
+    struct sockaddr_un addr;
+    struct epoll_event event, events[SERVER_MAX_EVENTS];
+    ServerClient * client;
+    int listener, epfd, fd, i, n;
+    if ((fd = connectServer(path)) >= 0) {
+        close(fd);
+        fprintf(stderr, "POS SERVER ALREADY RUNNING ON %s.\n", path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if ((listener = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        fprintf(stderr, "CANNOT OPEN %s SOCKET.\n", path);
+        return -1;
+    }
+    unlink(path); // socket file left behind by a server which did not stop
+    if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, SOMAXCONN) != 0
+        || fcntl(listener, F_SETFL, O_NONBLOCK) != 0 || (epfd = epoll_create1(0)) < 0) {
+        fprintf(stderr, "CANNOT OPEN %s SOCKET.\n", path);
+        close(listener);
+        return -1;
+    }
+    event.events = EPOLLIN;
+    event.data.ptr = NULL; // the listening socket
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listener, &event);
+    signal(SIGPIPE, SIG_IGN); // a lane which closed its connection is seen as a write error
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    printf(" => Serving the lanes on %s, stop with Ctrl+C.\n", path);
+    fflush(stdout);
+    while (!serverStop) {
+        if ((n = epoll_wait(epfd, events, SERVER_MAX_EVENTS, -1)) < 0)
+            continue; // interrupted by a signal
+        arenaReset(&recordArena); // the checkouts of the previous wakeup are committed
+        for (i = 0; i < n; i++) {
+            if ((client = events[i].data.ptr) == NULL) { // new lanes
+                while ((fd = accept(listener, NULL, NULL)) >= 0) {
+                    if (fcntl(fd, F_SETFL, O_NONBLOCK) != 0 || (client = calloc(1, sizeof(ServerClient))) == NULL) {
+                        close(fd);
+                        continue;
+                    }
+                    client->fd = fd;
+                    event.events = EPOLLIN;
+                    event.data.ptr = client;
+                    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &event);
+                }
+            }
+            else if (serveClient(epfd, client) != 0) { // the lane closed its connection
+                epoll_ctl(epfd, EPOLL_CTL_DEL, client->fd, NULL);
+                close(client->fd);
+                freeOutput(&client->in);
+                freeOutput(&client->out);
+                free(client);
+            }
         }
     }
-    printf(" => Product not found! Try again.\n");
-    getch();
-    return -1; // not found
+    close(epfd); // the connections of the lanes still connected are closed on exit
+    close(listener);
+    unlink(path);
+    printf(" => POS server stopped.\n");
+    return 0;
+#else
+    fprintf(stderr, "POS SERVER IS ONLY SUPPORTED ON LINUX.\n");
+    return -1;
+#endif
 }
-// other functions
 /**
- * @brief Custom Scanf for single character input for integer number
- * user single-input integer
- * @param d int buffer
- * @return int integer character inputted
+ * @brief Signal handler stopping the POS server once epoll_wait() returns
+ * 
+ * @param sig SIGINT or SIGTERM
  */
-int dscanc(int * d) {
-    char cbuf, buf[2];
-    memset(buf, 0, 2);
-    cbuf = getch(); // getch() get a single character only then put to cbuf char buffer
-    *buf = cbuf; // copy the character cbuf to the first element of buf char array string
-    *d = atoi(buf); // atoi() converts a stringed type number to integer number and put to buffer
-    printf("%d\n", *d); // then display the inputted character to screen
-    // this way we dont have to press enter on inputting one character
-    return *d;
+void stopServer(int sig) {
+    (void)sig;
+    serverStop = 1;
 }
+#ifdef __linux__
 /**
- * @brief Custom Scanf for single character input for char
- * user single-input char
- * @param c char buffer
+ * @brief Read the requests received from a lane, handle the complete ones and send their replies
+ * The socket is non-blocking: a partial request waits in the receive buffer for its next bytes, and
+ * the replies which cannot be sent yet wait for the socket to be writable
+ * 
+ * @param epfd epoll instance of the server
+ * @param client lane
+ * @return int 0 - success | -1 the connection is closed or broken
+ */
+int serveClient(int epfd, ServerClient * client) {
+    ServerRequest request;
+    struct epoll_event event;
+    size_t used = 0;
+    ssize_t n;
+    while (client->in.length < SERVER_MAX_PAYLOAD) { // a lane sending faster than it reads is read again at the next wakeup
+        if (reserveOutput(&client->in, SERVER_READ_SIZE) != 0)
+            return -1;
+        n = read(client->fd, client->in.data + client->in.length, client->in.capacity - client->in.length);
+        if (n > 0)
+            client->in.length += (size_t)n;
+        else if (n == 0)
+            return -1; // closed by the lane
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+            break; // everything received was read
+        else if (errno != EINTR)
+            return -1;
+    }
+    while (client->in.length - used >= sizeof(request)) {
+        memcpy(&request, client->in.data + used, sizeof(request));
+        if (request.length < 0 || request.length > SERVER_MAX_PAYLOAD)
+            return -1; // not a request of a lane
+        if (client->in.length - used < sizeof(request) + (size_t)request.length)
+            break; // the rest of the payload is not received yet
+        if (handleRequest(&request, client->in.data + used + sizeof(request), &client->out) != 0)
+            return -1;
+        used += sizeof(request) + (size_t)request.length;
+    }
+    memmove(client->in.data, client->in.data + used, client->in.length - used);
+    client->in.length -= used;
+    while (client->sent < client->out.length) {
+        n = write(client->fd, client->out.data + client->sent, client->out.length - client->sent);
+        if (n > 0)
+            client->sent += (size_t)n;
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break; // the rest is sent once the socket is writable
+        else if (n < 0 && errno != EINTR)
+            return -1;
+    }
+    if (client->sent == client->out.length) {
+        client->out.length = 0;
+        client->sent = 0;
+    }
+    if (client->writing != (client->out.length > 0)) { // only wait for the socket to be writable while replies are pending
+        client->writing = client->out.length > 0;
+        event.events = client->writing ? EPOLLIN | EPOLLOUT : EPOLLIN;
+        event.data.ptr = client;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, client->fd, &event);
+    }
+    return 0;
+}
+/**
+ * @brief Write all the bytes to a blocking socket
+ * 
+ * @param fd connected socket
+ * @param data 
+ * @param size count of bytes
+ * @return int 0 - success | -1 error
+ */
+int writeSocket(int fd, const void * data, size_t size) {
+    ssize_t n;
+    while (size > 0) {
+        if ((n = send(fd, data, size, MSG_NOSIGNAL)) < 0 && errno == EINTR) // a server which stopped is seen as an error, not SIGPIPE
+            continue;
+        if (n <= 0)
+            return -1;
+        data = (const char *)data + n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+/**
+ * @brief Read exactly size bytes from a blocking socket
+ * 
+ * @param fd socket
+ * @param data buffer
+ * @param size count of bytes
+ * @return int 0 - success | -1 error or closed
+ */
+int readSocket(int fd, void * data, size_t size) {
+    ssize_t n;
+    while (size > 0) {
+        if ((n = read(fd, data, size)) < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        data = (char *)data + n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+#endif
+/**
+ * @brief Handle one request of a lane and append its reply to the replies of the lane
+ * 
+ * @param request 
+ * @param payload payload of the request, not aligned in the receive buffer
+ * @param out replies of the lane
+ * @return int 0 - success | -1 not enough memory for the reply
+ */
+int handleRequest(const ServerRequest * request, const char * payload, OutputBuffer * out) {
+    ServerReply reply = { -1, 0 };
+    const ProductRecord * productRecord;
+    const TellerRecord * tellerRecord;
+    Product product;
+    Teller teller;
+    SaleHeader sale;
+    SaleTransaction * sales;
+    const void * data = NULL;
+    switch (request->op) {
+        case SERVER_PRODUCT:
+            if ((productRecord = findProductRecord(request->id)) != NULL) {
+                loadProduct(productRecord, &product);
+                reply.status = 0;
+                reply.length = sizeof(product);
+                data = &product;
+            }
+            break;
+        case SERVER_TELLER:
+            if ((tellerRecord = findTellerRecord(request->id)) != NULL) {
+                loadTeller(tellerRecord, &teller);
+                reply.status = 0;
+                reply.length = sizeof(teller);
+                data = &teller;
+            }
+            break;
+        case SERVER_ALLOCATE:
+            reply.status = allocateID(SALESEGMENTS, sizeof(SaleSegment), request->id);
+            break;
+        case SERVER_CHECKOUT:
+            if (request->id > 0 && (size_t)request->length == sizeof(sale) + (size_t)request->id * sizeof(SaleTransaction)
+                && (sales = arenaAlloc(&recordArena, (size_t)request->id * sizeof(SaleTransaction))) != NULL) {
+                memcpy(&sale, payload, sizeof(sale));
+                memcpy(sales, payload + sizeof(sale), (size_t)request->id * sizeof(SaleTransaction));
+                if (appendSales(&sale, sales, request->id) == 0) {
+                    reply.status = 0;
+                    reply.length = sizeof(sale);
+                    data = &sale;
+                }
+            }
+            break;
+    }
+    if (reserveOutput(out, sizeof(reply) + reply.length) != 0)
+        return -1;
+    memcpy(out->data + out->length, &reply, sizeof(reply));
+    if (reply.length > 0)
+        memcpy(out->data + out->length + sizeof(reply), data, reply.length);
+    out->length += sizeof(reply) + reply.length;
+    return 0;
+}
+/**
+ * @brief Connect to the POS server if it runs
+ * 
+ * @param path socket file of the server
+ * @return int the connection | -1 no server
+ */
+int connectServer(const char * path) {
+#ifdef __linux__
+    struct sockaddr_un addr;
+    int fd;
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+#else
+    return -1;
+#endif
+}
+/**
+ * @brief Close the connection of this lane to the POS server, the lane uses the records files itself from now on
+ * 
+ */
+void disconnectServer(void) {
+#ifdef __linux__
+    if (serverFd >= 0)
+        close(serverFd);
+#endif
+    serverFd = -1;
+}
+/**
+ * @brief Send a request to the POS server and wait for its reply
+ * A broken connection is closed, so the lane goes on without the server
+ * 
+ * @param op SERVER_PRODUCT | SERVER_TELLER | SERVER_ALLOCATE | SERVER_CHECKOUT
+ * @param id ID looked up; count of line items of a checkout
+ * @param payload payload of the request; NULL if none
+ * @param length size of the payload
+ * @param reply buffer of the payload of the reply
+ * @param replysize size of the reply buffer
+ * @return int status of the reply | -1 error
+ */
+int requestServer(int op, int id, const void * payload, int length, void * reply, int replysize) {
+#ifdef __linux__
+    ServerRequest request;
+    ServerReply header;
+    if (serverFd < 0)
+        return -1;
+    request.op = op;
+    request.id = id;
+    request.length = length;
+    if (writeSocket(serverFd, &request, sizeof(request)) != 0 || (length > 0 && writeSocket(serverFd, payload, length) != 0)
+        || readSocket(serverFd, &header, sizeof(header)) != 0 || header.length < 0 || header.length > replysize
+        || (header.length > 0 && readSocket(serverFd, reply, header.length) != 0)) {
+        fprintf(stderr, "LOST CONNECTION TO THE POS SERVER.\n");
+        disconnectServer();
+        return -1;
+    }
+    return header.status;
+#else
+    return -1;
+#endif
+}
+/**
+ * @brief Allocate consecutive sale IDs, through the POS server if this lane is connected to one
+ * 
+ * @param count count of IDs
+ * @return int the first new ID | -1 error
+ */
+int allocateSaleIDs(int count) {
+    int id;
+    if (serverFd >= 0) {
+        id = requestServer(SERVER_ALLOCATE, count, NULL, 0, NULL, 0);
+        if (serverFd >= 0)
+            return id; // allocated by the POS server, or -1 if it failed to
+    }
+    return allocateID(SALESEGMENTS, sizeof(SaleSegment), count); // no POS server, or the connection to it was lost
+}
+/**
+ * @brief Append a checkout to the sale segments, through the POS server if this lane is connected to one
+ * A checkout whose connection is lost before its reply is reported as failed, although the server may have appended it
+ * 
+ * @param sale sale header; its first_item and item_count are set to the appended line items
+ * @param sales line items
+ * @param count count of line items
+ * @return int 0 - success | -1 error
+ */
+int checkoutSale(SaleHeader * sale, const SaleTransaction * sales, int count) {
+    char * payload;
+    size_t length = sizeof(SaleHeader) + (size_t)count * sizeof(SaleTransaction);
+    int result;
+    if (serverFd < 0)
+        return appendSales(sale, sales, count);
+    if (length > SERVER_MAX_PAYLOAD || (payload = malloc(length)) == NULL)
+        return -1;
+    memcpy(payload, sale, sizeof(SaleHeader));
+    memcpy(payload + sizeof(SaleHeader), sales, (size_t)count * sizeof(SaleTransaction));
+    result = requestServer(SERVER_CHECKOUT, count, payload, (int)length, sale, sizeof(SaleHeader));
+    free(payload);
+    return result == 0 ? 0 : -1;
+}
+/**
+ * @brief Add an empty line item to a cart, growing the cart by doubling
+ * 
+ * @param cart cart of the transaction
+ * @return SaleTransaction* the new line item, zeroed; NULL if not enough memory
+ */
+SaleTransaction * addCartItem(Cart * cart) {
+    SaleTransaction * items;
+    size_t * offsets;
+    int capacity;
+    if (cart->count == cart->capacity) {
+        capacity = cart->capacity > 0 ? cart->capacity * 2 : CART_MIN_CAPACITY;
+        if ((items = realloc(cart->items, capacity * sizeof(SaleTransaction))) == NULL)
+            return NULL;
+        cart->items = items;
+        if ((offsets = realloc(cart->offsets, capacity * sizeof(size_t))) == NULL)
+            return NULL;
+        cart->offsets = offsets;
+        cart->capacity = capacity;
+    }
+    memset(&cart->items[cart->count], 0, sizeof(SaleTransaction));
+    cart->offsets[cart->count] = 0;
+    return &cart->items[cart->count++];
+}
+/**
+ * @brief Free the line items of a cart
+ * 
+ * @param cart cart of the transaction
+ */
+void freeCart(Cart * cart) {
+    free(cart->items);
+    free(cart->offsets);
+    cart->items = NULL;
+    cart->offsets = NULL;
+    cart->count = 0;
+    cart->capacity = 0;
+}
+/**
+ * @brief Compute payable amount of sales and return the amount
+ * 
+ * @param sale SaleTransaction structure data
+ * @return long long Total Payable Amount in cents
+ */
+long long compute_payable_amount(SaleTransaction * saleArray, int count) {
+    return sumSaleAmounts(saleArray, count);
+}
+/**
+ * @brief Compute the change of total payable amount and cash given and return the change amount
+ * 
+ * @param sale SaleTransaction structure data
+ * @return long long Total Change Amount in cents
+ */
+long long compute_change(long long payable_amount, long long cash) {
+    return cash - payable_amount;
+}
+/**
+ * @brief Convert an amount of older versions stored as a float to cents
+ * 
+ * @param value amount
+ * @return long long amount in cents, rounded to the nearest cent
+ */
+long long floatToCents(float value) {
+    return (long long)((double)value * 100.0 + (value < 0 ? -0.5 : 0.5));
+}
+/**
+ * @brief Parse an amount typed as digits with at most 2 decimals to cents, without going through a float
+ * 
+ * @param text amount such as "12", "12.5" or ".75"
+ * @return long long amount in cents; -1 if not a valid amount
+ */
+long long parseMoney(const char * text) {
+    long long cents = 0;
+    int decimals = -1, digits = 0; // -1 until the dot is read
+    for (; *text != 0; text++) {
+        if (*text == '.' && decimals < 0) {
+            decimals = 0;
+            continue;
+        }
+        if (!isdigit((unsigned char)*text) || decimals >= 2 || cents > LLONG_MAX / 100)
+            return -1;
+        cents = cents * 10 + (*text - '0');
+        digits++;
+        if (decimals >= 0)
+            decimals++;
+    }
+    if (digits == 0)
+        return -1;
+    for (decimals = decimals < 0 ? 0 : decimals; decimals < 2; decimals++)
+        cents *= 10;
+    return cents;
+}
+/**
+ * @brief Format an amount in cents with 2 decimals
+ * 
+ * @param buffer buffer of at least MONEY_SIZE characters
+ * @param cents amount in cents
+ * @return char* buffer
+ */
+char * formatMoney(char * buffer, long long cents) {
+    sprintf(buffer, "%s%lld.%02lld", cents < 0 ? "-" : "", (cents < 0 ? -cents : cents) / 100, (cents < 0 ? -cents : cents) % 100);
+    return buffer;
+}
+/**
+ * @brief Sum price x quantity over the contiguous price and quantity columns of line items
+ * The amounts are integers, so the sum is exact and its order does not matter: the compiler vectorizes
+ * this loop as it is, which it cannot do for a float sum without relaxing the floating-point rules
+ * 
+ * @param prices unit prices in cents
+ * @param quantities quantities
+ * @param count count of line items
+ * @return long long total amount in cents
+ */
+long long sumAmounts(const long long * restrict prices, const int * restrict quantities, int count) {
+    long long sum = 0;
+    int i;
+    for (i = 0; i < count; i++)
+        sum += prices[i] * quantities[i];
+    return sum;
+}
+/**
+ * @brief Sum price x quantity of sale line items
+ * The line items are gathered MONEY_CHUNK at a time into price and quantity columns for sumAmounts()
+ * 
+ * @param sales line items
+ * @param count count of line items
+ * @return long long total amount in cents
+ */
+long long sumSaleAmounts(const SaleTransaction * sales, int count) {
+    long long prices[MONEY_CHUNK], sum = 0;
+    int quantities[MONEY_CHUNK], i, n;
+    for (; count > 0; sales += n, count -= n) {
+        n = count < MONEY_CHUNK ? count : MONEY_CHUNK;
+        for (i = 0; i < n; i++) {
+            prices[i] = sales[i].unit_price;
+            quantities[i] = sales[i].quantity;
+        }
+        sum += sumAmounts(prices, quantities, n);
+    }
+    return sum;
+}
+/**
+ * @brief Compute the FNV-1a hash of bytes
+ * 
+ * @param data 
+ * @param size size of data in bytes
+ * @return unsigned int hash
+ */
+unsigned int fnv1a(const void * data, size_t size) {
+    const unsigned char * bytes = (const unsigned char *)data;
+    unsigned int hash = 2166136261u;
+    size_t i;
+    for (i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+/**
+ * @brief Compute the checksum of a records file header
+ * FNV-1a hash of all the header fields before the checksum
+ * 
+ * @param header records file header
+ * @return unsigned int checksum
+ */
+unsigned int headerChecksum(const RecordFileHeader * header) {
+    return fnv1a(header, offsetof(RecordFileHeader, checksum));
+}
+/**
+ * @brief Set up the header of an empty records file
+ * 
+ * @param header records file header buffer
+ * @param recordsize size of each record/row
+ */
+void initRecordHeader(RecordFileHeader * header, int recordsize) {
+    memset(header, 0, sizeof(RecordFileHeader));
+    header->magic = RECORD_MAGIC;
+    header->schema_version = SCHEMA_VERSION;
+    header->record_size = (unsigned short)recordsize;
+    header->next_id = 1; // IDs start at 1
+    header->checksum = headerChecksum(header);
+}
+/**
+ * @brief Create the records file with only its header if it does not exist, else validate its header
+ * 
+ * @param filename 
+ * @param recordsize size of each record/row
+ * @return int 0 - success | -1 error
+ */
+int initRecordFile(const char * filename, int recordsize) {
+    FILE * fp;
+    RecordFileHeader header;
+    int result;
+    if (fileExists(filename)) {
+        if ((fp = fopen(filename, "rb")) == NULL) {
+            fprintf(stderr, "CANNOT READ %s FILE.\n", filename);
+            return -1;
+        }
+        result = readRecordHeader(fp, filename, recordsize, &header);
+        fclose(fp);
+        return result;
+    }
+    if ((fp = fopen(filename, "wb")) == NULL) {
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", filename);
+        return -1;
+    }
+    initRecordHeader(&header, recordsize);
+    if (fwrite(&header, sizeof(header), 1, fp) != 1) {
+        fclose(fp);
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", filename);
+        return -1;
+    }
+    return fclose(fp) == 0 ? 0 : -1;
+}
+/**
+ * @brief Read and validate the header of an open records file
+ * A header with a wrong checksum (e.g. torn by a crash while it was written) is rebuilt from the records
+ * 
+ * @param fp open records file
+ * @param filename 
+ * @param recordsize size of each record/row
+ * @param header records file header buffer
+ * @return int 0 - success | -1 not a records file of this version
+ */
+int readRecordHeader(FILE * fp, const char * filename, int recordsize, RecordFileHeader * header) {
+    if (fseek(fp, 0, SEEK_SET) != 0 || fread(header, sizeof(RecordFileHeader), 1, fp) != 1
+        || header->magic != RECORD_MAGIC || header->schema_version != SCHEMA_VERSION || header->record_size != recordsize) {
+        fprintf(stderr, "UNSUPPORTED %s FILE FORMAT.\n", filename);
+        return -1;
+    }
+    if (header->checksum != headerChecksum(header)) {
+        fprintf(stderr, "REBUILDING %s FILE HEADER.\n", filename);
+        rebuildRecordHeader(fp, recordsize, header);
+    }
+    return fseek(fp, sizeof(RecordFileHeader), SEEK_SET); // leave the file at the first record
+}
+/**
+ * @brief Recount the count, deleted and next ID fields of a records file header from its records
+ * Only the id of each record is read
+ * 
+ * @param fp open records file
+ * @param recordsize size of each record/row
+ * @param header records file header to rebuild
+ */
+void rebuildRecordHeader(FILE * fp, int recordsize, RecordFileHeader * header) {
+    int i, id;
+    long size;
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp) - (long)sizeof(RecordFileHeader);
+    header->count = size > 0 ? (int)(size / recordsize) : 0; // ignore an incomplete trailing record
+    header->deleted = 0;
+    header->next_id = 1;
+    for (i = 0; i < header->count; i++) {
+        if (fseek(fp, (long)sizeof(RecordFileHeader) + (long)i * recordsize, SEEK_SET) != 0 || fread(&id, sizeof(int), 1, fp) != 1)
+            break;
+        if (id == DELETED_ID)
+            header->deleted++;
+        else if (id >= header->next_id)
+            header->next_id = id + 1;
+    }
+    header->checksum = headerChecksum(header);
+}
+/**
+ * @brief Write the header at the start of a records file
+ * 
+ * @param fp open records file
+ * @param filename 
+ * @param header records file header, its checksum is updated
+ * @return int 0 - success | -1 error
+ */
+int writeRecordHeader(FILE * fp, const char * filename, RecordFileHeader * header) {
+    header->checksum = headerChecksum(header);
+    if (fseek(fp, 0, SEEK_SET) != 0 || fwrite(header, sizeof(RecordFileHeader), 1, fp) != 1) {
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", filename);
+        return -1;
+    }
+    return 0;
+}
+/**
+ * @brief Lock an open file against the other processes until it is closed
+ * 
+ * @param fp open file
+ * @param exclusive 1 - exclusive (write) lock | 0 - shared (read) lock
+ * @return int 0 - success | -1 error
+ */
+int lockFile(FILE * fp, int exclusive) {
+#ifdef __linux__
+    return flock(fileno(fp), exclusive ? LOCK_EX : LOCK_SH);
+#else
+    return 0; // no advisory file locks, only one process may use the records files
+#endif
+}
+/**
+ * @brief Check if the open transaction holds the lock of a file
+ * A file locked through another open of the same process would never be granted to this process again
+ * 
+ * @param inode file identity
+ * @return int 1 - the lock is held | 0 - not held
+ */
+int holdsLock(long long inode) {
+#ifdef __linux__
+    struct stat st;
+    int i;
+    for (i = 0; i < wal.lockcount; i++)
+        if (fstat(fileno(wal.locks[i]), &st) == 0 && (long long)st.st_ino == inode)
+            return 1;
+#endif
+    return 0;
+}
+/**
+ * @brief Lock the lanes file for the whole run, every lane (process) sharing the records files holds it
+ * Only the first lane gets it exclusive: record slots may only be moved while no other lane has them
+ * mapped, and the lanes starting meanwhile wait until it is downgraded to a shared lock
+ * 
+ * @return int 1 - no other lane is running, the lock is exclusive | 0 - the lock is shared
+ */
+int joinLanes(void) {
+#ifdef __linux__
+    if ((laneLock = fopen(LANELOCK, "a+b")) == NULL)
+        return 0; // cannot tell if other lanes are running
+    if (flock(fileno(laneLock), LOCK_EX | LOCK_NB) == 0)
+        return 1;
+    lockFile(laneLock, 0);
+    return 0;
+#else
+    return 1;
+#endif
+}
+/**
+ * @brief Open a records file for update, lock it and begin a transaction
+ * Every update of the header goes through this lock so concurrent writers never allocate the same ID.
+ * The lock is held until the outermost transaction commits, so a transaction must not open the same
+ * records file twice
+ * 
+ * @param filename 
+ * @param recordsize size of each record/row
+ * @param header records file header buffer, read once the lock is held
+ * @return FILE* the locked file; NULL if error
+ */
+FILE * openRecordFile(const char * filename, int recordsize, RecordFileHeader * header) {
+    FILE * fp;
+#ifdef __linux__
+    struct stat locked, current;
+#endif
+    do {
+        if ((fp = fopen(filename, "r+b")) == NULL) {
+            fprintf(stderr, "CANNOT WRITE %s FILE.\n", filename);
+            return NULL;
+        }
+        if (lockFile(fp, 1) != 0) {
+            fclose(fp);
+            return NULL;
+        }
+#ifdef __linux__
+        if (fstat(fileno(fp), &locked) == 0 && stat(filename, &current) == 0 && locked.st_ino != current.st_ino) {
+            fclose(fp); // replaced by compactTrigramLog() of another lane while waiting for the lock, lock the new file
+            fp = NULL;
+        }
+#endif
+    } while (fp == NULL);
+    if (readRecordHeader(fp, filename, recordsize, header) != 0) {
+        fclose(fp);
+        return NULL;
+    }
+    beginTransaction();
+    holdLock(fp);
+    return fp;
+}
+/**
+ * @brief Write the header of a records file opened by openRecordFile() and commit the transaction
+ * The locked file is closed, and its lock released, when the outermost transaction ends
+ * 
+ * @param filename 
+ * @param header updated records file header
+ * @param durable 1 - sync the commit as set by the durability mode | 0 - the commit may be lost in a crash
+ * @return int 0 - success | -1 error
+ */
+int closeRecordFile(const char * filename, RecordFileHeader * header, int durable) {
+    header->checksum = headerChecksum(header);
+    if (logWrite(filename, 0, header, sizeof(RecordFileHeader)) != 0) {
+        abortTransaction();
+        return -1;
+    }
+    return commitTransaction(durable);
+}
+/**
+ * @brief Allocate the next IDs of a records file from its header
+ * The allocation is not synced: losing it in a crash is harmless since no record uses the IDs yet,
+ * and appendRecords() keeps the sequence ahead of the stored IDs. Its only write is the header, which
+ * a crash cannot leave partly applied
+ * 
+ * @param filename 
+ * @param recordsize size of each record/row
+ * @param count count of consecutive IDs to allocate
+ * @return int the first new ID | -1 error
+ */
+int allocateID(const char * filename, int recordsize, int count) {
+    FILE * fp;
+    RecordFileHeader header;
+    int id;
+    if (count < 1 || (fp = openRecordFile(filename, recordsize, &header)) == NULL)
+        return -1;
+    if (header.next_id > INT_MAX - count) { // the IDs would overflow
+        abortTransaction();
+        return -1;
+    }
+    id = header.next_id;
+    header.next_id += count;
+    if (closeRecordFile(filename, &header, 0) != 0)
+        return -1;
+    return id;
+}
+/**
+ * @brief Set the durability mode of the commits
+ * Only "fsync" keeps every commit atomic across a system crash, see commitTransaction()
+ * 
+ * @param mode "fsync" - sync every commit | "group[:ms[:count]]" - sync once count commits are pending,
+ * or once ms have passed since the last sync | "none" - never sync, no atomicity after a system crash
+ * @return int 0 - success | -1 unknown mode
+ */
+int setDurability(const char * mode) {
+    if (0 == strcmp(mode, "fsync"))
+        wal.durability = DURABILITY_FSYNC;
+    else if (0 == strcmp(mode, "none"))
+        wal.durability = DURABILITY_NONE;
+    else if (0 == strncmp(mode, "group", 5) && (mode[5] == 0 || mode[5] == ':')) {
+        wal.durability = DURABILITY_GROUP;
+        if (mode[5] == ':')
+            sscanf(mode + 6, "%d:%d", &wal.groupms, &wal.groupcount);
+        if (wal.groupms < 0 || wal.groupcount < 1)
+            return -1;
+    }
+    else
+        return -1;
+    return 0;
+}
+/**
+ * @brief Get a monotonic time in milliseconds
+ * 
+ * @return long long 
+ */
+long long nowMillis(void) {
+#ifdef __linux__
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#else
+    return (long long)time(NULL) * 1000; // one second precision is enough for group commits
+#endif
+}
+/**
+ * @brief Flush an open file and force its data to the disk
+ * 
+ * @param fp open file
+ * @return int 0 - success | -1 error
+ */
+int syncFile(FILE * fp) {
+    if (fflush(fp) != 0)
+        return -1;
+#ifdef _WIN32
+    return _commit(_fileno(fp));
+#elif __linux__
+    return fsync(fileno(fp));
+#else
+    return 0;
+#endif
+}
+/**
+ * @brief Force the renamed entries of the records directory (the current directory) to the disk
+ * 
+ * @return int 0 - success | -1 error
+ */
+int syncDirectory(void) {
+#ifdef __linux__
+    int fd, result;
+    if ((fd = open(".", O_RDONLY)) < 0)
+        return -1;
+    result = fsync(fd);
+    close(fd);
+    return result;
+#else
+    return 0; // a directory cannot be opened to be synced
+#endif
+}
+/**
+ * @brief Release a lock taken by lockFile() without closing the file
+ * 
+ * @param fp locked file
+ */
+void unlockFile(FILE * fp) {
+#ifdef __linux__
+    flock(fileno(fp), LOCK_UN);
+#endif
+}
+/**
+ * @brief Open the write-ahead log and redo the transactions committed but not yet checkpointed
+ * Only a crash leaves frames behind when no lane is running. The frames found while other lanes run
+ * are their live commits, on files they hold locked, so a joining lane opens the log without redo
+ * 
+ * @param redo 1 - no other lane is running, redo the frames left by a crash | 0 - only open the log
+ * @return int 0 - success | -1 error
+ */
+int openLog(int redo) {
+    if ((wal.fp = fopen(WALFILE, "a+b")) == NULL) { // every frame is appended even if another process truncated the log
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", WALFILE);
+        return -1;
+    }
+    wal.lastsync = nowMillis();
+#ifdef __linux__
+    pthread_mutex_init(&wal.mutex, NULL);
+#endif
+    if (wal.durability == DURABILITY_GROUP)
+        startLogFlusher(); // if it does not start, the group commits are synced by the next commit or the main menu
+    return redo ? replayLog(1) : 0;
+}
+/**
+ * @brief Checkpoint and close the write-ahead log
+ * 
+ */
+void closeLog(void) {
+    if (wal.fp == NULL)
+        return;
+#ifdef __linux__
+    if (wal.flushing) {
+        pthread_mutex_lock(&wal.mutex);
+        wal.flushing = 0;
+        pthread_cond_signal(&wal.wake);
+        pthread_mutex_unlock(&wal.mutex);
+        pthread_join(wal.flusher, NULL);
+        pthread_cond_destroy(&wal.wake);
+    }
+#endif
+    replayLog(0);
+    fclose(wal.fp);
+    wal.fp = NULL;
+    free(wal.buffer);
+    wal.buffer = NULL;
+    wal.capacity = 0;
+}
+/**
+ * @brief Start the thread syncing the pending group commits once groupms have passed since the last sync
+ * A lane may stay idle long after its last commit, its group would otherwise wait for the next commit.
+ * Without the thread (not Linux), the group is synced by the next commit or when the lane is back at the main menu
+ * 
+ * @return int 0 - started or not needed | -1 not started
+ */
+int startLogFlusher(void) {
+#ifdef __linux__
+    pthread_condattr_t attr;
+    if (wal.flushing || wal.fp == NULL || wal.durability != DURABILITY_GROUP)
+        return 0;
+    if (pthread_condattr_init(&attr) != 0)
+        return -1;
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC); // the deadlines are taken from nowMillis()
+    if (pthread_cond_init(&wal.wake, &attr) != 0) {
+        pthread_condattr_destroy(&attr);
+        return -1;
+    }
+    pthread_condattr_destroy(&attr);
+    wal.flushing = 1;
+    if (pthread_create(&wal.flusher, NULL, logFlusherThread, NULL) != 0) {
+        wal.flushing = 0;
+        pthread_cond_destroy(&wal.wake);
+        return -1;
+    }
+    return 0;
+#else
+    return -1;
+#endif
+}
+#ifdef __linux__
+/**
+ * @brief Flusher thread: sync the pending group commits once groupms have passed since the last sync
+ * 
+ * @param arg unused
+ * @return void* NULL
+ */
+void * logFlusherThread(void * arg) {
+    struct timespec deadline;
+    long long due;
+    (void)arg;
+    pthread_mutex_lock(&wal.mutex);
+    while (wal.flushing) {
+        due = wal.lastsync + wal.groupms;
+        if (wal.pending == 0)
+            pthread_cond_wait(&wal.wake, &wal.mutex); // woken by the commit starting the next group
+        else if (nowMillis() < due) {
+            deadline.tv_sec = due / 1000;
+            deadline.tv_nsec = (due % 1000) * 1000000;
+            pthread_cond_timedwait(&wal.wake, &wal.mutex, &deadline);
+        }
+        else
+            syncPending();
+    }
+    pthread_mutex_unlock(&wal.mutex);
+    return NULL;
+}
+#endif
+/**
+ * @brief Sync the write-ahead log if durable commits are pending, with wal.mutex held on Linux
+ * 
+ * @return int 0 - success | -1 error
+ */
+int syncPending(void) {
+    if (wal.pending == 0)
+        return 0;
+    wal.pending = 0;
+    wal.lastsync = nowMillis();
+    if (syncFile(wal.fp) != 0) {
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", WALFILE);
+        return -1;
+    }
+    return 0;
+}
+/**
+ * @brief Sync the pending commits of the write-ahead log, the lane is about to wait for the operator
+ * 
+ * @return int 0 - success | -1 error
+ */
+int syncLog(void) {
+    int result;
+    if (wal.fp == NULL)
+        return 0;
+#ifdef __linux__
+    pthread_mutex_lock(&wal.mutex);
+#endif
+    result = syncPending();
+#ifdef __linux__
+    pthread_mutex_unlock(&wal.mutex);
+#endif
+    return result;
+}
+/**
+ * @brief Begin a transaction, or join the open one
+ * The writes of a transaction are only buffered until the outermost transaction commits
+ * 
+ */
+void beginTransaction(void) {
+    if (wal.depth++ > 0)
+        return; // nested transaction
+    wal.failed = 0;
+    wal.renaming = 0;
+    wal.length = sizeof(WalFrameHeader); // the frame header is filled in at commit
+    wal.lockcount = 0;
+}
+/**
+ * @brief Add a write of a data file to the open transaction
+ * 
+ * @param filename data file
+ * @param offset byte offset from the start of file
+ * @param data data buffer to write
+ * @param size size of data in bytes
+ * @return int 0 - success | -1 error
+ */
+int logWrite(const char * filename, long offset, const void * data, int size) {
+    WalWrite write;
+    size_t needed;
+    char * buffer;
+    write.offset = offset;
+    write.size = size;
+    write.namelength = (int)strlen(filename);
+    needed = wal.length + sizeof(write) + write.namelength + size;
+    if (needed > wal.capacity) { // grow the frame buffer by doubling
+        size_t capacity = wal.capacity > 0 ? wal.capacity : 4096;
+        while (capacity < needed)
+            capacity *= 2;
+        if ((buffer = realloc(wal.buffer, capacity)) == NULL) {
+            fprintf(stderr, "CANNOT WRITE %s FILE.\n", filename);
+            return -1;
+        }
+        wal.buffer = buffer;
+        wal.capacity = capacity;
+    }
+    memcpy(wal.buffer + wal.length, &write, sizeof(write));
+    memcpy(wal.buffer + wal.length + sizeof(write), filename, write.namelength);
+    memcpy(wal.buffer + wal.length + sizeof(write) + write.namelength, data, size);
+    wal.length = needed;
+    return 0;
+}
+/**
+ * @brief Add a rename of a file to the open transaction, logged as a write at offset WAL_RENAME whose data is the
+ * name of the file renamed. The renames of one transaction happen all together: if a crash stops them midway,
+ * openLog() finishes them when the next lane starts alone
+ * 
+ * @param from file renamed, it replaces to
+ * @param to file replaced
+ * @return int 0 - success | -1 error
+ */
+int logRename(const char * from, const char * to) {
+    wal.renaming = 1;
+    return logWrite(to, WAL_RENAME, from, (int)strlen(from) + 1);
+}
+/**
+ * @brief Keep a locked file open until the outermost transaction ends
+ * 
+ * @param fp locked file
+ */
+void holdLock(FILE * fp) {
+    if (wal.lockcount < WAL_MAX_LOCKS)
+        wal.locks[wal.lockcount++] = fp;
+    else
+        fclose(fp); // too many locked files in one transaction, release this lock early
+}
+/**
+ * @brief Commit the open transaction, or leave a nested transaction
+ * The frame of the writes is appended to the write-ahead log, then the writes are applied to the data
+ * files. In fsync mode a durable frame is synced before it is applied, so a crash never leaves a partial
+ * transaction behind: the committed frames are redone by openLog() when the next lane starts alone. A group
+ * commit is applied before its group is synced, at the latest groupms later by the flusher thread, and a commit
+ * that is not durable is only synced along with a later one: a system crash meanwhile may lose these
+ * commits and, if the OS already wrote back some of their data, leave them partly applied. A crash of
+ * the lane alone loses nothing, the OS still writes back what was applied
+ * 
+ * @param durable 1 - sync the commit as set by the durability mode | 0 - the commit may be lost in a crash
+ * @return int 0 - success | -1 error, the transaction was not applied
+ */
+int commitTransaction(int durable) {
+    WalFrameHeader frame;
+    int i, result = 0;
+    if (--wal.depth > 0)
+        return wal.failed ? -1 : 0; // the outermost transaction commits
+    if (wal.failed)
+        result = -1;
+    else if (wal.length > sizeof(WalFrameHeader)) {
+        frame.magic = WAL_MAGIC;
+        frame.size = (unsigned int)(wal.length - sizeof(frame));
+        frame.checksum = fnv1a(wal.buffer + sizeof(frame), frame.size);
+        memcpy(wal.buffer, &frame, sizeof(frame));
+        if (wal.fp != NULL) {
+            lockFile(wal.fp, 1); // one commit at a time so the frames are in the order they are applied
+#ifdef __linux__
+            pthread_mutex_lock(&wal.mutex);
+#endif
+            if (fwrite(wal.buffer, 1, wal.length, wal.fp) != wal.length || fflush(wal.fp) != 0) {
+                fprintf(stderr, "CANNOT WRITE %s FILE.\n", WALFILE);
+                result = -1;
+            }
+            else if (wal.durability != DURABILITY_NONE) {
+                if (durable)
+                    wal.pending++;
+                if (wal.durability == DURABILITY_FSYNC || wal.pending >= wal.groupcount || wal.renaming
+                    || nowMillis() - wal.lastsync >= wal.groupms) // a group commit also syncs the earlier pending commits
+                    result = syncPending();
+#ifdef __linux__
+                else if (wal.flushing)
+                    pthread_cond_signal(&wal.wake); // the flusher syncs the group at its deadline
+#endif
+            }
+#ifdef __linux__
+            pthread_mutex_unlock(&wal.mutex);
+#endif
+        }
+        if (result == 0)
+            result = applyWrites(wal.buffer + sizeof(frame), frame.size);
+        if (wal.fp != NULL)
+            unlockFile(wal.fp);
+    }
+    for (i = 0; i < wal.lockcount; i++)
+        fclose(wal.locks[i]); // closing the file releases its lock
+    wal.lockcount = 0;
+    wal.length = 0;
+    if (result == 0 && wal.fp != NULL && ftell(wal.fp) > WAL_CHECKPOINT_SIZE)
+        replayLog(0);
+    return result;
+}
+/**
+ * @brief Abort the open transaction, its writes are dropped when the outermost transaction ends
+ * 
+ */
+void abortTransaction(void) {
+    wal.failed = 1;
+    commitTransaction(0);
+}
+/**
+ * @brief Apply the writes of one transaction frame to the data files
+ * 
+ * @param writes writes following the frame header
+ * @param size size of the writes
+ * @return int 0 - success | -1 error
+ */
+int applyWrites(const char * writes, size_t size) {
+    FILE * fp = NULL;
+    WalWrite write;
+    char filename[MAX_NAME], current[MAX_NAME] = "";
+    size_t pos = 0;
+    int result = 0;
+    while (pos + sizeof(write) <= size) {
+        memcpy(&write, writes + pos, sizeof(write));
+        pos += sizeof(write);
+        if (write.namelength <= 0 || write.namelength >= MAX_NAME || write.size < 0 || pos + write.namelength + write.size > size)
+            return -1; // not a frame written by logWrite()
+        memcpy(filename, writes + pos, write.namelength);
+        filename[write.namelength] = 0;
+        pos += write.namelength;
+        if (write.offset == WAL_RENAME) { // see logRename()
+            if (fp != NULL && fclose(fp) != 0)
+                result = -1;
+            fp = NULL;
+            if (write.size <= 0 || write.size > MAX_NAME || writes[pos + write.size - 1] != 0)
+                return -1;
+            if (fileExists(writes + pos)) { // when redone, the files already renamed before the crash are skipped
+#ifdef _WIN32
+                remove(filename); // rename() does not replace an existing file on Windows
+#endif
+                if (rename(writes + pos, filename) != 0 || (wal.durability != DURABILITY_NONE && syncDirectory() != 0)) {
+                    fprintf(stderr, "CANNOT WRITE %s FILE.\n", filename);
+                    result = -1;
+                }
+            }
+            pos += write.size;
+            continue;
+        }
+        if (fp == NULL || 0 != strcmp(filename, current)) { // consecutive writes of the same file share one open
+            if (fp != NULL && fclose(fp) != 0)
+                result = -1;
+            if ((fp = fopen(filename, "r+b")) == NULL && (fileExists(filename) || (fp = fopen(filename, "w+b")) == NULL)) {
+                fprintf(stderr, "CANNOT WRITE %s FILE.\n", filename);
+                return -1;
+            }
+            strcpy(current, filename);
+        }
+        if (fseek(fp, (long)write.offset, SEEK_SET) != 0 || fwrite(writes + pos, 1, write.size, fp) != (size_t)write.size) {
+            fprintf(stderr, "CANNOT WRITE %s FILE.\n", filename);
+            result = -1;
+        }
+        pos += write.size;
+    }
+    if (fp != NULL && fclose(fp) != 0)
+        result = -1;
+    return result;
+}
+/**
+ * @brief Read the committed frames of the write-ahead log, sync the data files they wrote and truncate the log
+ * A frame torn by a crash ends the log. In fsync mode it was never applied, since a durable frame is synced
+ * before it is applied; a group commit not yet synced may have been partly written back (see commitTransaction())
+ * 
+ * @param redo 1 - apply the frames again (recovery) | 0 - only checkpoint the frames already applied
+ * @return int count of frames | -1 error
+ */
+int replayLog(int redo) {
+    WalFrameHeader frame;
+    WalWrite write;
+    FILE * fp;
+    char * writes = NULL, * grown, (* synced)[MAX_NAME] = NULL, (* more)[MAX_NAME];
+    size_t capacity = 0, pos;
+    int i, frames = 0, syncedcount = 0, syncedcapacity = 0, result = 0;
+    if (wal.fp == NULL)
+        return 0;
+    lockFile(wal.fp, 1);
+#ifdef __linux__
+    pthread_mutex_lock(&wal.mutex);
+#endif
+    fseek(wal.fp, 0, SEEK_SET);
+    while (fread(&frame, sizeof(frame), 1, wal.fp) == 1 && frame.magic == WAL_MAGIC) {
+        if (frame.size > capacity) {
+            if ((grown = realloc(writes, frame.size)) == NULL)
+                break;
+            writes = grown;
+            capacity = frame.size;
+        }
+        if (fread(writes, 1, frame.size, wal.fp) != frame.size || fnv1a(writes, frame.size) != frame.checksum)
+            break; // torn frame
+        if (redo && applyWrites(writes, frame.size) != 0)
+            result = -1;
+        for (pos = 0; pos + sizeof(write) <= frame.size; pos += sizeof(write) + write.namelength + write.size) {
+            memcpy(&write, writes + pos, sizeof(write));
+            if (write.namelength <= 0 || write.namelength >= MAX_NAME || write.size < 0)
+                break;
+            for (i = 0; i < syncedcount; i++) // remember each data file once
+                if (0 == strncmp(synced[i], writes + pos + sizeof(write), write.namelength) && synced[i][write.namelength] == 0)
+                    break;
+            if (i < syncedcount)
+                continue;
+            if (syncedcount == syncedcapacity) { // grow the list by doubling, a checkpoint may cover every data file
+                if ((more = realloc(synced, (syncedcapacity > 0 ? syncedcapacity * 2 : WAL_MAX_LOCKS) * sizeof(*synced))) == NULL) {
+                    result = -1; // a data file would not be synced, keep the log
+                    break;
+                }
+                synced = more;
+                syncedcapacity = syncedcapacity > 0 ? syncedcapacity * 2 : WAL_MAX_LOCKS;
+            }
+            memcpy(synced[syncedcount], writes + pos + sizeof(write), write.namelength);
+            synced[syncedcount++][write.namelength] = 0;
+        }
+        frames++;
+    }
+    free(writes);
+    if (redo && frames > 0)
+        fprintf(stderr, "REDONE %d TRANSACTIONS FROM %s FILE.\n", frames, WALFILE);
+    for (i = 0; i < syncedcount && wal.durability != DURABILITY_NONE; i++) { // the data files must be on disk before their frames are dropped
+        if ((fp = fopen(synced[i], "r+b")) == NULL)
+            continue;
+        if (syncFile(fp) != 0)
+            result = -1;
+        fclose(fp);
+    }
+    free(synced);
+    if (result == 0) { // keep the log for the next start if a data file could not be written
+#ifdef _WIN32
+        _chsize(_fileno(wal.fp), 0);
+#elif __linux__
+        ftruncate(fileno(wal.fp), 0);
+#endif
+        if (wal.durability != DURABILITY_NONE)
+            wal.pending = 0; // the data files of the pending commits are on disk
+    }
+    fseek(wal.fp, 0, SEEK_END);
+#ifdef __linux__
+    pthread_mutex_unlock(&wal.mutex);
+#endif
+    unlockFile(wal.fp);
+    return result == 0 ? frames : -1;
+}
+/**
+ * @brief Overwrite bytes of an existing file at a specific offset
+ * The write is committed through the write-ahead log, as part of the open transaction if any
+ * 
+ * @param filename 
+ * @param offset byte offset from the start of file
+ * @param data data buffer to write
+ * @param size size of data in bytes
+ * @return int 0 - success | -1 error
+ */
+int writeToFileAt(const char * filename, long offset, const void * data, int size) {
+    beginTransaction();
+    if (logWrite(filename, offset, data, size) != 0) {
+        abortTransaction();
+        return -1;
+    }
+    if (commitTransaction(1) != 0)
+        return -1;
+    compactTrigramLog(&productTrigrams); // a failed compaction leaves the posting log as is
+    return 0;
+}
+/**
+ * @brief Overwrite one fixed-size record slot in file
+ * 
+ * @param filename 
+ * @param recordsize size of each record/row
+ * @param index slot index of the record in file
+ * @param record the new record data
+ * @return int 0 - success | -1 error
+ */
+int writeRecordAt(const char * filename, int recordsize, int index, const void * record) {
+    return writeToFileAt(filename, (long)sizeof(RecordFileHeader) + (long)index * recordsize, record, recordsize);
+}
+/**
+ * @brief Mark one record slot as deleted by overwriting its id with DELETED_ID (tombstone)
+ * All record structs start with the int id so only the id is written.
+ * The slot is reclaimed later by compactRecords(), until then it is counted as deleted in the header
+ * 
+ * @param filename 
+ * @param recordsize size of each record/row
+ * @param index slot index of the record in file
+ * @return int 0 - success | -1 error
+ */
+int deleteRecordAt(const char * filename, int recordsize, int index) {
+    FILE * fp;
+    RecordFileHeader header;
+    int deleted = DELETED_ID;
+    if ((fp = openRecordFile(filename, recordsize, &header)) == NULL)
+        return -1;
+    if (index < 0 || index >= header.count
+        || writeToFileAt(filename, (long)sizeof(RecordFileHeader) + (long)index * recordsize, &deleted, sizeof(int)) != 0) {
+        abortTransaction();
+        return -1;
+    }
+    header.deleted++;
+    return closeRecordFile(filename, &header, 1);
+}
+/**
+ * @brief Append records after the last record slot of file
+ * The previous records are left untouched so a checkout only costs the write of its own line items
+ * 
+ * @param filename 
+ * @param recordsize size of each record/row
+ * @param records array of the new records
+ * @param count count of the new records
+ * @return int slot index of the first new record | -1 error
+ */
+int appendRecords(const char * filename, int recordsize, const void * records, int count) {
+    FILE * fp;
+    RecordFileHeader header;
+    int i, id, first;
+    if ((fp = openRecordFile(filename, recordsize, &header)) == NULL)
+        return -1;
+    first = header.count;
+    if (writeToFileAt(filename, (long)sizeof(RecordFileHeader) + (long)first * recordsize, records, recordsize * count) != 0) { // write all new records at once
+        abortTransaction();
+        return -1;
+    }
+    for (i = 0; i < count; i++) {
+        memcpy(&id, (const char *)records + (size_t)i * recordsize, sizeof(int)); // all record structs start with the int id
+        if (id >= header.next_id)
+            header.next_id = id + 1; // keep the sequence ahead of IDs not taken from allocateID()
+    }
+    header.count += count; // the new records only count once the header is written after them
+    if (closeRecordFile(filename, &header, 1) != 0)
+        return -1;
+    return first;
+}
+/**
+ * @brief Reclaim the deleted record slots of file and the strings no longer used by its records
+ * Streams the live records one at a time to a temporary file and copies their strings to a temporary
+ * string heap, which then replace the records file and its string heap in one logged transaction, so a
+ * crash never leaves one file replaced without the other. The files are left untouched if there is
+ * nothing worth reclaiming or if an error occurs
+ * 
+ * @param filename 
+ * @param recordsize size of each record/row
+ * @param heapname string heap of the records file
+ * @param stringcount count of string offsets following the id in each record
+ * @return int count of reclaimed slots | -1 error
+ */
+int compactRecords(const char * filename, int recordsize, const char * heapname, int stringcount) {
+    FILE * fp, * tmp, * tmpheap;
+    char tempname[MAX_NAME], tempheapname[MAX_NAME], * record;
+    const char * str;
+    int i, id, k, offset, deleted = 0;
+    unsigned short len;
+    long heapsize = 0; // size of the new string heap
+    RecordView heap = { .filename = heapname, .recordsize = 1, .headersize = 0 };
+    RecordFileHeader header;
+    if (snprintf(tempname, sizeof(tempname), "%s.tmp", filename) >= (int)sizeof(tempname)
+        || snprintf(tempheapname, sizeof(tempheapname), "%s.tmp", heapname) >= (int)sizeof(tempheapname))
+        return -1; // the temporary names would be cut
+    if ((record = arenaAlloc(&recordArena, recordsize)) == NULL || (fp = fopen(filename, "rb")) == NULL)
+        return -1;
+    if (lockFile(fp, 1) != 0 || readRecordHeader(fp, filename, recordsize, &header) != 0) { // locked so no record is added while compacting
+        fclose(fp);
+        return -1;
+    }
+    if (replayLog(0) < 0) { // the logged writes refer to the offsets of the files about to be replaced
+        fclose(fp);
+        return -1;
+    }
+    tmp = fopen(tempname, "wb");
+    tmpheap = fopen(tempheapname, "wb");
+    if (tmp == NULL || tmpheap == NULL) {
+        fclose(fp);
+        if (tmp != NULL) fclose(tmp);
+        if (tmpheap != NULL) fclose(tmpheap);
+        return -1;
+    }
+    refreshRecordView(&heap);
+    fwrite(&header, sizeof(header), 1, tmp); // placeholder, the header is rewritten once the records are copied
+    for (i = 0; i < header.count && fread(record, recordsize, 1, fp) == 1; i++) {
+        memcpy(&id, record, sizeof(int)); // all record structs start with the int id
+        if (id == DELETED_ID) {
+            deleted++;
+            continue; // skip deleted record slots
+        }
+        for (k = 0; k < stringcount; k++) { // copy the strings of the record to the new string heap
+            memcpy(&offset, record + sizeof(int) * (k + 1), sizeof(int));
+            str = heapString(&heap, offset);
+            len = (unsigned short)strlen(str);
+            fwrite(&len, sizeof(len), 1, tmpheap);
+            fwrite(str, 1, len + 1, tmpheap);
+            offset = (int)heapsize;
+            heapsize += sizeof(len) + len + 1;
+            memcpy(record + sizeof(int) * (k + 1), &offset, sizeof(int));
+        }
+        if (fwrite(record, recordsize, 1, tmp) != 1) {
+            deleted = -1;
+            break;
+        }
+    }
+    header.count = i - deleted; // the next ID is kept so the IDs of the deleted records are not reused
+    header.deleted = 0;
+    if (deleted >= 0 && writeRecordHeader(tmp, tempname, &header) != 0)
+        deleted = -1;
+    if (wal.durability != DURABILITY_NONE && (syncFile(tmp) != 0 || syncFile(tmpheap) != 0)) // the new files must be on disk before they replace the old ones
+        deleted = -1;
+    if (fclose(tmp) != 0 || fclose(tmpheap) != 0)
+        deleted = -1;
+    if (deleted < 0 || (deleted == 0 && heapsize * 2 >= (long)heap.size)) { // write error, or no deleted slots and at most half of the heap is unused
+        closeRecordView(&heap);
+        fclose(fp);
+        remove(tempname);
+        remove(tempheapname);
+        return deleted;
+    }
+    closeRecordView(&heap);
+#ifdef _WIN32
+    fclose(fp); // open files cannot be removed on Windows
+#endif
+    beginTransaction(); // the records file and its heap are replaced together, the offsets of one match the other
+    if (logRename(tempheapname, heapname) != 0 || logRename(tempname, filename) != 0)
+        abortTransaction();
+    if (commitTransaction(1) != 0) {
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", filename);
+        deleted = -1;
+    }
+#ifndef _WIN32
+    fclose(fp); // the lock is released once the compacted file has replaced the old one
+#endif
+    return deleted;
+}
+/**
+ * @brief Map the records file as a read-only typed array, remapping it if the file has grown or was replaced
+ * The records are not copied: view->base points directly to the file contents, and in-place writes
+ * through writeRecordAt() are visible in the mapping without remapping. The count of records is read
+ * from the file header, so records being appended are not seen before the header counts them.
+ * The file is mapped under a shared lock, so a records file or string heap is never mapped while another lane applies a commit to it
+ * 
+ * @param view records file view
+ * @return int count of records in the view
+ */
+int refreshRecordView(RecordView * view) {
+#ifdef __linux__
+    struct stat st;
+    int fd;
+    size_t size;
+    void * map;
+    if (stat(view->filename, &st) != 0) {
+        fprintf(stderr, "Failed to open %s Records.", view->filename);
+        closeRecordView(view);
+        return 0;
+    }
+    size = (size_t)st.st_size;
+    if (view->map != NULL && size == view->size && (long long)st.st_ino == view->inode)
+        return view->count; // file has not grown nor been replaced, the mapping is still up-to-date
+    closeRecordView(view);
+    if ((fd = open(view->filename, O_RDONLY)) < 0) {
+        fprintf(stderr, "Failed to open %s Records.", view->filename);
+        return 0;
+    }
+    if (!holdsLock((long long)st.st_ino))
+        flock(fd, LOCK_SH); // a writer of another lane finishes its commit before the file is mapped
+    if (fstat(fd, &st) != 0)
+        st.st_size = 0;
+    size = (size_t)st.st_size;
+    view->inode = (long long)st.st_ino;
+    if (size == 0 || size < (size_t)view->headersize) {
+        close(fd);
+        return 0; // empty files cannot be mapped
+    }
+    map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    flock(fd, LOCK_UN); // the mapping keeps the file open, so closing it would not release the lock
+    close(fd); // the mapping stays valid after the file is closed
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed to map %s Records.", view->filename);
+        return 0;
+    }
+#else // no mmap: read the whole file into one buffer with a single fread
+    FILE * fp;
+    long size;
+    void * map;
+    closeRecordView(view);
+    if ((fp = fopen(view->filename, "rb")) == NULL) {
+        fprintf(stderr, "Failed to open %s Records.", view->filename);
+        return 0;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size <= 0 || size < view->headersize || (map = malloc(size)) == NULL) {
+        fclose(fp);
+        return 0;
+    }
+    size = (long)fread(map, 1, size, fp);
+    fclose(fp);
+#endif
+    view->map = map;
+    view->size = (size_t)size;
+    view->base = (char *)map + view->headersize;
+    view->count = (int)((view->size - view->headersize) / view->recordsize); // ignore an incomplete trailing record
+    if (view->headersize > 0) {
+        view->header = map;
+        if (view->header->magic != view->magic || view->header->record_size != view->recordsize) {
+            fprintf(stderr, "UNSUPPORTED %s FILE FORMAT.\n", view->filename);
+            closeRecordView(view);
+            return 0;
+        }
+        if (view->header->count < view->count)
+            view->count = view->header->count;
+    }
+    return view->count;
+}
+/**
+ * @brief Refresh the views of a catalog if its records file has changed since the last refresh
+ * Our own writes and the in-place writes of other processes are seen through the shared mappings, so
+ * one stat of the records file is enough while it is unchanged. All writes of the records also write
+ * the records file (record slot or header), so a changed records file revalidates the string heap and
+ * the index too. A modification time less than 2 seconds before the last refresh is not trusted, as
+ * a write in the same clock tick would not change it
+ * 
+ * @param catalog 
+ * @return int count of records in the records view
+ */
+int refreshCatalog(Catalog * catalog) {
+    struct stat st;
+    long long mtime;
+    if (stat(catalog->records->filename, &st) != 0) {
+        catalog->mtime = -1;
+        return refreshRecordView(catalog->records); // closes the view and reports the missing file
+    }
+#ifdef __linux__
+    mtime = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#else
+    mtime = (long long)st.st_mtime * 1000000000LL;
+#endif
+    if (catalog->records->map != NULL && mtime == catalog->mtime && (long long)st.st_size == catalog->size
+        && (long long)st.st_ino == catalog->inode && mtime / 1000000000LL < catalog->checked - 1)
+        return catalog->records->count; // unchanged since the last refresh
+    catalog->mtime = mtime;
+    catalog->size = (long long)st.st_size;
+    catalog->inode = (long long)st.st_ino;
+    catalog->checked = (long long)time(NULL);
+    refreshRecordView(catalog->strings);
+    if (catalog->index != NULL)
+        refreshRecordView(catalog->index);
+    return refreshRecordView(catalog->records);
+}
+/**
+ * @brief Unmap the records file of the view
+ * 
+ * @param view records file view
+ */
+void closeRecordView(RecordView * view) {
+    if (view->map != NULL) {
+#ifdef __linux__
+        munmap(view->map, view->size);
+#else
+        free(view->map);
+#endif
+    }
+    view->map = NULL;
+    view->header = NULL;
+    view->base = NULL;
+    view->size = 0;
+    view->count = 0;
+}
+/**
+ * @brief Get a string from a string heap by offset
+ * The string points directly into the heap view and is valid until the view is refreshed
+ * 
+ * @param heap string heap view
+ * @param offset offset of the length-prefixed string
+ * @return const char* the string; empty string if the offset is out of the heap
+ */
+const char * heapString(RecordView * heap, int offset) {
+    unsigned short len;
+    if (offset < 0 || (size_t)offset + sizeof(len) > heap->size)
+        return "";
+    memcpy(&len, (const char *)heap->base + offset, sizeof(len));
+    if ((size_t)offset + sizeof(len) + len + 1 > heap->size)
+        return ""; // incomplete string at the end of the heap
+    return (const char *)heap->base + offset + sizeof(len);
+}
+/**
+ * @brief Append the changed strings of a record to a string heap
+ * Strings which are the same as the old string at oldOffsets are not written again. The heap is locked
+ * until the open transaction commits, so the lanes never append their strings at the same offset
+ * 
+ * @param heap string heap view
+ * @param strings strings of the record
+ * @param offsets buffer for the heap offsets of the strings
+ * @param oldOffsets heap offsets of the previous strings of the record; NULL for a new record
+ * @param count count of strings
+ * @return int 0 - success | -1 error
+ */
+int writeHeapStrings(RecordView * heap, const char ** strings, int * offsets, const int * oldOffsets, int count) {
+    FILE * fp;
+    char entry[sizeof(unsigned short) + MAX_NAME];
+    int k;
+    long offset;
+    unsigned short len;
+    if ((fp = fopen(heap->filename, "ab")) == NULL) {
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", heap->filename);
+        return -1;
+    }
+    if (lockFile(fp, 1) != 0) {
+        fclose(fp);
+        return -1;
+    }
+    beginTransaction();
+    holdLock(fp);
+    refreshRecordView(heap);
+    fseek(fp, 0, SEEK_END);
+    offset = ftell(fp); // new strings are appended at the end of the heap, other lanes may have grown it
+    for (k = 0; k < count; k++) {
+        if (oldOffsets != NULL && 0 == strcmp(heapString(heap, oldOffsets[k]), strings[k])) {
+            offsets[k] = oldOffsets[k]; // unchanged string
+            continue;
+        }
+        len = (unsigned short)strnlen(strings[k], MAX_NAME - 1);
+        memcpy(entry, &len, sizeof(len));
+        memcpy(entry + sizeof(len), strings[k], len);
+        entry[sizeof(len) + len] = 0; // including the null character
+        if (0 != writeToFileAt(heap->filename, offset, entry, sizeof(len) + len + 1)) {
+            abortTransaction();
+            return -1;
+        }
+        offsets[k] = (int)offset;
+        offset += sizeof(len) + len + 1;
+    }
+    if (commitTransaction(1) != 0)
+        return -1;
+    compactTrigramLog(&tellerTrigrams); // a failed compaction leaves the posting log as is
+    return 0;
+}
+/**
+ * @brief Get a string of a product record
+ * 
+ * @param offset heap offset of the string
+ * @return const char* 
+ */
+const char * productString(int offset) {
+    return heapString(&productStringView, offset);
+}
+/**
+ * @brief Get a string of a teller record
+ * 
+ * @param offset heap offset of the string
+ * @return const char* 
+ */
+const char * tellerString(int offset) {
+    return heapString(&tellerStringView, offset);
+}
+/**
+ * @brief Copy a product record with its strings to a Product struct
+ * 
+ * @param record product record from the product records view
+ * @param product Product struct buffer
+ */
+void loadProduct(const ProductRecord * record, Product * product) {
+    memset(product, 0, sizeof(Product));
+    product->id = record->id;
+    strncpy(product->name, productString(record->name), MAX_NAME - 1);
+    strncpy(product->description, productString(record->description), MAX_NAME - 1);
+    strncpy(product->category, productString(record->category), MAX_NAME - 1);
+    strncpy(product->unit, productString(record->unit), MAX_NAME - 1);
+    product->unit_price = record->unit_price;
+    product->version = record->version;
+}
+/**
+ * @brief Copy a teller record with its strings to a Teller struct
+ * 
+ * @param record teller record from the teller records view
+ * @param teller Teller struct buffer
+ */
+void loadTeller(const TellerRecord * record, Teller * teller) {
+    memset(teller, 0, sizeof(Teller));
+    teller->id = record->id;
+    strncpy(teller->first_name, tellerString(record->first_name), MAX_NAME - 1);
+    strncpy(teller->middle_name, tellerString(record->middle_name), MAX_NAME - 1);
+    strncpy(teller->last_name, tellerString(record->last_name), MAX_NAME - 1);
+}
+/**
+ * @brief Write a Product struct to its record slot with its changed strings appended to the string heap
+ * The strings, the record, its trigram postings and the hash index entry of a new record are committed in one transaction
+ * 
+ * @param product Product struct data
+ * @param index record slot of the product; -1 to append a new record
+ * @return int 0 - success | -1 error
+ */
+int storeProduct(const Product * product, int index) {
+    ProductRecord record;
+    const ProductRecord * old = NULL;
+    const char * strings[4] = { product->name, product->description, product->category, product->unit }, * oldName;
+    memset(&record, 0, sizeof(record));
+    if (index >= 0 && index < refreshRecordView(&productView))
+        old = &((const ProductRecord *)productView.base)[index];
+    beginTransaction();
+    if (0 != writeHeapStrings(&productStringView, strings, &record.name, old != NULL ? &old->name : NULL, 4)) { // the 4 string offsets of the old record
+        abortTransaction();
+        return -1;
+    }
+    record.id = product->id;
+    record.unit_price = product->unit_price;
+    record.version = old != NULL ? old->version + 1 : 1;
+    if (index < 0) { // a new record also needs its hash index entry, an updated record keeps its slot
+        if ((index = appendRecords(PRODUCTRECORDS, sizeof(ProductRecord), &record, 1)) < 0
+            || 0 != updateIndexEntry(&productIndexView, record.id, index)) {
+            abortTransaction();
+            return -1;
+        }
+    }
+    else if (0 != writeRecordAt(PRODUCTRECORDS, sizeof(ProductRecord), index, &record)) {
+        abortTransaction();
+        return -1;
+    }
+    oldName = old != NULL ? productString(old->name) : NULL;
+    if (0 != updateTrigrams(&productTrigrams, index, old != NULL ? &oldName : NULL, strings, 1)) { // strings[0] is the name
+        abortTransaction();
+        return -1;
+    }
+    if (commitTransaction(1) != 0)
+        return -1;
+    compactTrigramLog(&productTrigrams); // a failed compaction leaves the posting log as is
+    return 0;
+}
+/**
+ * @brief Write a Teller struct to its record slot with its changed strings appended to the string heap
+ * The strings, the record and its trigram postings are committed in one transaction
+ * 
+ * @param teller Teller struct data
+ * @param index record slot of the teller; -1 to append a new record
+ * @return int 0 - success | -1 error
+ */
+int storeTeller(const Teller * teller, int index) {
+    TellerRecord record;
+    const char * strings[3] = { teller->first_name, teller->middle_name, teller->last_name }, * oldStrings[3];
+    const int * oldOffsets = NULL;
+    int k;
+    memset(&record, 0, sizeof(record));
+    if (index >= 0 && index < refreshRecordView(&tellerView))
+        oldOffsets = &((const TellerRecord *)tellerView.base)[index].first_name; // the 3 string offsets of the old record
+    beginTransaction();
+    if (0 != writeHeapStrings(&tellerStringView, strings, &record.first_name, oldOffsets, 3)) {
+        abortTransaction();
+        return -1;
+    }
+    record.id = teller->id;
+    for (k = 0; oldOffsets != NULL && k < 3; k++)
+        oldStrings[k] = tellerString(oldOffsets[k]);
+    if (index < 0) {
+        if ((index = appendRecords(TELLERRECORDS, sizeof(TellerRecord), &record, 1)) < 0) {
+            abortTransaction();
+            return -1;
+        }
+    }
+    else if (0 != writeRecordAt(TELLERRECORDS, sizeof(TellerRecord), index, &record)) {
+        abortTransaction();
+        return -1;
+    }
+    if (0 != updateTrigrams(&tellerTrigrams, index, oldOffsets != NULL ? oldStrings : NULL, strings, 3)) {
+        abortTransaction();
+        return -1;
+    }
+    if (commitTransaction(1) != 0)
+        return -1;
+    compactTrigramLog(&tellerTrigrams); // a failed compaction leaves the posting log as is
+    return 0;
+}
+/**
+ * @brief Convert the fixed-size Product records of older versions to the product records and string heap
+ * Streams one legacy record at a time so memory use does not depend on the size of the catalog
+ * 
+ * @return int 0 - success | -1 error
+ */
+int convertLegacyProducts(void) {
+    FILE * fp, * out, * heap;
+    LegacyProduct legacy;
+    ProductRecord record;
+    RecordFileHeader header;
+    const char * strings[4];
+    int k, * offsets = &record.name;
+    long offset = 0;
+    unsigned short len;
+    if ((fp = fopen(LEGACYPRODUCTRECORDS, "rb")) == NULL)
+        return -1;
+    out = fopen(PRODUCTRECORDS ".tmp", "wb");
+    heap = fopen(PRODUCTSTRINGS, "wb");
+    if (out == NULL || heap == NULL) {
+        fclose(fp);
+        if (out != NULL) fclose(out);
+        if (heap != NULL) fclose(heap);
+        fprintf(stderr, "CANNOT CONVERT %s FILE.\n", LEGACYPRODUCTRECORDS);
+        return -1;
+    }
+    initRecordHeader(&header, sizeof(record));
+    fwrite(&header, sizeof(header), 1, out); // placeholder, the header is rewritten once the records are converted
+    while (fread(&legacy, sizeof(LegacyProduct), 1, fp) == 1) {
+        memset(&record, 0, sizeof(record));
+        record.id = legacy.id;
+        record.unit_price = floatToCents(legacy.unit_price);
+        record.version = 1;
+        strings[0] = legacy.name;
+        strings[1] = legacy.description;
+        strings[2] = legacy.category;
+        strings[3] = legacy.unit;
+        for (k = 0; k < 4; k++) {
+            len = (unsigned short)strnlen(strings[k], MAX_NAME - 1);
+            fwrite(&len, sizeof(len), 1, heap);
+            fwrite(strings[k], 1, len, heap);
+            fputc(0, heap);
+            offsets[k] = (int)offset;
+            offset += sizeof(len) + len + 1;
+        }
+        fwrite(&record, sizeof(record), 1, out);
+        header.count++;
+        if (record.id >= header.next_id)
+            header.next_id = record.id + 1;
+    }
+    fclose(fp);
+    if (writeRecordHeader(out, PRODUCTRECORDS ".tmp", &header) != 0 || fclose(heap) != 0 || fclose(out) != 0
+        || rename(PRODUCTRECORDS ".tmp", PRODUCTRECORDS) != 0) { // the records file only appears once complete
+        fprintf(stderr, "CANNOT CONVERT %s FILE.\n", LEGACYPRODUCTRECORDS);
+        return -1;
+    }
+    return 0;
+}
+/**
+ * @brief Convert the fixed-size Teller records of older versions to the teller records and string heap
+ * Streams one legacy record at a time so memory use does not depend on the count of tellers
+ * 
+ * @return int 0 - success | -1 error
+ */
+int convertLegacyTellers(void) {
+    FILE * fp, * out, * heap;
+    Teller legacy;
+    TellerRecord record;
+    RecordFileHeader header;
+    const char * strings[3];
+    int k, * offsets = &record.first_name;
+    long offset = 0;
+    unsigned short len;
+    if ((fp = fopen(LEGACYTELLERRECORDS, "rb")) == NULL)
+        return -1;
+    out = fopen(TELLERRECORDS ".tmp", "wb");
+    heap = fopen(TELLERSTRINGS, "wb");
+    if (out == NULL || heap == NULL) {
+        fclose(fp);
+        if (out != NULL) fclose(out);
+        if (heap != NULL) fclose(heap);
+        fprintf(stderr, "CANNOT CONVERT %s FILE.\n", LEGACYTELLERRECORDS);
+        return -1;
+    }
+    initRecordHeader(&header, sizeof(record));
+    fwrite(&header, sizeof(header), 1, out); // placeholder, the header is rewritten once the records are converted
+    while (fread(&legacy, sizeof(Teller), 1, fp) == 1) {
+        memset(&record, 0, sizeof(record));
+        record.id = legacy.id;
+        strings[0] = legacy.first_name;
+        strings[1] = legacy.middle_name;
+        strings[2] = legacy.last_name;
+        for (k = 0; k < 3; k++) {
+            len = (unsigned short)strnlen(strings[k], MAX_NAME - 1);
+            fwrite(&len, sizeof(len), 1, heap);
+            fwrite(strings[k], 1, len, heap);
+            fputc(0, heap);
+            offsets[k] = (int)offset;
+            offset += sizeof(len) + len + 1;
+        }
+        fwrite(&record, sizeof(record), 1, out);
+        header.count++;
+        if (record.id >= header.next_id)
+            header.next_id = record.id + 1;
+    }
+    fclose(fp);
+    if (writeRecordHeader(out, TELLERRECORDS ".tmp", &header) != 0 || fclose(heap) != 0 || fclose(out) != 0
+        || rename(TELLERRECORDS ".tmp", TELLERRECORDS) != 0) { // the records file only appears once complete
+        fprintf(stderr, "CANNOT CONVERT %s FILE.\n", LEGACYTELLERRECORDS);
+        return -1;
+    }
+    return 0;
+}
+/**
+ * @brief Convert the sale transactions with a full Product copy of older versions to the undated sale segment
+ * Streams one legacy record at a time. The old records have no date, so they all go to the undated
+ * segment (month 0), with their amounts converted to cents and an unknown product version (0). The
+ * segment catalog is written last, so an interrupted conversion is redone
+ * 
+ * @return int 0 - success | -1 error
+ */
+int convertLegacySales(void) {
+    FILE * fp, * out;
+    LegacySaleTransaction legacy;
+    SaleTransaction sale;
+    SaleSegment segment;
+    RecordFileHeader header;
+    char filename[MAX_NAME], tempname[MAX_NAME];
+    int next_id = 1;
+    if ((fp = fopen(LEGACYSALERECORDS, "rb")) == NULL)
+        return -1;
+    saleSegmentName(filename, SALESEGMENT, 0);
+    if (snprintf(tempname, sizeof(tempname), "%s.tmp", filename) >= (int)sizeof(tempname) || (out = fopen(tempname, "wb")) == NULL) {
+        fclose(fp);
+        fprintf(stderr, "CANNOT CONVERT %s FILE.\n", LEGACYSALERECORDS);
+        return -1;
+    }
+    memset(&segment, 0, sizeof(segment));
+    initRecordHeader(&header, sizeof(sale));
+    fwrite(&header, sizeof(header), 1, out); // placeholder, the header is rewritten once the records are converted
+    while (fread(&legacy, sizeof(LegacySaleTransaction), 1, fp) == 1) {
+        if (legacy.id >= next_id)
+            next_id = legacy.id + 1; // the IDs of the deleted sales are not reused either
+        if (legacy.id == DELETED_ID)
+            continue;
+        memset(&sale, 0, sizeof(sale));
+        sale.id = legacy.id;
+        sale.product_id = legacy.product.id;
+        sale.product_version = 0;
+        sale.unit_price = floatToCents(legacy.product.unit_price);
+        sale.quantity = legacy.quantity;
+        fwrite(&sale, sizeof(sale), 1, out);
+        if (segment.count == 0 || sale.id < segment.min_id)
+            segment.min_id = sale.id;
+        if (segment.count == 0 || sale.id > segment.max_id)
+            segment.max_id = sale.id;
+        segment.count++;
+        header.count++;
+        if (sale.id >= header.next_id)
+            header.next_id = sale.id + 1;
+    }
+    fclose(fp);
+    if (writeRecordHeader(out, tempname, &header) != 0 || fclose(out) != 0 || rename(tempname, filename) != 0) {
+        fprintf(stderr, "CANNOT CONVERT %s FILE.\n", LEGACYSALERECORDS);
+        return -1;
+    }
+    if ((out = fopen(SALESEGMENTS ".tmp", "wb")) == NULL) {
+        fprintf(stderr, "CANNOT CONVERT %s FILE.\n", LEGACYSALERECORDS);
+        return -1;
+    }
+    initRecordHeader(&header, sizeof(segment));
+    header.next_id = next_id;
+    fwrite(&header, sizeof(header), 1, out); // placeholder, the header is rewritten with the count of segments
+    if (segment.count > 0) {
+        header.count = 1;
+        fwrite(&segment, sizeof(segment), 1, out);
+    }
+    if (writeRecordHeader(out, SALESEGMENTS ".tmp", &header) != 0 || fclose(out) != 0 || rename(SALESEGMENTS ".tmp", SALESEGMENTS) != 0) { // the segment catalog only appears once the conversion is complete
+        fprintf(stderr, "CANNOT CONVERT %s FILE.\n", LEGACYSALERECORDS);
+        return -1;
+    }
+    return 0;
+}
+/**
+ * @brief Get the filename of a sale segment of a month
+ * 
+ * @param filename buffer of at least MAX_NAME characters
+ * @param format SALESEGMENT | SALEHEADERSEGMENT
+ * @param month month as YYYYMM; 0 for the undated segment
+ */
+void saleSegmentName(char * filename, const char * format, int month) {
+    char name[TIME_SIZE];
+    sprintf(name, "%04d-%02d", month / 100, month % 100);
+    sprintf(filename, format, name);
+}
+/**
+ * @brief Append one checkout to the sale segments of its month: its line items, then its header
+ * The segment catalog is locked first, so the appends to the segments are serialized and its entry
+ * (ID and time ranges), the sale aggregates and the stock are updated in the same transaction as the new records
+ * 
+ * @param sale sale header; its first_item and item_count are set to the appended line items
+ * @param sales line items, sold at the time of the sale header
+ * @param count count of line items
+ * @return int 0 - success | -1 error
+ */
+int appendSales(SaleHeader * sale, const SaleTransaction * sales, int count) {
+    FILE * fp;
+    RecordFileHeader header;
+    SaleSegment segment;
+    char filename[MAX_NAME], headername[MAX_NAME];
+    time_t t = (time_t)sale->timestamp;
+    struct tm * tmp = localtime(&t);
+    int i, slot, month = (tmp->tm_year + 1900) * 100 + tmp->tm_mon + 1;
+    if ((fp = openRecordFile(SALESEGMENTS, sizeof(SaleSegment), &header)) == NULL)
+        return -1;
+    for (slot = 0; slot < header.count; slot++) { // the catalog only has one entry per month
+        if (fread(&segment, sizeof(segment), 1, fp) != 1) {
+            abortTransaction();
+            return -1;
+        }
+        if (segment.month == month)
+            break;
+    }
+    if (slot >= header.count) { // first sale of the month
+        memset(&segment, 0, sizeof(segment));
+        segment.month = month;
+        segment.min_id = sale->id;
+        segment.max_id = sale->id;
+        segment.min_time = sale->timestamp;
+        segment.max_time = sale->timestamp;
+        header.count++;
+        slot = header.count - 1;
+    }
+    saleSegmentName(filename, SALESEGMENT, month);
+    saleSegmentName(headername, SALEHEADERSEGMENT, month);
+    if ((!fileExists(filename) && initRecordFile(filename, sizeof(SaleTransaction)) != 0)
+        || (!fileExists(headername) && initRecordFile(headername, sizeof(SaleHeader)) != 0)
+        || (sale->first_item = appendRecords(filename, sizeof(SaleTransaction), sales, count)) < 0) {
+        abortTransaction();
+        return -1;
+    }
+    sale->item_count = count;
+    if (appendRecords(headername, sizeof(SaleHeader), sale, 1) < 0 || updateSaleAggregates(sale, sales, count) != 0
+        || updateSaleStock(sales, count) != 0) {
+        abortTransaction();
+        return -1;
+    }
+    if (sale->id < segment.min_id) segment.min_id = sale->id;
+    if (sale->id > segment.max_id) segment.max_id = sale->id;
+    for (i = 0; i < count; i++) {
+        if (sales[i].id < segment.min_id) segment.min_id = sales[i].id;
+        if (sales[i].id > segment.max_id) segment.max_id = sales[i].id;
+    }
+    if (sale->timestamp < segment.min_time) segment.min_time = sale->timestamp;
+    if (sale->timestamp > segment.max_time) segment.max_time = sale->timestamp;
+    segment.count += count;
+    if (writeToFileAt(SALESEGMENTS, (long)sizeof(RecordFileHeader) + (long)slot * sizeof(SaleSegment), &segment, sizeof(segment)) != 0) {
+        abortTransaction();
+        return -1;
+    }
+    return closeRecordFile(SALESEGMENTS, &header, 1);
+}
+/**
+ * @brief Find the sale segments having sales in a time range, from the segment catalog only
+ * 
+ * @param from start of the range in seconds since the epoch; 0 to include the undated sales
+ * @param to end of the range (inclusive)
+ * @param count count of the segments found
+ * @return SaleSegment* segments sorted by month, allocated from the record arena; NULL if none
+ */
+SaleSegment * findSaleSegments(long long from, long long to, int * count) {
+    int i, j, total = refreshRecordView(&saleSegmentView);
+    const SaleSegment * segments = saleSegmentView.base;
+    SaleSegment * found, swap;
+    *count = 0;
+    if (total < 1 || (found = arenaAlloc(&recordArena, total * sizeof(SaleSegment))) == NULL)
+        return NULL;
+    for (i = 0; i < total; i++) {
+        if (segments[i].max_time >= from && segments[i].min_time <= to) // prune the segments not overlapping the range
+            found[(*count)++] = segments[i];
+    }
+    for (i = 1; i < *count; i++) { // the catalog is in order of the first sale of each month, only the undated segment may be out of order
+        for (j = i; j > 0 && found[j - 1].month > found[j].month; j--) {
+            swap = found[j];
+            found[j] = found[j - 1];
+            found[j - 1] = swap;
+        }
+    }
+    return found;
+}
+/**
+ * @brief Open a cursor over the sales of a time range, positioned before the first sale
+ * Only the segment catalog is read here, the segments are mapped one at a time as the cursor moves
+ * 
+ * @param cursor sale cursor buffer
+ * @param from start of the range in seconds since the epoch; 0 to include the undated sales
+ * @param to end of the range (inclusive)
+ * @param product_id only the sales of this product; 0 for all the sales
+ * @return int count of segments in the range
+ */
+int openSaleCursor(SaleCursor * cursor, long long from, long long to, int product_id) {
+    memset(cursor, 0, sizeof(SaleCursor));
+    cursor->view.filename = cursor->filename;
+    cursor->view.recordsize = sizeof(SaleTransaction);
+    cursor->view.headersize = sizeof(RecordFileHeader);
+    cursor->view.magic = RECORD_MAGIC;
+    cursor->mapped = -1;
+    cursor->from = from;
+    cursor->to = to;
+    cursor->product_id = product_id;
+    cursor->segments = findSaleSegments(from, to, &cursor->segmentCount);
+    return cursor->segmentCount;
+}
+/**
+ * @brief Unmap the segment of a sale cursor
+ * 
+ * @param cursor sale cursor
+ */
+void closeSaleCursor(SaleCursor * cursor) {
+    closeRecordView(&cursor->view);
+    cursor->mapped = -1;
+}
+/**
+ * @brief Map a segment of a sale cursor, unmapping the segment mapped before
+ * 
+ * @param cursor sale cursor
+ * @param segment index of the segment in cursor->segments
+ * @return int count of sales in the segment
+ */
+int mapSaleSegment(SaleCursor * cursor, int segment) {
+    if (cursor->mapped != segment) {
+        closeSaleCursor(cursor);
+        saleSegmentName(cursor->filename, SALESEGMENT, cursor->segments[segment].month);
+        cursor->mapped = segment;
+    }
+    return refreshRecordView(&cursor->view);
+}
+/**
+ * @brief Check if a sale is one the cursor is filtered for
+ * 
+ * @param cursor sale cursor
+ * @param sale sale line item
+ * @return int 1 - matches | 0 - skipped
+ */
+int saleMatches(const SaleCursor * cursor, const SaleTransaction * sale) {
+    return sale->id != DELETED_ID && sale->timestamp >= cursor->from && sale->timestamp <= cursor->to
+        && (cursor->product_id == 0 || sale->product_id == cursor->product_id);
+}
+/**
+ * @brief Read the next matching sale after the cursor and move the cursor past it
+ * 
+ * @param cursor sale cursor
+ * @param sale buffer of the sale
+ * @return int 1 - read | 0 - no more sales
+ */
+int nextSale(SaleCursor * cursor, SaleTransaction * sale) {
+    const SaleTransaction * sales;
+    int count;
+    for (; cursor->segment < cursor->segmentCount; cursor->segment++, cursor->slot = 0) {
+        count = mapSaleSegment(cursor, cursor->segment);
+        sales = cursor->view.base;
+        for (; cursor->slot < count; cursor->slot++) {
+            if (saleMatches(cursor, &sales[cursor->slot])) {
+                *sale = sales[cursor->slot++];
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+/**
+ * @brief Read the previous matching sale before the cursor and move the cursor back to it
+ * 
+ * @param cursor sale cursor
+ * @param sale buffer of the sale
+ * @return int 1 - read | 0 - no sale before the cursor
+ */
+int prevSale(SaleCursor * cursor, SaleTransaction * sale) {
+    const SaleTransaction * sales;
+    int segment, slot, count;
+    slot = cursor->segment < cursor->segmentCount ? cursor->slot : -1; // past the last segment, from the end of the last one
+    segment = cursor->segment < cursor->segmentCount ? cursor->segment : cursor->segmentCount - 1;
+    for (; segment >= 0; segment--, slot = -1) {
+        count = mapSaleSegment(cursor, segment);
+        if (slot < 0 || slot > count)
+            slot = count; // from the end of the segment
+        sales = cursor->view.base;
+        while (--slot >= 0) {
+            if (saleMatches(cursor, &sales[slot])) {
+                *sale = sales[slot];
+                cursor->segment = segment;
+                cursor->slot = slot;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+/**
+ * @brief Move a sale cursor before the first sale with an ID of at least id
+ * The sale IDs grow from one segment to the next, so only the segment whose ID range holds the ID is read
+ * 
+ * @param cursor sale cursor
+ * @param id sale ID
+ * @return int 1 - found | 0 - no sale with such an ID, the cursor is left as is
+ */
+int seekSale(SaleCursor * cursor, int id) {
+    const SaleTransaction * sales;
+    int segment, slot, count;
+    for (segment = 0; segment < cursor->segmentCount && cursor->segments[segment].max_id < id; segment++)
+        ;
+    for (; segment < cursor->segmentCount; segment++) {
+        count = mapSaleSegment(cursor, segment);
+        sales = cursor->view.base;
+        for (slot = 0; slot < count; slot++) {
+            if (sales[slot].id >= id && saleMatches(cursor, &sales[slot])) {
+                cursor->segment = segment;
+                cursor->slot = slot;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+/**
+ * @brief Compute an aggregate over the sale line items of a time range on a pool of worker threads
+ * The segments overlapping the range are mapped and split into chunks of SCAN_CHUNK line items. Each
+ * worker takes the next chunk until none is left and aggregates it into its own partial aggregate, so
+ * the workers only share the chunk counter. The partial aggregates are merged once all workers are done
+ * 
+ * @param from start of the range in seconds since the epoch; 0 to include the undated sales
+ * @param to end of the range (inclusive)
+ * @param scanner aggregate computed, its scan function skips the line items outside of the range
+ * @param total aggregate of scanner->partialSize bytes, zeroed by the caller
+ * @return int count of line items scanned | -1 error
+ */
+int scanSales(long long from, long long to, const SaleScanner * scanner, void * total) {
+    SaleSegment * segments;
+    RecordView * views;
+    char (* filenames)[MAX_NAME];
+    ScanChunk * chunks = NULL;
+    ScanWorker * workers;
+    SaleScan scan;
+    char * partials, * aligned;
+    size_t stride = (scanner->partialSize + SCAN_ALIGN - 1) & ~(size_t)(SCAN_ALIGN - 1); // each partial aggregate on its own cache lines
+    int i, k, n, segmentCount, started, chunkCount = 0, workerCount = 1, scanned = 0;
+    if ((segments = findSaleSegments(from, to, &segmentCount)) == NULL)
+        return 0; // no sales in the range
+    views = arenaAlloc(&recordArena, segmentCount * sizeof(RecordView));
+    filenames = arenaAlloc(&recordArena, segmentCount * sizeof(* filenames));
+    if (views == NULL || filenames == NULL)
+        return -1;
+    for (i = 0; i < segmentCount; i++) { // all segments of the range are mapped for the whole scan
+        memset(&views[i], 0, sizeof(RecordView));
+        saleSegmentName(filenames[i], SALESEGMENT, segments[i].month);
+        views[i].filename = filenames[i];
+        views[i].recordsize = sizeof(SaleTransaction);
+        views[i].headersize = sizeof(RecordFileHeader);
+        views[i].magic = RECORD_MAGIC;
+        n = refreshRecordView(&views[i]);
+        chunkCount += (n + SCAN_CHUNK - 1) / SCAN_CHUNK;
+    }
+    if (chunkCount > 0 && (chunks = arenaAlloc(&recordArena, chunkCount * sizeof(ScanChunk))) == NULL)
+        chunkCount = scanned = -1;
+    for (i = 0, k = 0; i < segmentCount && chunks != NULL; i++) {
+        for (n = 0; n < views[i].count; n += SCAN_CHUNK, k++) { // the last chunk of a segment may be shorter
+            chunks[k].sales = (const SaleTransaction *)views[i].base + n;
+            chunks[k].count = views[i].count - n < SCAN_CHUNK ? views[i].count - n : SCAN_CHUNK;
+            scanned += chunks[k].count;
+        }
+    }
+#ifdef __linux__
+    workerCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (workerCount > SCAN_MAX_THREADS)
+        workerCount = SCAN_MAX_THREADS;
+    if (workerCount > chunkCount)
+        workerCount = chunkCount; // no idle worker
+    if (workerCount < 1
+        || (workers = arenaAlloc(&recordArena, workerCount * sizeof(ScanWorker))) == NULL
+        || (partials = calloc(1, stride * workerCount + SCAN_ALIGN)) == NULL) {
+        for (i = 0; i < segmentCount; i++)
+            closeRecordView(&views[i]);
+        return chunkCount < 0 ? -1 : scanned;
+    }
+    aligned = partials + (SCAN_ALIGN - (size_t)partials % SCAN_ALIGN) % SCAN_ALIGN;
+    scan.scanner = scanner;
+    scan.chunks = chunks;
+    scan.chunkCount = chunkCount;
+#ifdef __linux__
+    atomic_init(&scan.next, 0);
+#else
+    scan.next = 0;
+#endif
+    for (k = 0; k < workerCount; k++) {
+        workers[k].scan = &scan;
+        workers[k].partial = aligned + (size_t)k * stride;
+    }
+    started = 1; // the calling thread is the first worker
+#ifdef __linux__
+    for (; started < workerCount; started++) {
+        if (pthread_create(&workers[started].thread, NULL, scanWorker, &workers[started]) != 0)
+            break; // the chunks are shared by the workers which started
+    }
+#endif
+    scanWorker(&workers[0]);
+#ifdef __linux__
+    for (k = 1; k < started; k++)
+        pthread_join(workers[k].thread, NULL);
+#endif
+    for (k = 0; k < started; k++)
+        scanner->merge(total, workers[k].partial, scanner->context);
+    free(partials);
+    for (i = 0; i < segmentCount; i++)
+        closeRecordView(&views[i]);
+    return scanned;
+}
+/**
+ * @brief Scan worker: aggregate the next chunk of the scan into the partial aggregate of the worker until no chunk is left
+ * 
+ * @param arg ScanWorker
+ * @return void* NULL
+ */
+void * scanWorker(void * arg) {
+    ScanWorker * worker = arg;
+    SaleScan * scan = worker->scan;
+    int chunk;
+#ifdef __linux__
+    while ((chunk = atomic_fetch_add_explicit(&scan->next, 1, memory_order_relaxed)) < scan->chunkCount)
+#else
+    while ((chunk = scan->next++) < scan->chunkCount)
+#endif
+        scan->scanner->scan(worker->partial, scan->chunks[chunk].sales, scan->chunks[chunk].count, scan->scanner->context);
+    return NULL;
+}
+/**
+ * @brief Add the revenue of the line items of a chunk to the totals of their product IDs
+ * 
+ * @param partial RevenueTotal of each product ID
+ * @param sales line items
+ * @param count count of line items
+ * @param context RevenueReport
+ */
+void scanProductRevenue(void * partial, const SaleTransaction * sales, int count, const void * context) {
+    const RevenueReport * report = context;
+    RevenueTotal * totals = partial;
+    int i;
+    for (i = 0; i < count; i++) {
+        if (sales[i].id == DELETED_ID || sales[i].timestamp < report->from || sales[i].timestamp > report->to
+            || sales[i].product_id < 0 || sales[i].product_id >= report->keyCount)
+            continue;
+        totals[sales[i].product_id].revenue += sales[i].unit_price * sales[i].quantity;
+        totals[sales[i].product_id].quantity += sales[i].quantity;
+    }
+}
+/**
+ * @brief Add the revenue of the line items of a chunk to the totals of the categories of their products
+ * 
+ * @param partial RevenueTotal of each category
+ * @param sales line items
+ * @param count count of line items
+ * @param context RevenueReport with the category of each product ID
+ */
+void scanCategoryRevenue(void * partial, const SaleTransaction * sales, int count, const void * context) {
+    const RevenueReport * report = context;
+    RevenueTotal * totals = partial;
+    int i, category;
+    for (i = 0; i < count; i++) {
+        if (sales[i].id == DELETED_ID || sales[i].timestamp < report->from || sales[i].timestamp > report->to)
+            continue;
+        category = sales[i].product_id >= 0 && sales[i].product_id < report->productCount ? report->categories[sales[i].product_id] : 0;
+        totals[category].revenue += sales[i].unit_price * sales[i].quantity;
+        totals[category].quantity += sales[i].quantity;
+    }
+}
+/**
+ * @brief Add the revenue of the line items of a chunk to the totals of their days
+ * The day is estimated by dividing by the length of a day, then corrected by at most one day
+ * where a daylight saving change makes a day shorter or longer
+ * 
+ * @param partial RevenueTotal of each day
+ * @param sales line items
+ * @param count count of line items
+ * @param context RevenueReport with the start of each day
+ */
+void scanDailyRevenue(void * partial, const SaleTransaction * sales, int count, const void * context) {
+    const RevenueReport * report = context;
+    RevenueTotal * totals = partial;
+    long long t;
+    int i, day;
+    for (i = 0; i < count; i++) {
+        t = sales[i].timestamp;
+        if (sales[i].id == DELETED_ID || t < report->days[0] || t >= report->days[report->keyCount] || t < report->from || t > report->to)
+            continue; // also the undated sales, they have no day
+        day = (int)((t - report->days[0]) / SECONDS_PER_DAY);
+        if (day >= report->keyCount)
+            day = report->keyCount - 1;
+        while (day > 0 && t < report->days[day])
+            day--;
+        while (t >= report->days[day + 1])
+            day++;
+        totals[day].revenue += sales[i].unit_price * sales[i].quantity;
+        totals[day].quantity += sales[i].quantity;
+    }
+}
+/**
+ * @brief Add the partial revenue totals of a worker to the totals of the report
+ * 
+ * @param total RevenueTotal of each key
+ * @param partial RevenueTotal of each key of one worker
+ * @param context RevenueReport
+ */
+void mergeRevenue(void * total, const void * partial, const void * context) {
+    const RevenueReport * report = context;
+    RevenueTotal * totals = total;
+    const RevenueTotal * partials = partial;
+    int i;
+    for (i = 0; i < report->keyCount; i++) {
+        totals[i].revenue += partials[i].revenue;
+        totals[i].quantity += partials[i].quantity;
+    }
+}
+/**
+ * @brief Get the local time of the start of the day of a time
+ * 
+ * @param t seconds since the epoch
+ * @return long long seconds since the epoch of the midnight starting the day
+ */
+long long startOfDay(long long t) {
+    time_t time = (time_t)t;
+    struct tm date = * localtime(&time);
+    date.tm_hour = 0;
+    date.tm_min = 0;
+    date.tm_sec = 0;
+    date.tm_isdst = -1; // the midnight may not have the daylight saving time of t
+    return (long long)mktime(&date);
+}
+/**
+ * @brief Parse a date as YYYY-MM-DD to a local time
+ * 
+ * @param text date
+ * @param endOfDay 0 - start of the day | 1 - last second of the day
+ * @return long long seconds since the epoch; -1 if not a valid date
+ */
+long long parseDate(const char * text, int endOfDay) {
+    struct tm date;
+    int year, month, day;
+    char extra;
+    time_t t;
+    if (sscanf(text, "%d-%d-%d%c", &year, &month, &day, &extra) != 3 || month < 1 || month > 12 || day < 1 || day > 31)
+        return -1;
+    memset(&date, 0, sizeof(date));
+    date.tm_year = year - 1900;
+    date.tm_mon = month - 1;
+    date.tm_mday = day + (endOfDay ? 1 : 0); // mktime() normalizes the day after the end of the month
+    date.tm_isdst = -1;
+    if ((t = mktime(&date)) == (time_t)-1)
+        return -1;
+    return (long long)t - (endOfDay ? 1 : 0);
+}
+/**
+ * @brief Get the local date of a time
+ * The hour of the last call is kept, as localtime() checks the time zone file on every call and the
+ * times of a rebuild or of the checkouts mostly fall in the same hour. Not thread safe, as localtime()
+ * 
+ * @param t seconds since the epoch
+ * @param hour buffer of the hour of the day (0-23); NULL if not needed
+ * @return int local date as YYYYMMDD
+ */
+int localDay(long long t, int * hour) {
+    static long long start = 0, end = 0; // hour of the last call, end excluded
+    static int lastDay, lastHour;
+    time_t time;
+    struct tm * date;
+    if (t < start || t >= end) {
+        time = (time_t)t;
+        date = localtime(&time);
+        lastDay = (date->tm_year + 1900) * 10000 + (date->tm_mon + 1) * 100 + date->tm_mday;
+        lastHour = date->tm_hour;
+        start = t - date->tm_min * 60 - date->tm_sec;
+        end = start + 3600;
+    }
+    if (hour != NULL)
+        *hour = lastHour;
+    return lastDay;
+}
+/**
+ * @brief Hash the key of a sale aggregate to the first table slot to probe
+ * 
+ * @param kind AGGREGATE_PRODUCT | AGGREGATE_DAY | AGGREGATE_HOUR | AGGREGATE_TELLER
+ * @param key product ID | 0 | hour of the day | teller ID
+ * @param day local date as YYYYMMDD; 0 for a product
+ * @return unsigned int hash, masked by the caller to the count of slots
+ */
+unsigned int hashAggregate(int kind, int key, int day) {
+    return hashID(key ^ (int)hashID(day * 8 + kind));
+}
+/**
+ * @brief Add totals to the aggregate of a key in an in-memory set, growing the set by doubling
+ * 
+ * @param set aggregate hash set
+ * @param kind AGGREGATE_PRODUCT | AGGREGATE_DAY | AGGREGATE_HOUR | AGGREGATE_TELLER
+ * @param key product ID | 0 | hour of the day | teller ID
+ * @param day local date as YYYYMMDD; 0 for a product
+ * @param count count of checkouts (line items for a product) added
+ * @param quantity units added
+ * @param revenue revenue added in cents
+ * @return int 0 - success | -1 not enough memory
+ */
+int addAggregate(AggregateSet * set, int kind, int key, int day, int count, long long quantity, long long revenue) {
+    SaleAggregate * entries, * entry;
+    int capacity, k;
+    unsigned int mask, i;
+    if ((set->used + 1) * 4 > set->capacity * 3) {
+        capacity = set->capacity > 0 ? set->capacity * 2 : INDEX_MIN_CAPACITY;
+        if ((entries = calloc(capacity, sizeof(SaleAggregate))) == NULL) // calloc zeroes the slots to EMPTY_ID
+            return -1;
+        mask = (unsigned int)capacity - 1;
+        for (k = 0; k < set->capacity; k++) {
+            if (set->entries[k].kind == EMPTY_ID)
+                continue;
+            for (i = hashAggregate(set->entries[k].kind, set->entries[k].key, set->entries[k].day) & mask; entries[i].kind != EMPTY_ID; i = (i + 1) & mask)
+                ;
+            entries[i] = set->entries[k];
+        }
+        free(set->entries);
+        set->entries = entries;
+        set->capacity = capacity;
+    }
+    mask = (unsigned int)set->capacity - 1;
+    for (i = hashAggregate(kind, key, day) & mask; set->entries[i].kind != EMPTY_ID; i = (i + 1) & mask) {
+        if (set->entries[i].kind == kind && set->entries[i].key == key && set->entries[i].day == day)
+            break;
+    }
+    entry = &set->entries[i];
+    if (entry->kind == EMPTY_ID) {
+        entry->kind = kind;
+        entry->key = key;
+        entry->day = day;
+        set->used++;
+    }
+    entry->count += count;
+    entry->quantity += quantity;
+    entry->revenue += revenue;
+    return 0;
+}
+/**
+ * @brief Add the line items of a checkout to in-memory aggregates: per product, and per day, hour and teller of the checkout
+ * 
+ * @param set aggregate hash set
+ * @param sale header of the checkout; NULL for line items without a header, only dated by their own time
+ * @param sales line items
+ * @param count count of line items
+ * @return int 0 - success | -1 not enough memory
+ */
+int addSaleAggregates(AggregateSet * set, const SaleHeader * sale, const SaleTransaction * sales, int count) {
+    long long quantity = 0, revenue = 0, amount;
+    int i, day, hour;
+    for (i = 0; i < count; i++) {
+        if (sales[i].id == DELETED_ID)
+            continue;
+        amount = sales[i].unit_price * sales[i].quantity;
+        quantity += sales[i].quantity;
+        revenue += amount;
+        if (addAggregate(set, AGGREGATE_PRODUCT, sales[i].product_id, 0, 1, sales[i].quantity, amount) != 0)
+            return -1;
+        if (sale != NULL || sales[i].timestamp == 0)
+            continue; // the undated sales of older versions only count for their product
+        day = localDay(sales[i].timestamp, &hour);
+        if (addAggregate(set, AGGREGATE_DAY, 0, day, 0, sales[i].quantity, amount) != 0
+            || addAggregate(set, AGGREGATE_HOUR, hour, day, 0, sales[i].quantity, amount) != 0)
+            return -1;
+    }
+    if (sale == NULL)
+        return 0;
+    day = localDay(sale->timestamp, &hour);
+    if (addAggregate(set, AGGREGATE_DAY, 0, day, 1, quantity, revenue) != 0
+        || addAggregate(set, AGGREGATE_HOUR, hour, day, 1, quantity, revenue) != 0
+        || addAggregate(set, AGGREGATE_TELLER, sale->teller_id, day, 1, quantity, revenue) != 0)
+        return -1;
+    return 0;
+}
+/**
+ * @brief Find the running totals of a key in the sale aggregates file by linear probing
+ * The view of the file is refreshed once by the caller, not on every lookup
+ * 
+ * @param kind AGGREGATE_PRODUCT | AGGREGATE_DAY | AGGREGATE_HOUR | AGGREGATE_TELLER
+ * @param key product ID | 0 | hour of the day | teller ID
+ * @param day local date as YYYYMMDD; 0 for a product
+ * @return const SaleAggregate* the aggregate in the file view; NULL if nothing was sold for the key
+ */
+const SaleAggregate * findAggregate(int kind, int key, int day) {
+    const SaleAggregate * entries;
+    unsigned int mask, i;
+    int probes;
+    if (saleAggregateView.count == 0)
+        return NULL;
+    entries = saleAggregateView.base;
+    mask = (unsigned int)saleAggregateView.count - 1; // the count of slots is a power of 2
+    for (i = hashAggregate(kind, key, day) & mask, probes = 0; probes < saleAggregateView.count; i = (i + 1) & mask, probes++) {
+        if (entries[i].kind == EMPTY_ID)
+            return NULL;
+        if (entries[i].kind == kind && entries[i].key == key && entries[i].day == day)
+            return &entries[i];
+    }
+    return NULL;
+}
+/**
+ * @brief Order sale aggregates by key (qsort comparator)
+ * 
+ * @param a SaleAggregate
+ * @param b SaleAggregate
+ * @return int negative, 0 or positive as a is before, the same as or after b
+ */
+int compareAggregateKeys(const void * a, const void * b) {
+    const SaleAggregate * x = a, * y = b;
+    return x->key < y->key ? -1 : x->key > y->key;
+}
+/**
+ * @brief Add a checkout to the sale aggregates file as part of the open transaction, so the totals
+ * are committed with the sale. The caller holds the lock of the sale segment catalog, so no other lane
+ * updates the aggregates meanwhile. The file is grown to twice its slots first if the new aggregates
+ * would fill more than 3/4 of them
+ * 
+ * @param sale header of the checkout
+ * @param sales line items
+ * @param count count of line items
+ * @return int 0 - success | -1 error
+ */
+int updateSaleAggregates(const SaleHeader * sale, const SaleTransaction * sales, int count) {
+    AggregateSet deltas = { NULL, 0, 0 };
+    IdSet claimed = { NULL, 0, 0 }; // slots taken by the new aggregates, not yet seen through the view
+    AggregateFileHeader header;
+    const SaleAggregate * entries, * found;
+    SaleAggregate entry;
+    unsigned int mask, i;
+    int k, capacity, added = 0, result = 0;
+    if (refreshRecordView(&saleAggregateView) == 0)
+        return 0; // no aggregates, they are rebuilt at the next start
+    if (addSaleAggregates(&deltas, sale, sales, count) != 0) {
+        free(deltas.entries);
+        return -1;
+    }
+    for (k = 0; k < deltas.capacity; k++)
+        if (deltas.entries[k].kind != EMPTY_ID && findAggregate(deltas.entries[k].kind, deltas.entries[k].key, deltas.entries[k].day) == NULL)
+            added++;
+    memcpy(&header, saleAggregateView.map, sizeof(header));
+    if ((header.used + added) * 4 > header.count * 3) {
+        for (capacity = header.count * 2; (header.used + added) * 4 > capacity * 3; capacity *= 2)
+            ;
+        if (0 != writeAggregateFile(saleAggregateView.base, saleAggregateView.count, capacity, header.items) || refreshRecordView(&saleAggregateView) == 0) {
+            free(deltas.entries);
+            return -1;
+        }
+        memcpy(&header, saleAggregateView.map, sizeof(header));
+    }
+    entries = saleAggregateView.base;
+    mask = (unsigned int)saleAggregateView.count - 1;
+    for (k = 0; k < deltas.capacity && result == 0; k++) {
+        if (deltas.entries[k].kind == EMPTY_ID)
+            continue;
+        entry = deltas.entries[k];
+        if ((found = findAggregate(entry.kind, entry.key, entry.day)) != NULL) {
+            i = (unsigned int)(found - entries);
+            entry.count += found->count;
+            entry.quantity += found->quantity;
+            entry.revenue += found->revenue;
+        }
+        else {
+            for (i = hashAggregate(entry.kind, entry.key, entry.day) & mask; entries[i].kind != EMPTY_ID; i = (i + 1) & mask)
+                ;
+            while ((result = addID(&claimed, (int)i + 1)) == 0) { // slot IDs start at 1, EMPTY_ID is 0
+                for (i = (i + 1) & mask; entries[i].kind != EMPTY_ID; i = (i + 1) & mask)
+                    ;
+            }
+            if (result < 0)
+                break;
+            result = 0;
+            header.used++;
+        }
+        result = writeToFileAt(SALEAGGREGATES, (long)sizeof(AggregateFileHeader) + (long)i * sizeof(SaleAggregate), &entry, sizeof(entry));
+    }
+    free(deltas.entries);
+    free(claimed.ids);
+    if (result != 0)
+        return -1;
+    header.items += count;
+    header.checksum = fnv1a(&header, offsetof(AggregateFileHeader, checksum));
+    return writeToFileAt(SALEAGGREGATES, 0, &header, sizeof(header));
+}
+/**
+ * @brief Write a new sale aggregates file from aggregates
+ * The file is written aside then replaces the old one, so the log is checkpointed first as its
+ * frames refer to the slots of the old file
+ * 
+ * @param entries aggregates, the empty slots (kind EMPTY_ID) are skipped
+ * @param count count of entries
+ * @param capacity count of slots of the new file, a power of 2
+ * @param items count of sale line items added up in the aggregates
+ * @return int 0 - success | -1 error
+ */
+int writeAggregateFile(const SaleAggregate * entries, int count, int capacity, long long items) {
+    FILE * fp;
+    AggregateFileHeader header;
+    SaleAggregate * table;
+    char tempname[MAX_NAME];
+    unsigned int mask = (unsigned int)capacity - 1, i;
+    int k, result = 0;
+    if ((table = calloc(capacity, sizeof(SaleAggregate))) == NULL) // calloc zeroes the slots to EMPTY_ID
+        return -1;
+    memset(&header, 0, sizeof(header));
+    header.magic = AGGREGATE_MAGIC;
+    header.schema_version = SCHEMA_VERSION;
+    header.record_size = sizeof(SaleAggregate);
+    header.count = capacity;
+    header.items = items;
+    for (k = 0; k < count; k++) {
+        if (entries[k].kind == EMPTY_ID)
+            continue;
+        for (i = hashAggregate(entries[k].kind, entries[k].key, entries[k].day) & mask; table[i].kind != EMPTY_ID; i = (i + 1) & mask)
+            ;
+        table[i] = entries[k];
+        header.used++;
+    }
+    header.checksum = fnv1a(&header, offsetof(AggregateFileHeader, checksum));
+    replayLog(0);
+    if (snprintf(tempname, sizeof(tempname), "%s.tmp", SALEAGGREGATES) >= (int)sizeof(tempname) || (fp = fopen(tempname, "wb")) == NULL) {
+        free(table);
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", SALEAGGREGATES);
+        return -1;
+    }
+    if (fwrite(&header, sizeof(header), 1, fp) != 1 || fwrite(table, sizeof(SaleAggregate), capacity, fp) != (size_t)capacity
+        || (wal.durability != DURABILITY_NONE && syncFile(fp) != 0))
+        result = -1;
+    free(table);
+    if (fclose(fp) != 0 || result != 0) {
+        remove(tempname);
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", SALEAGGREGATES);
+        return -1;
+    }
+#ifdef _WIN32
+    remove(SALEAGGREGATES); // rename() does not replace an existing file on Windows
+#endif
+    if (rename(tempname, SALEAGGREGATES) != 0) {
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", SALEAGGREGATES);
+        return -1;
+    }
+    return 0;
+}
+/**
+ * @brief Rebuild the sale aggregates file from the line items and headers of the sale segments
+ * The segment catalog stays locked meanwhile, so no checkout is appended before the new file replaces the old one
+ * 
+ * @return int 0 - success | -1 error
+ */
+int rebuildSaleAggregates(void) {
+    FILE * fp;
+    RecordFileHeader catalog;
+    AggregateSet set = { NULL, 0, 0 };
+    SaleSegment * segments;
+    RecordView items, headers;
+    const SaleTransaction * sales;
+    const SaleHeader * sale;
+    char itemname[MAX_NAME], headername[MAX_NAME];
+    long long total = 0;
+    int i, k, n, next, segmentCount, capacity = INDEX_MIN_CAPACITY, result = 0;
+    if ((fp = openRecordFile(SALESEGMENTS, sizeof(SaleSegment), &catalog)) == NULL)
+        return -1;
+    segments = findSaleSegments(0, LLONG_MAX, &segmentCount);
+    for (i = 0; i < segmentCount && result == 0; i++) {
+        memset(&items, 0, sizeof(RecordView));
+        memset(&headers, 0, sizeof(RecordView));
+        saleSegmentName(itemname, SALESEGMENT, segments[i].month);
+        saleSegmentName(headername, SALEHEADERSEGMENT, segments[i].month);
+        items.filename = itemname;
+        items.recordsize = sizeof(SaleTransaction);
+        items.headersize = sizeof(RecordFileHeader);
+        items.magic = RECORD_MAGIC;
+        headers = items;
+        headers.filename = headername;
+        headers.recordsize = sizeof(SaleHeader);
+        n = fileExists(itemname) ? refreshRecordView(&items) : 0;
+        sales = items.base;
+        next = 0; // first line item not added yet
+        if (fileExists(headername)) { // the sales converted from older versions have no headers
+            refreshRecordView(&headers);
+            for (k = 0, sale = headers.base; k < headers.count && result == 0; k++, sale++) {
+                if (sale->id == DELETED_ID || sale->first_item < next || sale->first_item + sale->item_count > n)
+                    continue; // not the line items of this segment
+                result = addSaleAggregates(&set, NULL, sales + next, sale->first_item - next);
+                if (result == 0)
+                    result = addSaleAggregates(&set, sale, sales + sale->first_item, sale->item_count);
+                next = sale->first_item + sale->item_count;
+            }
+        }
+        if (result == 0)
+            result = addSaleAggregates(&set, NULL, sales + next, n - next);
+        total += segments[i].count;
+        closeRecordView(&items);
+        closeRecordView(&headers);
+    }
+    while (capacity < set.used * 2) // at most half full
+        capacity *= 2;
+    if (result == 0)
+        result = writeAggregateFile(set.entries, set.capacity, capacity, total);
+    free(set.entries);
+    closeRecordView(&saleAggregateView);
+    commitTransaction(0); // releases the lock of the segment catalog, nothing was written to it
+    return result;
+}
+/**
+ * @brief Check that the sale aggregates file exists and counts every line item of the sale segment catalog
+ * 
+ * @return int 0 - up to date | -1 missing or out of date
+ */
+int checkSaleAggregates(void) {
+    AggregateFileHeader header;
+    const SaleSegment * segments;
+    long long total = 0;
+    int i, count;
+    if (!fileExists(SALEAGGREGATES) || refreshRecordView(&saleAggregateView) == 0)
+        return -1;
+    memcpy(&header, saleAggregateView.map, sizeof(header));
+    if (header.checksum != fnv1a(&header, offsetof(AggregateFileHeader, checksum)) || header.schema_version != SCHEMA_VERSION)
+        return -1;
+    count = refreshRecordView(&saleSegmentView);
+    segments = saleSegmentView.base;
+    for (i = 0; i < count; i++)
+        total += segments[i].count;
+    return header.items == total ? 0 : -1;
+}
+/**
+ * @brief Find the stock of a product by ID, read directly from the mapped stock file
+ * The record of a product is in the slot of its ID, so the lookup is one read of the mapping, which
+ * also sees the changes of the other lanes in place. The header in the mapping is current too, so the
+ * stock file is only remapped once its header counts more slots than the mapping
+ * 
+ * @param product_id id of product
+ * @return const StockRecord* stock record in the stock view; NULL if the stock of the product is not tracked
+ */
+const StockRecord * findStock(int product_id) {
+    const StockRecord * records;
+#ifdef __linux__
+    if (stockView.header == NULL || (product_id >= stockView.count && stockView.header->count > stockView.count))
+#endif
+        refreshRecordView(&stockView);
+    records = stockView.base;
+    if (product_id <= 0 || product_id >= stockView.count || records[product_id].product_id != product_id)
+        return NULL;
+    return &records[product_id];
+}
+/**
+ * @brief Order stock changes by product, then by sequence (qsort comparator)
+ * 
+ * @param a StockChange
+ * @param b StockChange
+ * @return int negative, 0 or positive as a is before, the same as or after b
+ */
+int compareStockChanges(const void * a, const void * b) {
+    const StockChange * x = a, * y = b;
+    if (x->product_id != y->product_id)
+        return x->product_id < y->product_id ? -1 : 1;
+    return x->sequence < y->sequence ? -1 : x->sequence > y->sequence;
+}
+/**
+ * @brief Apply stock changes in one transaction, or as part of the open one
+ * The changes are sorted by product so each stock record is written once with all its changes, and
+ * the stock file stays locked until the transaction commits, so concurrent lanes never lose a change
+ * 
+ * @param changes stock changes, sorted in place
+ * @param count count of changes
+ * @param track 1 - start tracking the stock of the products not tracked yet | 0 - only change the tracked stock
+ * @return int 0 - success | -1 error
+ */
+int applyStockChanges(StockChange * changes, int count, int track) {
+    FILE * fp;
+    RecordFileHeader header;
+    StockRecord record;
+    const StockRecord * records;
+    char * slots;
+    int i, k, id, tracked, added, result = 0;
+    if (count <= 0)
+        return 0;
+    qsort(changes, count, sizeof(StockChange), compareStockChanges);
+    if ((fp = openRecordFile(STOCKRECORDS, sizeof(StockRecord), &header)) == NULL)
+        return -1;
+    id = changes[count - 1].product_id; // highest product ID
+    if (track && id >= header.count) { // the slots up to the highest ID are added, not tracked until changed
+        added = id + 1 - header.count;
+        if ((slots = calloc(added, sizeof(StockRecord))) == NULL // calloc zeroes the slots to EMPTY_ID
+            || writeToFileAt(STOCKRECORDS, (long)sizeof(RecordFileHeader) + (long)header.count * sizeof(StockRecord), slots, added * sizeof(StockRecord)) != 0) {
+            free(slots);
+            abortTransaction();
+            return -1;
+        }
+        free(slots);
+        header.count += added;
+        header.next_id = header.count;
+    }
+    refreshRecordView(&stockView); // the added slots are not seen before the commit
+    records = stockView.base;
+    for (i = 0; i < count && result == 0; i = k) {
+        id = changes[i].product_id;
+        memset(&record, 0, sizeof(record));
+        if (id > 0 && id < stockView.count && records[id].product_id == id)
+            record = records[id];
+        tracked = id > 0 && id < header.count && (track || record.product_id == id);
+        for (k = i; k < count && changes[k].product_id == id; k++) {
+            if (!tracked)
+                continue;
+            if (changes[k].op == STOCK_ADD)
+                record.quantity += changes[k].quantity;
+            else if (changes[k].op == STOCK_COUNT)
+                record.quantity = changes[k].quantity;
+            else
+                record.reorder_level = changes[k].quantity;
+        }
+        if (!tracked)
+            continue;
+        record.product_id = id;
+        result = writeRecordAt(STOCKRECORDS, sizeof(StockRecord), id, &record);
+    }
+    if (result != 0) {
+        abortTransaction();
+        return -1;
+    }
+    return closeRecordFile(STOCKRECORDS, &header, 1);
+}
+/**
+ * @brief Remove the units sold by a checkout from the stock of the tracked products, as part of the
+ * transaction of the checkout
+ * 
+ * @param sales line items
+ * @param count count of line items
+ * @return int 0 - success | -1 error
+ */
+int updateSaleStock(const SaleTransaction * sales, int count) {
+    StockChange * changes;
+    int i, n = 0, result;
+    if (refreshRecordView(&stockView) == 0)
+        return 0; // the stock of no product is tracked
+    if ((changes = malloc((count > 0 ? count : 1) * sizeof(StockChange))) == NULL)
+        return -1;
+    for (i = 0; i < count; i++) {
+        if (sales[i].id == DELETED_ID)
+            continue;
+        changes[n].product_id = sales[i].product_id;
+        changes[n].op = STOCK_ADD;
+        changes[n].quantity = -sales[i].quantity;
+        changes[n].sequence = n;
+        n++;
+    }
+    result = applyStockChanges(changes, n, 0);
+    free(changes);
+    return result;
+}
+/**
+ * @brief Add the units received by a delivery manifest to the stock, all rows in one transaction
+ * Each row is "product_id,quantity[,reorder_level]"; a first row starting with "product_id" holds the
+ * column names. The rows of unknown products or invalid numbers are rejected, the others are applied
+ * 
+ * @param csvname CSV file of the manifest
+ * @return int count of rejected rows | -1 error
+ */
+int importStockManifest(const char * csvname) {
+    CsvReader * reader;
+    StockChange * changes = NULL, * grown;
+    char * fields[CSV_MAX_FIELDS], * end;
+    int n, id, quantity, level, capacity = 0, count = 0, applied = 0, failed = 0, result = 0;
+    if ((reader = arenaAlloc(&recordArena, sizeof(CsvReader))) == NULL)
+        return -1;
+    memset(reader, 0, sizeof(CsvReader));
+    reader->next = 1;
+    if ((reader->fp = fopen(csvname, "rb")) == NULL) {
+        fprintf(stderr, "CANNOT READ %s FILE.\n", csvname);
+        return -1;
+    }
+    while ((n = readCsvRow(reader, fields, CSV_MAX_FIELDS)) != 0) {
+        if (n == 1 && fields[0][0] == 0)
+            continue; // empty line
+        if (reader->line == 1 && n > 0 && 0 == strcmp(fields[0], "product_id"))
+            continue; // column names
+        if (n < 2 || n > 3) {
+            fprintf(stderr, n < 0 ? "LINE %d: ROW TOO LONG.\n" : "LINE %d: ROW NEEDS 2 OR 3 COLUMNS.\n", reader->line);
+            failed++;
+            continue;
+        }
+        id = (int)strtol(fields[0], &end, 10);
+        if (id <= 0 || *end != 0 || findProductRecord(id) == NULL) {
+            fprintf(stderr, "LINE %d: UNKNOWN PRODUCT ID %s.\n", reader->line, fields[0]);
+            failed++;
+            continue;
+        }
+        quantity = (int)strtol(fields[1], &end, 10);
+        if (quantity <= 0 || *end != 0) {
+            fprintf(stderr, "LINE %d: INVALID QUANTITY %s.\n", reader->line, fields[1]);
+            failed++;
+            continue;
+        }
+        level = -1; // empty or no reorder level keeps the current one
+        if (n == 3 && fields[2][0] != 0 && ((level = (int)strtol(fields[2], &end, 10)) < 0 || *end != 0)) {
+            fprintf(stderr, "LINE %d: INVALID REORDER LEVEL %s.\n", reader->line, fields[2]);
+            failed++;
+            continue;
+        }
+        if (count + 2 > capacity) {
+            capacity = capacity > 0 ? capacity * 2 : STOCK_MIN_CHANGES;
+            if ((grown = realloc(changes, capacity * sizeof(StockChange))) == NULL) {
+                result = -1;
+                break;
+            }
+            changes = grown;
+        }
+        changes[count].product_id = id;
+        changes[count].op = STOCK_ADD;
+        changes[count].quantity = quantity;
+        changes[count].sequence = count;
+        count++;
+        if (level >= 0) {
+            changes[count].product_id = id;
+            changes[count].op = STOCK_REORDER;
+            changes[count].quantity = level;
+            changes[count].sequence = count;
+            count++;
+        }
+        applied++;
+    }
+    fclose(reader->fp);
+    if (result == 0)
+        result = applyStockChanges(changes, count, 1);
+    free(changes);
+    if (result != 0) {
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", STOCKRECORDS);
+        return -1;
+    }
+    printf(" => Import %s: %d row(s) applied, %d row(s) rejected.\n", csvname, applied, failed);
+    return failed;
+}
+/**
+ * @brief Get the Product struct By ID
+ * 
+ * @param productbuffer Product struct buffer
+ * @param searchID Product ID search
+ * @return int 0 - success | -1 not found
+ */
+int getProductByID(Product * productbuffer, int searchID) {
+    const ProductRecord * record;
+    if (serverFd >= 0 && requestServer(SERVER_PRODUCT, searchID, NULL, 0, productbuffer, sizeof(Product)) == 0)
+        return 0; // found by the POS server
+    if (serverFd < 0 && (record = findProductRecord(searchID)) != NULL) { // no POS server, or the connection to it was lost
+        loadProduct(record, productbuffer); // if id found, copy to product struct buffer
+        return 0; // found
+    }
+    printf(" => Product not found! Try again.\n");
+    getch();
+    return -1; // not found
+}
+/**
+ * @brief Find the product record by ID
+ * One probe of the product hash index then one read of the record slot; the records are only
+ * scanned if the index is missing or out of date. The records and index are read through the product
+ * catalog, so a lookup does no I/O besides one stat while the product records are unchanged
+ * 
+ * @param searchID Product ID search
+ * @return const ProductRecord* record in the product records view; NULL if not found
+ */
+const ProductRecord * findProductRecord(int searchID) {
+    int count, i, entry, slot;
+    if (searchID == DELETED_ID || searchID == EMPTY_ID)
+        return NULL;
+    count = refreshCatalog(&productCatalog);
+    const ProductRecord * products = productView.base; // product records read directly from the mapped file
+    if (productIndexView.count > 0) {
+        if ((entry = findIndexEntry(&productIndexView, searchID)) < 0)
+            return NULL; // not found
+        slot = ((const IndexEntry *)productIndexView.base)[entry].slot;
+        if (slot >= 0 && slot < count && products[slot].id == searchID)
+            return &products[slot];
+    }
+    for (i = 0; i < count; i++) {
+        if (products[i].id == searchID)
+            return &products[i];
+    }
+    return NULL; // not found
+}
+/**
+ * @brief Get the Teller struct By ID
+ * 
+ * @param tellerbuffer Teller struct buffer
+ * @param searchID Teller ID search
+ * @return int 0 - success | -1 not found
+ */
+int getTellerByID(Teller * tellerbuffer, int searchID) {
+    const TellerRecord * record;
+    if (serverFd >= 0 && requestServer(SERVER_TELLER, searchID, NULL, 0, tellerbuffer, sizeof(Teller)) == 0)
+        return 0; // found by the POS server
+    if (serverFd < 0 && (record = findTellerRecord(searchID)) != NULL) {
+        loadTeller(record, tellerbuffer); // if id found, copy to teller struct buffer
+        return 0; // found
+    }
+    printf(" => Teller not found! Try again.\n");
+    getch();
+    return -1; // not found
+}
+/**
+ * @brief Find the teller record by ID
+ * The tellers have no hash index, there are few of them and they are only looked up once per checkout
+ * 
+ * @param searchID Teller ID search
+ * @return const TellerRecord* record in the teller records view; NULL if not found
+ */
+const TellerRecord * findTellerRecord(int searchID) {
+    int count, i;
+    if (searchID == DELETED_ID || searchID == EMPTY_ID)
+        return NULL;
+    count = refreshCatalog(&tellerCatalog);
+    const TellerRecord * tellers = tellerView.base; // teller records read directly from the mapped file
+    for (i = 0; i < count; i++) {
+        if (tellers[i].id == searchID)
+            return &tellers[i];
+    }
+    return NULL; // not found
+}
+/**
+ * @brief Delete a product record with its hash index entry and trigram postings in one transaction
+ * 
+ * @param index slot index of the product record
+ * @return int 0 - success | -1 error
+ */
+int deleteProduct(int index) {
+    const char * name;
+    int id;
+    if (index < 0 || index >= refreshRecordView(&productView))
+        return -1;
+    refreshRecordView(&productStringView);
+    id = ((const ProductRecord *)productView.base)[index].id;
+    name = productString(((const ProductRecord *)productView.base)[index].name);
+    beginTransaction();
+    if (0 != deleteRecordAt(PRODUCTRECORDS, sizeof(ProductRecord), index) || 0 != updateIndexEntry(&productIndexView, id, DELETED_ID)
+        || 0 != updateTrigrams(&productTrigrams, index, &name, NULL, 1)) {
+        abortTransaction();
+        return -1;
+    }
+    return commitTransaction(1);
+}
+/**
+ * @brief Hash a record ID to the first hash index slot to probe
+ * 
+ * @param id record ID
+ * @return unsigned int hash, masked by the caller to the count of slots
+ */
+unsigned int hashID(int id) {
+    unsigned int hash = (unsigned int)id * 2654435761u; // multiplicative hash spreads the sequential IDs
+    return hash ^ (hash >> 16);
+}
+/**
+ * @brief Find the hash index slot of a record ID by linear probing
+ * 
+ * @param index hash index view
+ * @param id record ID
+ * @return int slot of the hash index entry | -1 not found
+ */
+int findIndexEntry(RecordView * index, int id) {
+    const IndexEntry * entries = index->base;
+    unsigned int mask, i;
+    int probes;
+    if (index->count == 0)
+        return -1;
+    mask = (unsigned int)index->count - 1; // the count of slots is a power of 2
+    for (i = hashID(id) & mask, probes = 0; probes < index->count; i = (i + 1) & mask, probes++) {
+        if (entries[i].id == id)
+            return (int)i;
+        if (entries[i].id == EMPTY_ID)
+            return -1; // removed entries (DELETED_ID) do not end the probe sequence
+    }
+    return -1;
+}
+/**
+ * @brief Add, move or remove a record ID in a hash index as part of the open transaction
+ * The index is grown to twice its slots first if the new entry would fill more than 3/4 of them
+ * 
+ * @param index hash index view
+ * @param id record ID
+ * @param slot slot index of the record in its records file; DELETED_ID to remove the ID
+ * @return int 0 - success | -1 error
+ */
+int updateIndexEntry(RecordView * index, int id, int slot) {
+    IndexFileHeader header;
+    IndexEntry entry = { id, slot };
+    const IndexEntry * entries;
+    unsigned int mask, i;
+    int target;
+    if (refreshRecordView(index) == 0)
+        return 0; // no index, it is rebuilt at the next start
+    memcpy(&header, index->map, sizeof(header));
+    if ((target = findIndexEntry(index, id)) >= 0 && slot == DELETED_ID) {
+        entry.id = DELETED_ID;
+        header.used--;
+        header.deleted++;
+    }
+    else if (target < 0 && slot == DELETED_ID)
+        return 0; // not in the index
+    else if (target < 0) {
+        if ((header.used + header.deleted + 1) * 4 > header.count * 3) {
+            if (0 != writeIndexFile(index->filename, index->base, index->count, index->count * 2) || refreshRecordView(index) == 0)
+                return -1;
+            memcpy(&header, index->map, sizeof(header));
+        }
+        entries = index->base;
+        mask = (unsigned int)index->count - 1;
+        for (i = hashID(id) & mask; entries[i].id != EMPTY_ID && entries[i].id != DELETED_ID; i = (i + 1) & mask)
+            ;
+        if (entries[i].id == DELETED_ID)
+            header.deleted--; // reuse the slot of a removed entry
+        header.used++;
+        target = (int)i;
+    }
+    header.checksum = fnv1a(&header, offsetof(IndexFileHeader, checksum));
+    if (0 != writeToFileAt(index->filename, (long)sizeof(IndexFileHeader) + (long)target * sizeof(IndexEntry), &entry, sizeof(entry))
+        || 0 != writeToFileAt(index->filename, 0, &header, sizeof(header)))
+        return -1;
+    return 0;
+}
+/**
+ * @brief Write a new hash index file from index entries
+ * The file is written aside then replaces the old one, so the log is checkpointed first as its
+ * frames refer to the slots of the old file
+ * 
+ * @param filename hash index file
+ * @param entries index entries, EMPTY_ID and DELETED_ID entries are skipped
+ * @param count count of entries
+ * @param capacity count of slots of the new index, a power of 2
+ * @return int 0 - success | -1 error
+ */
+int writeIndexFile(const char * filename, const IndexEntry * entries, int count, int capacity) {
+    FILE * fp;
+    IndexFileHeader header;
+    IndexEntry * table;
+    char tempname[MAX_NAME];
+    unsigned int mask = (unsigned int)capacity - 1, i;
+    int k, result = 0;
+    if ((table = calloc(capacity, sizeof(IndexEntry))) == NULL) // calloc zeroes the slots to EMPTY_ID
+        return -1;
+    memset(&header, 0, sizeof(header));
+    header.magic = INDEX_MAGIC;
+    header.schema_version = SCHEMA_VERSION;
+    header.record_size = sizeof(IndexEntry);
+    header.count = capacity;
+    for (k = 0; k < count; k++) {
+        if (entries[k].id == EMPTY_ID || entries[k].id == DELETED_ID)
+            continue;
+        for (i = hashID(entries[k].id) & mask; table[i].id != EMPTY_ID; i = (i + 1) & mask)
+            ;
+        table[i] = entries[k];
+        header.used++;
+    }
+    header.checksum = fnv1a(&header, offsetof(IndexFileHeader, checksum));
+    replayLog(0);
+    if (snprintf(tempname, sizeof(tempname), "%s.tmp", filename) >= (int)sizeof(tempname) || (fp = fopen(tempname, "wb")) == NULL) {
+        free(table);
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", filename);
+        return -1;
+    }
+    if (fwrite(&header, sizeof(header), 1, fp) != 1 || fwrite(table, sizeof(IndexEntry), capacity, fp) != (size_t)capacity
+        || (wal.durability != DURABILITY_NONE && syncFile(fp) != 0))
+        result = -1;
+    free(table);
+    if (fclose(fp) != 0 || result != 0) {
+        remove(tempname);
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", filename);
+        return -1;
+    }
+#ifdef _WIN32
+    remove(filename); // rename() does not replace an existing file on Windows
+#endif
+    if (rename(tempname, filename) != 0) {
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", filename);
+        return -1;
+    }
+    return 0;
+}
+/**
+ * @brief Rebuild the product hash index from the product records
+ * 
+ * @return int 0 - success | -1 error
+ */
+int rebuildProductIndex(void) {
+    IndexEntry * entries;
+    int i, count, capacity = INDEX_MIN_CAPACITY, result;
+    count = refreshRecordView(&productView);
+    const ProductRecord * products = productView.base;
+    if ((entries = malloc(sizeof(IndexEntry) * (count > 0 ? count : 1))) == NULL)
+        return -1;
+    for (i = 0; i < count; i++) {
+        entries[i].id = products[i].id; // deleted records (DELETED_ID) are skipped
+        entries[i].slot = i;
+    }
+    while (capacity < count * 2) // at most half full
+        capacity *= 2;
+    result = writeIndexFile(PRODUCTINDEX, entries, count, capacity);
+    free(entries);
+    closeRecordView(&productIndexView);
+    return result;
+}
+/**
+ * @brief Check that the product hash index exists and counts every live product record
+ * 
+ * @return int 0 - up to date | -1 missing or out of date
+ */
+int checkProductIndex(void) {
+    IndexFileHeader header;
+    if (!fileExists(PRODUCTINDEX) || refreshRecordView(&productIndexView) == 0 || refreshRecordView(&productView) < 0)
+        return -1;
+    memcpy(&header, productIndexView.map, sizeof(header));
+    if (header.checksum != fnv1a(&header, offsetof(IndexFileHeader, checksum)) || header.schema_version != SCHEMA_VERSION || productView.header == NULL
+        || header.used != productView.header->count - productView.header->deleted)
+        return -1;
+    return 0;
+}
+/**
+ * @brief Delete a teller record and its trigram postings in one transaction
+ * 
+ * @param index slot index of the teller record
+ * @return int 0 - success | -1 error
+ */
+int deleteTeller(int index) {
+    const char * strings[3];
+    const TellerRecord * teller;
+    if (index < 0 || index >= refreshRecordView(&tellerView))
+        return -1;
+    refreshRecordView(&tellerStringView);
+    teller = &((const TellerRecord *)tellerView.base)[index];
+    strings[0] = tellerString(teller->first_name);
+    strings[1] = tellerString(teller->middle_name);
+    strings[2] = tellerString(teller->last_name);
+    beginTransaction();
+    if (0 != deleteRecordAt(TELLERRECORDS, sizeof(TellerRecord), index) || 0 != updateTrigrams(&tellerTrigrams, index, strings, NULL, 3)) {
+        abortTransaction();
+        return -1;
+    }
+    return commitTransaction(1);
+}
+/**
+ * @brief Collect the distinct case-folded trigrams of strings
+ * 
+ * @param strings 
+ * @param count count of strings
+ * @param trigrams buffer for MAX_TRIGRAMS trigrams, sorted on return
+ * @return int count of distinct trigrams
+ */
+int collectTrigrams(const char ** strings, int count, unsigned int * trigrams) {
+    int k, i, j, n = 0, len;
+    unsigned int trigram;
+    for (k = 0; k < count; k++) {
+        len = (int)strlen(strings[k]);
+        for (i = 0; i + 2 < len && n < MAX_TRIGRAMS; i++) {
+            trigram = (unsigned int)tolower((unsigned char)strings[k][i]) << 16
+                | (unsigned int)tolower((unsigned char)strings[k][i + 1]) << 8
+                | (unsigned int)tolower((unsigned char)strings[k][i + 2]);
+            for (j = n; j > 0 && trigrams[j - 1] > trigram; j--) // insertion sort, names are short
+                trigrams[j] = trigrams[j - 1];
+            trigrams[j] = trigram;
+            n++;
+        }
+    }
+    for (i = 0, j = 0; i < n; i++) { // drop the duplicates
+        if (j == 0 || trigrams[j - 1] != trigrams[i])
+            trigrams[j++] = trigrams[i];
+    }
+    return j;
+}
+/**
+ * @brief Append the trigram postings which changed between the old and new strings of a record
+ * The postings are appended to the posting log as part of the open transaction
+ * 
+ * @param index trigram index
+ * @param slot slot index of the record in its records file
+ * @param oldStrings strings before the change; NULL for a new record
+ * @param newStrings strings after the change; NULL for a deleted record
+ * @param count count of strings
+ * @return int 0 - success | -1 error
+ */
+int updateTrigrams(TrigramIndex * index, int slot, const char ** oldStrings, const char ** newStrings, int count) {
+    unsigned int oldTrigrams[MAX_TRIGRAMS], newTrigrams[MAX_TRIGRAMS];
+    TrigramPosting postings[2 * MAX_TRIGRAMS];
+    int oldCount = 0, newCount = 0, i = 0, j = 0, n = 0;
+    if (oldStrings != NULL)
+        oldCount = collectTrigrams(oldStrings, count, oldTrigrams);
+    if (newStrings != NULL)
+        newCount = collectTrigrams(newStrings, count, newTrigrams);
+    while (i < oldCount || j < newCount) { // merge the two sorted sets
+        if (j == newCount || (i < oldCount && oldTrigrams[i] < newTrigrams[j])) {
+            postings[n].slot = slot;
+            postings[n++].trigram = oldTrigrams[i++] | TRIGRAM_REMOVED; // only in the old strings
+        }
+        else if (i == oldCount || newTrigrams[j] < oldTrigrams[i]) {
+            postings[n].slot = slot;
+            postings[n++].trigram = newTrigrams[j++]; // only in the new strings
+        }
+        else {
+            i++; // in both, unchanged
+            j++;
+        }
+    }
+    if (n == 0)
+        return 0;
+    return appendRecords(index->view.filename, sizeof(TrigramPosting), postings, n) < 0 ? -1 : 0;
+}
+/**
+ * @brief Find the posting list of a trigram in the in-memory trigram table
+ * 
+ * @param index trigram index
+ * @param trigram 
+ * @param create 1 - add an empty list if not found | 0 - only find
+ * @return PostingList* the posting list; NULL if not found
+ */
+PostingList * findPostingList(TrigramIndex * index, unsigned int trigram, int create) {
+    PostingList * lists;
+    unsigned int mask, i;
+    int k, capacity;
+    if (create && (index->used + 1) * 4 > index->capacity * 3) { // grow the table by doubling
+        capacity = index->capacity > 0 ? index->capacity * 2 : 1024;
+        if ((lists = calloc(capacity, sizeof(PostingList))) == NULL)
+            return NULL;
+        mask = (unsigned int)capacity - 1;
+        for (k = 0; k < index->capacity; k++) {
+            if (index->lists[k].trigram == 0)
+                continue;
+            for (i = hashID((int)index->lists[k].trigram) & mask; lists[i].trigram != 0; i = (i + 1) & mask)
+                ;
+            lists[i] = index->lists[k];
+        }
+        free(index->lists);
+        index->lists = lists;
+        index->capacity = capacity;
+    }
+    if (index->capacity == 0)
+        return NULL;
+    mask = (unsigned int)index->capacity - 1;
+    for (i = hashID((int)trigram) & mask; index->lists[i].trigram != 0; i = (i + 1) & mask) {
+        if (index->lists[i].trigram == trigram)
+            return &index->lists[i];
+    }
+    if (!create)
+        return NULL;
+    index->lists[i].trigram = trigram; // trigrams of non-empty characters are never 0
+    index->used++;
+    return &index->lists[i];
+}
+/**
+ * @brief Apply the postings appended to the posting log since the last refresh to the posting lists
+ * The posting lists are rebuilt from the start if the posting log was replaced
+ * 
+ * @param index trigram index
+ * @return int 0 - success | -1 error
+ */
+int refreshTrigramIndex(TrigramIndex * index) {
+    const TrigramPosting * postings;
+    PostingList * list;
+    int i, count, lo, hi, mid, * slots;
+    count = refreshRecordView(&index->view);
+    if (index->view.inode != index->inode || count < index->applied) // replaced by rebuildTrigramIndex()
+        resetTrigramIndex(index);
+    index->inode = index->view.inode;
+    postings = index->view.base;
+    for (; index->applied < count; index->applied++) {
+        i = index->applied;
+        if ((list = findPostingList(index, postings[i].trigram & ~TRIGRAM_REMOVED, !(postings[i].trigram & TRIGRAM_REMOVED))) == NULL)
+            continue; // removing from a list that does not exist
+        for (lo = 0, hi = list->count; lo < hi; ) { // binary search of the slot in the sorted list
+            mid = (lo + hi) / 2;
+            if (list->slots[mid] < postings[i].slot)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (postings[i].trigram & TRIGRAM_REMOVED) {
+            if (lo < list->count && list->slots[lo] == postings[i].slot) {
+                memmove(list->slots + lo, list->slots + lo + 1, (list->count - lo - 1) * sizeof(int));
+                list->count--;
+                index->live--;
+            }
+            continue;
+        }
+        if (lo < list->count && list->slots[lo] == postings[i].slot)
+            continue; // already in the list
+        if (list->count == list->capacity) {
+            if ((slots = realloc(list->slots, (list->capacity > 0 ? list->capacity * 2 : 4) * sizeof(int))) == NULL)
+                return -1;
+            list->slots = slots;
+            list->capacity = list->capacity > 0 ? list->capacity * 2 : 4;
+        }
+        memmove(list->slots + lo + 1, list->slots + lo, (list->count - lo) * sizeof(int)); // new records mostly append at the end
+        list->slots[lo] = postings[i].slot;
+        list->count++;
+        index->live++;
+    }
+    return 0;
+}
+/**
+ * @brief Free the in-memory posting lists of a trigram index
+ * 
+ * @param index trigram index
+ */
+void resetTrigramIndex(TrigramIndex * index) {
+    int k;
+    for (k = 0; k < index->capacity; k++)
+        free(index->lists[k].slots);
+    free(index->lists);
+    index->lists = NULL;
+    index->capacity = 0;
+    index->used = 0;
+    index->applied = 0;
+    index->live = 0;
+}
+/**
+ * @brief Find the candidate record slots of a substring query by intersecting the posting lists of its trigrams
+ * The candidates still have to be verified against the record strings
+ * 
+ * @param index trigram index
+ * @param query substring query
+ * @param slots buffer for the candidate slots, sorted on return
+ * @param maxslots size of the slots buffer
+ * @return int count of candidates | -1 query is shorter than a trigram, every record is a candidate
+ */
+int searchTrigrams(TrigramIndex * index, const char * query, int * slots, int maxslots) {
+    unsigned int trigrams[MAX_TRIGRAMS];
+    PostingList * lists[MAX_TRIGRAMS], * list;
+    int k, i, j, n, count, lo, hi, mid;
+    if (strlen(query) < 3)
+        return -1;
+    if (refreshTrigramIndex(index) != 0)
+        return -1;
+    n = collectTrigrams(&query, 1, trigrams);
+    for (k = 0; k < n; k++) {
+        if ((list = findPostingList(index, trigrams[k], 0)) == NULL || list->count == 0)
+            return 0; // a trigram of the query is in no record
+        for (j = k; j > 0 && lists[j - 1]->count > list->count; j--) // shortest list first
+            lists[j] = lists[j - 1];
+        lists[j] = list;
+    }
+    count = lists[0]->count < maxslots ? lists[0]->count : maxslots;
+    memcpy(slots, lists[0]->slots, count * sizeof(int));
+    for (k = 1; k < n && count > 0; k++) {
+        for (i = 0, j = 0; i < count; i++) { // keep the slots found by binary search in the longer list
+            for (lo = 0, hi = lists[k]->count; lo < hi; ) {
+                mid = (lo + hi) / 2;
+                if (lists[k]->slots[mid] < slots[i])
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            if (lo < lists[k]->count && lists[k]->slots[lo] == slots[i])
+                slots[j++] = slots[i];
+        }
+        count = j;
+    }
+    return count;
+}
+/**
+ * @brief Rebuild the posting log of a trigram index from the strings of the records
+ * The posting log is written aside then replaces the old one, so the log is checkpointed first as
+ * its frames refer to the old file
+ * 
+ * @param index trigram index
+ * @param records records view
+ * @param heap string heap view of the records
+ * @param stringcount count of string offsets following the id in each record, all are indexed
+ * @return int 0 - success | -1 error
+ */
+int rebuildTrigramIndex(TrigramIndex * index, RecordView * records, RecordView * heap, int stringcount) {
+    FILE * fp;
+    RecordFileHeader header;
+    TrigramPosting posting;
+    unsigned int trigrams[MAX_TRIGRAMS];
+    const char * strings[MAX_STRINGS];
+    char tempname[MAX_NAME];
+    int i, k, n, id, offset, count, result = 0;
+    count = refreshRecordView(records);
+    refreshRecordView(heap);
+    if (snprintf(tempname, sizeof(tempname), "%s.tmp", index->view.filename) >= (int)sizeof(tempname)) {
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", index->view.filename);
+        return -1;
+    }
+    replayLog(0);
+    if ((fp = fopen(tempname, "wb")) == NULL) {
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", index->view.filename);
+        return -1;
+    }
+    initRecordHeader(&header, sizeof(TrigramPosting));
+    fwrite(&header, sizeof(header), 1, fp); // placeholder, the header is rewritten once the postings are written
+    for (i = 0; i < count; i++) {
+        memcpy(&id, (const char *)records->base + (size_t)i * records->recordsize, sizeof(int)); // all record structs start with the int id
+        if (id == DELETED_ID)
+            continue;
+        for (k = 0; k < stringcount; k++) {
+            memcpy(&offset, (const char *)records->base + (size_t)i * records->recordsize + sizeof(int) * (k + 1), sizeof(int));
+            strings[k] = heapString(heap, offset);
+        }
+        n = collectTrigrams(strings, stringcount, trigrams);
+        posting.slot = i;
+        for (k = 0; k < n; k++) {
+            posting.trigram = trigrams[k];
+            if (fwrite(&posting, sizeof(posting), 1, fp) != 1)
+                result = -1;
+        }
+        header.count += n;
+    }
+    if (result != 0 || writeRecordHeader(fp, tempname, &header) != 0 || (wal.durability != DURABILITY_NONE && syncFile(fp) != 0))
+        result = -1;
+    if (fclose(fp) != 0 || result != 0) {
+        remove(tempname);
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", index->view.filename);
+        return -1;
+    }
+#ifdef _WIN32
+    remove(index->view.filename); // rename() does not replace an existing file on Windows
+#endif
+    if (rename(tempname, index->view.filename) != 0) {
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", index->view.filename);
+        return -1;
+    }
+    resetTrigramIndex(index);
+    return 0;
+}
+/**
+ * @brief Drop the dead postings of a trigram posting log once they outnumber the live ones TRIGRAM_DEAD_RATIO times
+ * The log only grows with each add, update and delete. Its posting lists hold the live postings, so they are
+ * written aside under the exclusive lock of the log, then replace it. The lanes waiting for the lock lock the
+ * new log (see openRecordFile()) and the lanes reading it rebuild their posting lists from the new log
+ * 
+ * @param index trigram index
+ * @return int 1 - compacted | 0 - not worth compacting | -1 error, the log is left as is
+ */
+int compactTrigramLog(TrigramIndex * index) {
+    FILE * fp, * tmp;
+    RecordFileHeader header;
+    TrigramPosting posting;
+    char tempname[MAX_NAME];
+    int k, i, result = 0;
+    if (wal.depth > 0 || refreshTrigramIndex(index) != 0 || index->applied < TRIGRAM_COMPACT_MIN
+        || index->applied - index->live < (long long)index->live * TRIGRAM_DEAD_RATIO)
+        return 0; // the postings of an open transaction are not applied yet
+    if (snprintf(tempname, sizeof(tempname), "%s.tmp", index->view.filename) >= (int)sizeof(tempname))
+        return -1;
+    if ((fp = openRecordFile(index->view.filename, sizeof(TrigramPosting), &header)) == NULL)
+        return -1;
+    // no posting can be appended now, apply the ones appended by other lanes since the check
+    if (refreshTrigramIndex(index) != 0 || index->applied != header.count
+        || index->applied - index->live < (long long)index->live * TRIGRAM_DEAD_RATIO) {
+        commitTransaction(0); // releases the lock of the posting log, nothing was written to it
+        return 0;
+    }
+    if (replayLog(0) < 0 || (tmp = fopen(tempname, "wb")) == NULL) { // the logged writes refer to the offsets of the log about to be replaced
+        commitTransaction(0);
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", index->view.filename);
+        return -1;
+    }
+    header.count = index->live;
+    header.deleted = 0;
+    fwrite(&header, sizeof(header), 1, tmp); // placeholder, the header is rewritten once the postings are written
+    for (k = 0; k < index->capacity; k++) {
+        posting.trigram = index->lists[k].trigram;
+        for (i = 0; i < index->lists[k].count; i++) {
+            posting.slot = index->lists[k].slots[i];
+            if (fwrite(&posting, sizeof(posting), 1, tmp) != 1)
+                result = -1;
+        }
+    }
+    if (result != 0 || writeRecordHeader(tmp, tempname, &header) != 0 || (wal.durability != DURABILITY_NONE && syncFile(tmp) != 0))
+        result = -1;
+    if (fclose(tmp) != 0 || result != 0) {
+        remove(tempname);
+        result = -1;
+    }
+#ifdef _WIN32
+    commitTransaction(0); // open files cannot be removed on Windows, which has no file locks to keep
+    if (result == 0)
+        remove(index->view.filename); // rename() does not replace an existing file on Windows
+#endif
+    if (result == 0 && rename(tempname, index->view.filename) != 0)
+        result = -1;
+    if (result == 0 && wal.durability != DURABILITY_NONE && syncDirectory() != 0)
+        result = -1; // the new log must be in place before the next frames refer to its offsets
+#ifndef _WIN32
+    commitTransaction(0); // releases the lock of the replaced posting log
+#endif
+    if (result != 0) {
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", index->view.filename);
+        return -1;
+    }
+    resetTrigramIndex(index);
+    return 1;
+}
+/**
+ * @brief Check if a string contains a substring, ignoring the case
+ * 
+ * @param text 
+ * @param query substring
+ * @return int 1 - contains | 0 - does not contain
+ */
+int containsIgnoreCase(const char * text, const char * query) {
+    int k, i, textlen = (int)strlen(text), querylen = (int)strlen(query);
+    for (k = 0; k + querylen <= textlen; k++) {
+        for (i = 0; i < querylen && tolower((unsigned char)text[k + i]) == tolower((unsigned char)query[i]); i++) // same case folding as collectTrigrams(), strnicmp() is Windows only
+            ;
+        if (i == querylen)
+            return 1;
+    }
+    return 0;
+}
+/**
+ * @brief Allocate a buffer from an arena
+ * The blocks are searched from the current block on, the blocks before it are not reused until the
+ * arena is reset. A new block is only allocated when no block from the current one on has enough room.
+ * The buffer lives until the arena is reset
+ * 
+ * @param arena 
+ * @param size size in bytes
+ * @return void* 16-byte aligned buffer; NULL if out of memory
+ */
+void * arenaAlloc(Arena * arena, size_t size) {
+    ArenaBlock * block, * last = NULL;
+    size = (size + 15) & ~(size_t)15; // keep every buffer 16-byte aligned
+    for (block = arena->current; block != NULL; last = block, block = block->next) {
+        if (block->size - block->used >= size)
+            break;
+    }
+    if (block == NULL) {
+        if ((block = malloc(ARENA_HEADER_SIZE + (size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE))) == NULL)
+            return NULL;
+        block->next = NULL;
+        block->size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block->used = 0;
+        if (last != NULL)
+            last->next = block;
+        else
+            arena->first = block;
+    }
+    arena->current = block;
+    block->used += size;
+    return (char *)block + ARENA_HEADER_SIZE + block->used - size;
+}
+/**
+ * @brief Free all the buffers of an arena at once, the blocks are kept for the next operation
+ * 
+ * @param arena 
+ */
+void arenaReset(Arena * arena) {
+    ArenaBlock * block;
+    for (block = arena->first; block != NULL; block = block->next)
+        block->used = 0;
+    arena->current = arena->first;
+}
+/**
+ * @brief Free the blocks of an arena
+ * 
+ * @param arena 
+ */
+void arenaFree(Arena * arena) {
+    ArenaBlock * block, * next;
+    for (block = arena->first; block != NULL; block = next) {
+        next = block->next;
+        free(block);
+    }
+    arena->first = NULL;
+    arena->current = NULL;
+}
+// other functions
+/**
+ * @brief Check if file exists
+ * 
+ * @param filename 
+ * @return int 1 - exists | 0 - not exists
+ */
+int fileExists(const char * filename) {
+    FILE * fp;
+    if ((fp = fopen(filename, "rb")) == NULL)
+        return 0;
+    fclose(fp);
+    return 1;
+}
+/**
+ * @brief Custom Scanf for single character input for integer number
+ * user single-input integer
+ * @param d int buffer
+ * @return int integer character inputted
+ */
+int dscanc(int * d) {
+    char cbuf, buf[2];
+    memset(buf, 0, 2);
+    cbuf = getch(); // getch() get a single character only then put to cbuf char buffer
+    *buf = cbuf; // copy the character cbuf to the first element of buf char array string
+    *d = atoi(buf); // atoi() converts a stringed type number to integer number and put to buffer
+    printf("%d\n", *d); // then display the inputted character to screen
+    // this way we dont have to press enter on inputting one character
+    return *d;
+}
+/**
+ * @brief Custom Scanf for single character input for char
+ * user single-input char
+ * @param c char buffer
  * @return int character inputted
  */
 int cscanc(char * c) {
@@ -1763,72 +7062,164 @@ char * capitalize(const char * word) {
     return ret; // return ret
 }
 /**
- * @brief Get the maximum value of an int array
+ * @brief Make room for more characters in an output buffer, growing it by doubling
  * 
- * @param arr array of integers
- * @return int maximum value
+ * @param out output buffer
+ * @param size count of characters to add
+ * @return int 0 - success | -1 not enough memory
  */
-int maxOfInt(int * arr, int count) {
-    int i;
-    if (count < 1)
+int reserveOutput(OutputBuffer * out, size_t size) {
+    char * data;
+    size_t capacity;
+    if (out->length + size <= out->capacity)
         return 0;
-    for (i = 0; i < count; i++) {
-        if (arr[0] < arr[i]) { // if current index element value is greater then the first element
-            arr[0] = arr[i]; // copy the current index element value to the first array
-        }
-    }
-    // the first element will be the maximum integer value
-    return arr[0];
-}
-/**
- * @brief Center the string content by size of char
- * 
- * @param Str content
- * @param size size of char
- * @return char* centered string with size of param size
- */
-char * centerTheString(const char * strval, int size) {
-    char buf[size], *ret;
-    int i = 0, j=0, lenOfStr, divideTwo = 2, minusOne = 1, end, spaces, lspace, rspace;
-    lenOfStr = strlen(strval);
-    memset(buf, 0, sizeof(buf)); // empty the string buffer
-    if (lenOfStr>size)
-        lenOfStr = size;
-    spaces = size - lenOfStr;
-    if (spaces % 2 == 1) {
-        lspace = (spaces + minusOne) / divideTwo;
-    } else {
-        lspace = spaces / divideTwo;
-    }
-    end = lenOfStr + lspace; // after content
-    rspace = size - (lenOfStr + lspace); // size of right spaces
-    memset(buf, ' ', lspace); // set left spaces
-    strncpy(buf + lspace, strval, lenOfStr); // set content in the middle
-    memset(buf + end, ' ', rspace); // set right spaces
-    buf[size] = 0; // set the last character to endline/null character
-    ret = (char *)buf; // return the char pointer with (char *)buf value
-    return ret;
-}
-/**
- * @brief Right Align Float Value in a String Format
- * 
- * @param value floating value
- * @param charsize size of char
- * @return char* String Formatted value with right-aligned position in accordance with char size
- */
-char * rightAlignFloat(float value, int size) {
-    char buffer[size], *ret, temp[size];
-    int lenOfValue = 0, minusOne = 1, spaces = 0;
-    memset(buffer, 0, sizeof(buffer));
-    memset(temp, 0, size);
-    sprintf(temp, "%.2f", value);
-    lenOfValue = strlen(temp);
-    spaces = size - lenOfValue;
-    memset(buffer, ' ', size);
-    strncpy(buffer + spaces, temp, lenOfValue); // copy the string value of float at the end after spaces
-    buffer[size] = 0; // set the last character to endline/null character
-    ret = (char *)buffer;
-    return ret;
+    for (capacity = out->capacity > 0 ? out->capacity : OUTPUT_MIN_CAPACITY; capacity < out->length + size; capacity *= 2)
+        ;
+    if ((data = realloc(out->data, capacity)) == NULL)
+        return -1;
+    out->data = data;
+    out->capacity = capacity;
+    return 0;
+}
+/**
+ * @brief Append a string to an output buffer
+ * 
+ * @param out output buffer
+ * @param text 
+ */
+void appendOutput(OutputBuffer * out, const char * text) {
+    size_t length = strlen(text);
+    if (reserveOutput(out, length) != 0)
+        return;
+    memcpy(out->data + out->length, text, length);
+    out->length += length;
+}
+/**
+ * @brief Append formatted text to an output buffer, as printf() would print it
+ * 
+ * @param out output buffer
+ * @param format printf() format
+ * @param ... 
+ */
+void appendOutputf(OutputBuffer * out, const char * format, ...) {
+    va_list args;
+    int length;
+    va_start(args, format);
+    length = vsnprintf(NULL, 0, format, args); // measure first so the text is formatted in place
+    va_end(args);
+    if (length < 0 || reserveOutput(out, (size_t)length + 1) != 0) // vsnprintf() also writes the null character
+        return;
+    va_start(args, format);
+    vsnprintf(out->data + out->length, (size_t)length + 1, format, args);
+    va_end(args);
+    out->length += length;
+}
+/**
+ * @brief Render a table row to an output buffer, each cell padded or cut to the width of its column
+ * The cells are formatted in place in the buffer, followed by a line break
+ * 
+ * @param out output buffer
+ * @param columns columns of the table
+ * @param cells values of the row, one per column
+ * @param count count of columns
+ */
+void renderRow(OutputBuffer * out, const ColumnSpec * columns, const TableCell * cells, int count) {
+    char number[MONEY_SIZE]; // formatted ID, amount or integer
+    const char * text;
+    size_t length, width = 1, spaces;
+    char * cell;
+    int k;
+    for (k = 0; k < count; k++)
+        width += columns[k].width;
+    if (reserveOutput(out, width) != 0) {
+        flushOutput(out); // the rows rendered so far are written out to free the room of the buffer
+        if (reserveOutput(out, width) != 0)
+            return;
+    }
+    for (k = 0; k < count; k++) {
+        text = number;
+        if (columns[k].format == CELL_TEXT)
+            text = cells[k].text;
+        else if (columns[k].format == CELL_ID)
+            snprintf(number, sizeof(number), "%08lld", cells[k].number);
+        else if (columns[k].format == CELL_MONEY)
+            formatMoney(number, cells[k].number);
+        else
+            snprintf(number, sizeof(number), "%lld", cells[k].number);
+        width = columns[k].width;
+        length = strnlen(text, width);
+        spaces = width - length;
+        if (columns[k].align == ALIGN_LEFT)
+            spaces = 0;
+        else if (columns[k].align == ALIGN_CENTER)
+            spaces = (spaces + 1) / 2;
+        cell = out->data + out->length;
+        memset(cell, ' ', width);
+        memcpy(cell + spaces, text, length);
+        out->length += width;
+    }
+    out->data[out->length++] = '\n';
+}
+/**
+ * @brief Render a product record as a row of the product tables
+ * 
+ * @param out output buffer
+ * @param product product record from the product records view
+ */
+void renderProductRow(OutputBuffer * out, const ProductRecord * product) {
+    TableCell cells[6];
+    cells[0].number = product->id;
+    cells[1].text = productString(product->name);
+    cells[2].text = productString(product->description);
+    cells[3].text = productString(product->category);
+    cells[4].text = productString(product->unit);
+    cells[5].number = product->unit_price;
+    renderRow(out, productColumns, cells, 6);
+}
+/**
+ * @brief Render a teller record as a row of the teller tables
+ * 
+ * @param out output buffer
+ * @param teller teller record from the teller records view
+ */
+void renderTellerRow(OutputBuffer * out, const TellerRecord * teller) {
+    TableCell cells[4];
+    cells[0].number = teller->id;
+    cells[1].text = tellerString(teller->first_name);
+    cells[2].text = tellerString(teller->middle_name);
+    cells[3].text = tellerString(teller->last_name);
+    renderRow(out, tellerColumns, cells, 4);
+}
+/**
+ * @brief Write an output buffer to the terminal with a single write and empty it
+ * 
+ * @param out output buffer
+ */
+void flushOutput(OutputBuffer * out) {
+    fflush(stdout); // the text printed before goes first
+#ifdef _WIN32
+    _write(_fileno(stdout), out->data, (unsigned int)out->length);
+#elif __linux__
+    size_t written = 0;
+    ssize_t result;
+    while (written < out->length && (result = write(STDOUT_FILENO, out->data + written, out->length - written)) > 0) // the terminal may take less at once
+        written += (size_t)result;
+#else
+    fwrite(out->data, 1, out->length, stdout);
+    fflush(stdout);
+#endif
+    out->length = 0;
+}
+/**
+ * @brief Free the memory of an output buffer
+ * 
+ * @param out output buffer
+ */
+void freeOutput(OutputBuffer * out) {
+    free(out->data);
+    out->data = NULL;
+    out->length = 0;
+    out->capacity = 0;
 }
 /**
  * @brief Custom scanf with default string if input is empty
@@ -1850,14 +7241,13 @@ void customScanfDefaultString(char * buffer, const char * defaultVal) {
     }
 }
 /**
- * @brief Custom Scanf with default floating number if input is empty
+ * @brief Custom Scanf with default amount if input is empty
  * 
- * @param buffer floating number buffer
- * @param defaultVal default float value
+ * @param buffer amount buffer in cents
+ * @param defaultVal default amount in cents
  */
-void customScanfDefaultFloat(float * buffer, float defaultVal) {
-    int i, dots = 0;
-    float result;
+void customScanfDefaultMoney(long long * buffer, long long defaultVal) {
+    int i, dots = 0, decimals = 0;
     char buf[MAX_NAME];
     memset(buf, 0, sizeof(buf));
     scanf("%[^\n]s", buf);
@@ -1870,17 +7260,22 @@ void customScanfDefaultFloat(float * buffer, float defaultVal) {
             goto DefaultValue; // redirect to DefaultValue
         }
         if (buf[i] == '.') dots++;
+        else if (dots > 0) decimals++;
         if (dots > 1) { // if input has more than one (.)
             printf(" Invalid Input. Cannot input more than one dot character (.) in a numeric input\n");
             goto DefaultValue; // redirect to DefaultValue
         }
+        if (decimals > 2) { // amounts are kept in cents
+            printf(" Invalid Input. Cannot input more than 2 decimals in an amount\n");
+            goto DefaultValue; // redirect to DefaultValue
+        }
     }
     // if all digits or . (dot)
     if (strlen(buf) == 1 && buf[0] == '.')
-        *buffer = 0.0; // zero if only a '.' character is inputted
-    else { // if digit is inputted and with or without dot (.)
-        result = (float)atof(buf); // atof() converts a stringed-type number to floating number
-        *buffer = result; // copy result to buffer
+        *buffer = 0; // zero if only a '.' character is inputted
+    else if ((*buffer = parseMoney(buf)) < 0) { // the digits are read as cents, without rounding through a float
+        printf(" Invalid Input. The amount is too large\n");
+        goto DefaultValue;
     }
     return;
     DefaultValue: // default value label
@@ -0,0 +1,169 @@
+/**
+ * @file bench.h
+ * @brief Helpers shared by the stress test and the benchmarks, included after ../pos.c
+ * Each program runs in a new directory under /tmp, its records files created by a first run of the POS.
+ */
+
+#include <dirent.h>
+#include <sys/wait.h>
+
+int openScratch(char * dirname); // create a records directory and make it the current directory
+int runPos(char ** args); // run the POS with arguments in a child process
+void removeScratch(const char * dirname); // remove the files of the records directory, then the directory
+long long nowMicros(void); // monotonic time in microseconds
+int compareLongLongs(const void * a, const void * b); // order long longs (qsort comparator)
+void printLatency(const char * label, long long * samples, int count, long long elapsed); // print the rate and latency percentiles of timed operations
+int writeProductCsv(const char * csvname, int count); // write a CSV file of generated products
+int fillSales(long long count, int perSale, int productCount, long long timestamp); // append generated checkouts of count line items in all
+
+/**
+ * @brief Create a records directory under /tmp and make it the current directory
+ * The records files are created by the POS itself, in a child process, so this process starts clean
+ *
+ * @param dirname buffer of a mkdtemp() template, set to the directory created
+ * @return int 0 - success | -1 error
+ */
+int openScratch(char * dirname) {
+    char * args[] = { "pos", "--durability", "none", "--rebuild-aggregates", NULL };
+    if (mkdtemp(dirname) == NULL || chdir(dirname) != 0) {
+        fprintf(stderr, "CANNOT CREATE %s DIRECTORY.\n", dirname);
+        return -1;
+    }
+    if (runPos(args) != 0) {
+        fprintf(stderr, "CANNOT CREATE THE RECORDS FILES IN %s.\n", dirname);
+        return -1;
+    }
+    return 0;
+}
+/**
+ * @brief Run the POS with arguments in a child process and wait for it to exit
+ *
+ * @param args arguments, the program name first, NULL terminated
+ * @return int 0 - the POS exited with status 0 | -1 error
+ */
+int runPos(char ** args) {
+    int argc, status;
+    pid_t pid;
+    for (argc = 0; args[argc] != NULL; argc++)
+        ;
+    if ((pid = fork()) == 0)
+        exit(pos_main(argc, args));
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return -1;
+    return 0;
+}
+/**
+ * @brief Remove the files of the records directory, then the directory
+ *
+ * @param dirname records directory, the current directory
+ */
+void removeScratch(const char * dirname) {
+    DIR * dir;
+    struct dirent * entry;
+    if ((dir = opendir(".")) != NULL) {
+        while ((entry = readdir(dir)) != NULL) {
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+                remove(entry->d_name);
+        }
+        closedir(dir);
+    }
+    if (chdir("/") == 0)
+        rmdir(dirname);
+}
+/**
+ * @brief Monotonic time in microseconds
+ *
+ * @return long long microseconds since an arbitrary start
+ */
+long long nowMicros(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+/**
+ * @brief Order long longs (qsort comparator)
+ *
+ * @param a long long
+ * @param b long long
+ * @return int negative, 0 or positive as a is before, the same as or after b
+ */
+int compareLongLongs(const void * a, const void * b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return x < y ? -1 : x > y;
+}
+/**
+ * @brief Print the rate and the latency percentiles of timed operations
+ *
+ * @param label name of the row
+ * @param samples latency of each operation in microseconds, sorted in place
+ * @param count count of operations
+ * @param elapsed wall time of all the operations in microseconds
+ */
+void printLatency(const char * label, long long * samples, int count, long long elapsed) {
+    if (count <= 0)
+        return;
+    qsort(samples, count, sizeof(long long), compareLongLongs);
+    printf("%-24s %8d ops %12.0f ops/s   p50 %8lld us   p99 %8lld us   max %8lld us\n", label, count,
+        elapsed > 0 ? count * 1e6 / elapsed : 0.0, samples[count / 2], samples[(int)(count * 0.99)], samples[count - 1]);
+}
+/**
+ * @brief Write a CSV file of generated products, with IDs from 1 to count
+ *
+ * @param csvname CSV file
+ * @param count count of products
+ * @return int 0 - success | -1 error
+ */
+int writeProductCsv(const char * csvname, int count) {
+    FILE * fp;
+    int i;
+    if ((fp = fopen(csvname, "w")) == NULL) {
+        fprintf(stderr, "CANNOT WRITE %s FILE.\n", csvname);
+        return -1;
+    }
+    fprintf(fp, "id,name,description,category,unit,unit_price\n");
+    for (i = 1; i <= count; i++)
+        fprintf(fp, "%d,Item %d,Generated product %d,category %d,pc,%d.%02d\n", i, i, i, i % 50, 1 + i % 100, i % 100);
+    return fclose(fp) == 0 ? 0 : -1;
+}
+/**
+ * @brief Append generated checkouts of count line items in all, each its own transaction
+ *
+ * @param count count of line items
+ * @param perSale line items of each checkout, the last one may have fewer
+ * @param productCount the line items sell the product IDs from 1 to productCount in turn
+ * @param timestamp time of the checkouts in seconds since the epoch; 0 for now
+ * @return int 0 - success | -1 error
+ */
+int fillSales(long long count, int perSale, int productCount, long long timestamp) {
+    SaleHeader sale;
+    SaleTransaction * items;
+    long long done;
+    int k, n, first;
+    if ((items = malloc((size_t)perSale * sizeof(SaleTransaction))) == NULL)
+        return -1;
+    for (done = 0; done < count; done += n) {
+        n = count - done < perSale ? (int)(count - done) : perSale;
+        if ((first = allocateSaleIDs(n + 1)) < 0) {
+            free(items);
+            return -1;
+        }
+        memset(&sale, 0, sizeof(sale));
+        sale.id = first;
+        sale.timestamp = timestamp != 0 ? timestamp : (long long)time(NULL);
+        for (k = 0; k < n; k++) {
+            memset(&items[k], 0, sizeof(SaleTransaction));
+            items[k].id = first + 1 + k;
+            items[k].product_id = 1 + (int)((done + k) % productCount);
+            items[k].quantity = 1;
+            items[k].unit_price = 100;
+            items[k].timestamp = sale.timestamp;
+            sale.total += items[k].unit_price;
+        }
+        if (checkoutSale(&sale, items, n) != 0) {
+            free(items);
+            return -1;
+        }
+    }
+    free(items);
+    return 0;
+}
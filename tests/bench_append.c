@@ -0,0 +1,73 @@
+/**
+ * @file bench_append.c
+ * @brief Benchmark of the checkout latency as the sale history grows: the history is filled up to
+ * 1k, 10k, 100k, 1M and 10M line items, and at each size 3-item checkouts are timed without fsync
+ * (the cost of the append itself) and with fsync per commit.
+ * Usage: bench_append [largest history, 10000000 by default]
+ */
+
+#define main pos_main
+#include "../pos.c"
+#undef main
+#include "bench.h"
+
+#define APPEND_CHECKOUTS 1000 // checkouts timed at each size without fsync
+#define APPEND_SYNCED 100 // checkouts timed at each size with fsync per commit
+#define APPEND_ITEMS 3 // line items of each timed checkout
+#define APPEND_FILL_ITEMS 1000 // line items of each checkout filling the history
+#define APPEND_PRODUCTS 1000 // products sold by the checkouts
+
+int timeCheckouts(const char * label, int count); // time 3-item checkouts and print their latency
+
+int main(int argc, char * argv[]) {
+    char dirname[] = "/tmp/pos-bench-XXXXXX", label[MAX_NAME];
+    long long size, filled = 0, largest = argc > 1 ? atoll(argv[1]) : 10000000;
+    if (largest < 1000 || openScratch(dirname) != 0)
+        return 1;
+    setDurability("none");
+    if (writeProductCsv("products.csv", APPEND_PRODUCTS) != 0 || openLog(joinLanes()) < 0 || runCsv("import", "products", "products.csv") != 0)
+        return 1;
+    for (size = 1000; size <= largest; size *= 10) {
+        setDurability("none"); // the history is filled without fsync
+        if (fillSales(size - filled, APPEND_FILL_ITEMS, APPEND_PRODUCTS, 0) != 0)
+            return 1;
+        filled = size;
+        snprintf(label, sizeof(label), "%lld sales, none", size);
+        if (timeCheckouts(label, APPEND_CHECKOUTS) != 0)
+            return 1;
+        filled += APPEND_CHECKOUTS * APPEND_ITEMS;
+        setDurability("fsync");
+        snprintf(label, sizeof(label), "%lld sales, fsync", size);
+        if (timeCheckouts(label, APPEND_SYNCED) != 0)
+            return 1;
+        filled += APPEND_SYNCED * APPEND_ITEMS;
+    }
+    closeLog();
+    removeScratch(dirname);
+    return 0;
+}
+/**
+ * @brief Time 3-item checkouts, each its own transaction, and print their latency
+ *
+ * @param label name of the row
+ * @param count count of checkouts
+ * @return int 0 - success | -1 error
+ */
+int timeCheckouts(const char * label, int count) {
+    long long * samples, started, begin;
+    int i;
+    if ((samples = malloc(count * sizeof(long long))) == NULL)
+        return -1;
+    begin = nowMicros();
+    for (i = 0; i < count; i++) {
+        started = nowMicros();
+        if (fillSales(APPEND_ITEMS, APPEND_ITEMS, APPEND_PRODUCTS, 0) != 0) {
+            free(samples);
+            return -1;
+        }
+        samples[i] = nowMicros() - started;
+    }
+    printLatency(label, samples, count, nowMicros() - begin);
+    free(samples);
+    return 0;
+}
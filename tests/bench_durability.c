@@ -0,0 +1,82 @@
+/**
+ * @file bench_durability.c
+ * @brief Benchmark of the checkout throughput and tail latency of each durability mode of the
+ * write-ahead log, each mode in its own records directory.
+ * Usage: bench_durability [mode ...], "fsync group group:5:4 none" by default
+ */
+
+#define main pos_main
+#include "../pos.c"
+#undef main
+#include "bench.h"
+
+#define DURABILITY_CHECKOUTS 2000 // checkouts timed in each mode
+#define DURABILITY_ITEMS 3 // line items of each checkout
+#define DURABILITY_PRODUCTS 1000 // products sold by the checkouts
+
+int benchDurability(const char * mode); // time the checkouts of one durability mode in a child process
+int runDurability(const char * mode); // time the checkouts of one durability mode
+
+int main(int argc, char * argv[]) {
+    const char * modes[] = { "fsync", "group", "group:5:4", "none" };
+    int i;
+    if (argc > 1) {
+        for (i = 1; i < argc; i++) {
+            if (benchDurability(argv[i]) != 0)
+                return 1;
+        }
+        return 0;
+    }
+    for (i = 0; i < (int)(sizeof(modes) / sizeof(modes[0])); i++) {
+        if (benchDurability(modes[i]) != 0)
+            return 1;
+    }
+    return 0;
+}
+/**
+ * @brief Time the checkouts of one durability mode in a child process, which starts with no records
+ * file mapped and no write-ahead log open
+ *
+ * @param mode fsync | group[:ms[:count]] | none
+ * @return int 0 - success | -1 error
+ */
+int benchDurability(const char * mode) {
+    int status;
+    pid_t pid;
+    if ((pid = fork()) == 0)
+        exit(runDurability(mode) == 0 ? 0 : 1);
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return -1;
+    return 0;
+}
+/**
+ * @brief Time the checkouts of one durability mode in a new records directory
+ * The time of the last group commits synced by closeLog() is counted in the throughput
+ *
+ * @param mode fsync | group[:ms[:count]] | none
+ * @return int 0 - success | -1 error
+ */
+int runDurability(const char * mode) {
+    char dirname[] = "/tmp/pos-bench-XXXXXX";
+    long long samples[DURABILITY_CHECKOUTS], started, begin;
+    int i;
+    if (setDurability(mode) != 0) {
+        fprintf(stderr, "INVALID DURABILITY MODE %s.\n", mode);
+        return -1;
+    }
+    if (openScratch(dirname) != 0)
+        return -1;
+    if (openLog(joinLanes()) < 0)
+        return -1;
+    begin = nowMicros();
+    for (i = 0; i < DURABILITY_CHECKOUTS; i++) {
+        started = nowMicros();
+        if (fillSales(DURABILITY_ITEMS, DURABILITY_ITEMS, DURABILITY_PRODUCTS, 0) != 0)
+            return -1;
+        samples[i] = nowMicros() - started;
+    }
+    closeLog();
+    printLatency(mode, samples, DURABILITY_CHECKOUTS, nowMicros() - begin);
+    removeScratch(dirname);
+    return 0;
+}
@@ -0,0 +1,95 @@
+/**
+ * @file bench_lookup.c
+ * @brief Benchmark of the product lookup by ID through the product hash index, against a linear
+ * scan of the product records, with catalogs of 100k and 1M products.
+ * Usage: bench_lookup [products ...], "100000 1000000" by default
+ */
+
+#define main pos_main
+#include "../pos.c"
+#undef main
+#include "bench.h"
+
+#define LOOKUP_COUNT 1000000 // lookups through the hash index
+#define LOOKUP_SCANS 1000 // lookups by linear scan
+
+int benchLookup(int productCount); // time the product lookups of one catalog size in a child process
+int runLookup(int productCount); // time the product lookups of one catalog size
+
+int main(int argc, char * argv[]) {
+    int i;
+    if (argc > 1) {
+        for (i = 1; i < argc; i++) {
+            if (benchLookup(atoi(argv[i])) != 0)
+                return 1;
+        }
+        return 0;
+    }
+    return benchLookup(100000) == 0 && benchLookup(1000000) == 0 ? 0 : 1;
+}
+/**
+ * @brief Time the product lookups of one catalog size in a child process, which starts with no
+ * records file mapped
+ *
+ * @param productCount count of products in the catalog
+ * @return int 0 - success | -1 error
+ */
+int benchLookup(int productCount) {
+    int status;
+    pid_t pid;
+    if ((pid = fork()) == 0)
+        exit(runLookup(productCount) == 0 ? 0 : 1);
+    if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return -1;
+    return 0;
+}
+/**
+ * @brief Time the product lookups of one catalog size in a new records directory
+ * The IDs are drawn at random, so most lookups miss the CPU caches
+ *
+ * @param productCount count of products in the catalog
+ * @return int 0 - success | -1 error
+ */
+int runLookup(int productCount) {
+    char dirname[] = "/tmp/pos-bench-XXXXXX";
+    const ProductRecord * products;
+    Product product;
+    unsigned int seed = 12345;
+    long long started, indexed, scanned;
+    int i, k, id, count, found = 0;
+    if (productCount < 1 || openScratch(dirname) != 0)
+        return -1;
+    setDurability("none");
+    if (writeProductCsv("products.csv", productCount) != 0 || openLog(joinLanes()) < 0 || runCsv("import", "products", "products.csv") != 0)
+        return -1;
+    getProductByID(&product, 1); // the catalog is mapped before the timing
+    started = nowMicros();
+    for (i = 0; i < LOOKUP_COUNT; i++) {
+        seed = seed * 1103515245 + 12345;
+        if (getProductByID(&product, 1 + (int)(seed % (unsigned int)productCount)) == 0)
+            found++;
+    }
+    indexed = nowMicros() - started;
+    count = refreshCatalog(&productCatalog);
+    products = productView.base;
+    started = nowMicros();
+    for (i = 0; i < LOOKUP_SCANS; i++) {
+        seed = seed * 1103515245 + 12345;
+        id = 1 + (int)(seed % (unsigned int)productCount);
+        for (k = 0; k < count && products[k].id != id; k++)
+            ;
+        if (k < count) {
+            loadProduct(&products[k], &product);
+            found++;
+        }
+    }
+    scanned = nowMicros() - started;
+    closeLog();
+    removeScratch(dirname);
+    if (found != LOOKUP_COUNT + LOOKUP_SCANS)
+        return -1;
+    printf("%8d products   hash index %8.0f ns/lookup %12.0f lookups/s   linear scan %10.0f ns/lookup   %8.1fx\n", productCount,
+        indexed * 1000.0 / LOOKUP_COUNT, indexed > 0 ? LOOKUP_COUNT * 1e6 / indexed : 0.0, scanned * 1000.0 / LOOKUP_SCANS,
+        indexed > 0 ? (scanned * 1.0 / LOOKUP_SCANS) / (indexed * 1.0 / LOOKUP_COUNT) : 0.0);
+    return 0;
+}
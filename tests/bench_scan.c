@@ -0,0 +1,130 @@
+/**
+ * @file bench_scan.c
+ * @brief Benchmark of the parallel scan of the revenue reports: a year of 10M line items is
+ * aggregated per product, per category and per day by scanSales() on one worker per core, and by
+ * a single-thread loop over the same segments, whose totals must match.
+ * Usage: bench_scan [line items, 10000000 by default]
+ */
+
+#define main pos_main
+#include "../pos.c"
+#undef main
+#include "bench.h"
+
+#define SCAN_MONTHS 12 // months of sales, one sale segment each
+#define SCAN_FILL_ITEMS 1000 // line items of each checkout filling the sales
+#define SCAN_PRODUCTS 1000 // products sold by the checkouts
+#define SCAN_RUNS 3 // runs of each scan, the fastest is shown
+
+long long scanSerial(const SaleScanner * scanner, void * total); // aggregate all the sales on the calling thread
+int benchScan(int kind, const char * label); // time the scans of one revenue report
+
+int main(int argc, char * argv[]) {
+    char dirname[] = "/tmp/pos-bench-XXXXXX";
+    long long count = argc > 1 ? atoll(argv[1]) : 10000000, now = (long long)time(NULL);
+    int month, failed;
+    if (count < SCAN_MONTHS || openScratch(dirname) != 0)
+        return 1;
+    setDurability("none");
+    if (writeProductCsv("products.csv", SCAN_PRODUCTS) != 0 || openLog(joinLanes()) < 0 || runCsv("import", "products", "products.csv") != 0)
+        return 1;
+    for (month = 0; month < SCAN_MONTHS; month++) { // about one month apart, the last one now
+        if (fillSales(count / SCAN_MONTHS + (month < count % SCAN_MONTHS), SCAN_FILL_ITEMS, SCAN_PRODUCTS,
+            now - (long long)(SCAN_MONTHS - 1 - month) * 30 * SECONDS_PER_DAY) != 0)
+            return 1;
+    }
+#ifdef __linux__
+    printf("%lld line items, %ld core(s)\n", count, sysconf(_SC_NPROCESSORS_ONLN));
+#endif
+    failed = benchScan(REPORT_PRODUCT, "revenue per product") != 0 || benchScan(REPORT_CATEGORY, "revenue per category") != 0
+        || benchScan(REPORT_DAY, "revenue per day") != 0;
+    closeLog();
+    if (failed) {
+        fprintf(stderr, "BENCHMARK FAILED, THE RECORDS FILES ARE KEPT IN %s.\n", dirname);
+        return 1;
+    }
+    removeScratch(dirname);
+    return 0;
+}
+/**
+ * @brief Aggregate all the sales on the calling thread, one segment at a time, as a baseline of scanSales()
+ *
+ * @param scanner aggregate computed
+ * @param total aggregate of scanner->partialSize bytes, zeroed by the caller
+ * @return long long count of line items scanned | -1 error
+ */
+long long scanSerial(const SaleScanner * scanner, void * total) {
+    SaleSegment * segments;
+    RecordView view;
+    char filename[MAX_NAME];
+    void * partial;
+    long long scanned = 0;
+    int i, count;
+    if ((segments = findSaleSegments(0, LLONG_MAX, &count)) == NULL || (partial = calloc(1, scanner->partialSize)) == NULL)
+        return -1;
+    for (i = 0; i < count; i++) {
+        memset(&view, 0, sizeof(view));
+        saleSegmentName(filename, SALESEGMENT, segments[i].month);
+        view.filename = filename;
+        view.recordsize = sizeof(SaleTransaction);
+        view.headersize = sizeof(RecordFileHeader);
+        view.magic = RECORD_MAGIC;
+        if (refreshRecordView(&view) > 0) {
+            scanner->scan(partial, view.base, view.count, scanner->context);
+            scanned += view.count;
+        }
+        closeRecordView(&view);
+    }
+    scanner->merge(total, partial, scanner->context);
+    free(partial);
+    return scanned;
+}
+/**
+ * @brief Time the scans of one revenue report over all the sales, on one thread and on the workers
+ * of scanSales(), and check that both give the same totals
+ *
+ * @param kind REPORT_PRODUCT | REPORT_CATEGORY | REPORT_DAY
+ * @param label name of the row
+ * @return int 0 - success | -1 error or different totals
+ */
+int benchScan(int kind, const char * label) {
+    RevenueReport report;
+    SaleScanner scanner;
+    RevenueTotal * serial, * parallel;
+    const char ** names = NULL;
+    long long started, serialTime = LLONG_MAX, parallelTime = LLONG_MAX, scanned = 0;
+    size_t size;
+    int run;
+    arenaReset(&recordArena);
+    if (prepareRevenueReport(&report, kind, 0, LLONG_MAX, &names) != 0)
+        return -1;
+    size = (report.keyCount + 1) * sizeof(RevenueTotal);
+    scanner.partialSize = report.keyCount * sizeof(RevenueTotal);
+    scanner.scan = kind == REPORT_PRODUCT ? scanProductRevenue : kind == REPORT_CATEGORY ? scanCategoryRevenue : scanDailyRevenue;
+    scanner.merge = mergeRevenue;
+    scanner.context = &report;
+    if ((serial = malloc(size)) == NULL || (parallel = malloc(size)) == NULL)
+        return -1;
+    for (run = 0; run < SCAN_RUNS; run++) {
+        memset(serial, 0, size);
+        started = nowMicros();
+        scanned = scanSerial(&scanner, serial);
+        if (nowMicros() - started < serialTime)
+            serialTime = nowMicros() - started;
+        memset(parallel, 0, size);
+        started = nowMicros();
+        if (scanSales(0, LLONG_MAX, &scanner, parallel) != scanned || scanned < 0) {
+            free(serial);
+            free(parallel);
+            return -1;
+        }
+        if (nowMicros() - started < parallelTime)
+            parallelTime = nowMicros() - started;
+    }
+    run = memcmp(serial, parallel, size) == 0 ? 0 : -1;
+    printf("%-24s 1 thread %8.1f ms   scanSales %8.1f ms   %5.2fx%s\n", label, serialTime / 1000.0, parallelTime / 1000.0,
+        parallelTime > 0 ? (double)serialTime / parallelTime : 0.0, run == 0 ? "" : "   TOTALS DIFFER");
+    free(serial);
+    free(parallel);
+    return run;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file bench_server.c
+ * @brief Benchmark of the round trips of a lane to the POS server: product lookups by ID and
+ * 3-item checkouts over the Unix domain socket, with a catalog of 100k products.
+ * Usage: bench_server [products, 100000 by default]
+ */
+
+#define main pos_main
+#include "../pos.c"
+#undef main
+#include "bench.h"
+
+#define SERVER_LOOKUPS 200000 // product lookups timed
+#define SERVER_CHECKOUTS 2000 // checkouts timed
+#define SERVER_ITEMS 3 // line items of each checkout
+#define SERVER_WAIT_MS 5000 // longest wait for the server to listen
+
+int main(int argc, char * argv[]) {
+    char dirname[] = "/tmp/pos-bench-XXXXXX";
+    char * import[] = { "pos", "--durability", "none", "import", "products", "products.csv", NULL };
+    char * serve[] = { "pos", "--serve", NULL };
+    long long * samples, started, begin;
+    unsigned int seed = 12345;
+    int i, productCount = argc > 1 ? atoi(argv[1]) : 100000, status, failed = 0;
+    Product product;
+    pid_t server;
+    if (productCount < 1 || (samples = malloc(SERVER_LOOKUPS * sizeof(long long))) == NULL || openScratch(dirname) != 0)
+        return 1;
+    if (writeProductCsv("products.csv", productCount) != 0 || runPos(import) != 0)
+        return 1;
+    if ((server = fork()) == 0)
+        exit(pos_main(2, serve));
+    for (started = nowMillis(); server > 0 && (serverFd = connectServer(SERVERSOCKET)) < 0 && nowMillis() - started < SERVER_WAIT_MS; )
+        usleep(10000);
+    if (serverFd < 0) {
+        fprintf(stderr, "CANNOT CONNECT TO THE POS SERVER.\n");
+        return 1;
+    }
+    begin = nowMicros();
+    for (i = 0; i < SERVER_LOOKUPS && !failed; i++) {
+        seed = seed * 1103515245 + 12345;
+        started = nowMicros();
+        failed = requestServer(SERVER_PRODUCT, 1 + (int)(seed % (unsigned int)productCount), NULL, 0, &product, sizeof(Product)) != 0;
+        samples[i] = nowMicros() - started;
+    }
+    printLatency("lookup", samples, i, nowMicros() - begin);
+    begin = nowMicros();
+    for (i = 0; i < SERVER_CHECKOUTS && !failed; i++) {
+        started = nowMicros();
+        failed = fillSales(SERVER_ITEMS, SERVER_ITEMS, productCount, 0) != 0;
+        samples[i] = nowMicros() - started;
+    }
+    printLatency("checkout, fsync", samples, i, nowMicros() - begin);
+    disconnectServer();
+    kill(server, SIGTERM);
+    if (waitpid(server, &status, 0) != server || !WIFEXITED(status) || WEXITSTATUS(status) != 0 || failed) {
+        fprintf(stderr, "BENCHMARK FAILED, THE RECORDS FILES ARE KEPT IN %s.\n", dirname);
+        return 1;
+    }
+    removeScratch(dirname);
+    free(samples);
+    return 0;
+}
@@ -0,0 +1,357 @@
+/**
+ * @file stress_lanes.c
+ * @brief Stress test of concurrent lanes: several processes check out sales and add products to the
+ * same records files at once, then the files are checked for lost, duplicated or torn records.
+ * The even lanes check out through a POS server and look up the products through it, while a batch
+ * lane adds, updates and deletes products and tellers with batch files.
+ * Usage: stress_lanes [lanes [fsync|group[:ms[:count]]|none]]
+ * The test runs in a new directory under /tmp, removed if the test passes.
+ */
+
+#define main pos_main
+#include "../pos.c"
+#undef main
+#include "bench.h"
+
+#define STRESS_LANES 8 // lanes run at once by default
+#define STRESS_SALES 200 // checkouts of each lane
+#define STRESS_ITEMS 3 // line items of each checkout
+#define STRESS_PRODUCT_EVERY 20 // a lane adds a product after this many checkouts
+#define STRESS_BATCH_PRODUCTS 40 // products added by the batch lane, the even ones are then updated and every fourth deleted
+#define STRESS_BATCH_TELLERS 10 // tellers added by the batch lane, updated and deleted like its products
+#define STRESS_WAIT_MS 5000 // longest wait for the POS server to listen
+
+int runLane(int lane); // check out the sales and add the products of one lane
+int runBatchLane(void); // add, update and delete products and tellers with batch files
+int checkProduct(const char * name, const char * description); // check that a product was written whole
+int batchSurvives(int k); // tell if the batch lane keeps its product or teller k
+int batchKept(int count); // count of the products or tellers kept by the batch lane
+int checkLanes(int lanes); // check the records written by all the lanes
+int compareInts(const void * a, const void * b); // order ints (qsort comparator)
+int countDuplicates(int * ids, int count); // count the repeated IDs
+
+int main(int argc, char * argv[]) {
+    char dirname[] = "/tmp/pos-stress-XXXXXX";
+    char * serve[] = { "pos", "--durability", argc > 2 ? argv[2] : "fsync", "--serve", NULL };
+    int i, lanes = argc > 1 ? atoi(argv[1]) : STRESS_LANES, status, running = 0, fd = -1, failed = 0;
+    long long started;
+    pid_t pid, server;
+    if (lanes < 1 || (argc > 2 && setDurability(argv[2]) != 0)) {
+        fprintf(stderr, "Usage: %s [lanes [fsync|group[:ms[:count]]|none]]\n", argv[0]);
+        return 2;
+    }
+    if (openScratch(dirname) != 0)
+        return 1;
+    if ((server = fork()) == 0)
+        exit(pos_main(4, serve));
+    for (started = nowMillis(); server > 0 && (fd = connectServer(SERVERSOCKET)) < 0 && nowMillis() - started < STRESS_WAIT_MS; )
+        usleep(10000);
+    if (fd < 0) {
+        fprintf(stderr, "CANNOT CONNECT TO THE POS SERVER.\n");
+        return 1;
+    }
+    close(fd); // each lane of the server connects on its own
+    for (i = 0; i <= lanes; i++) { // lane 0 is the batch lane
+        if ((pid = fork()) == 0)
+            exit((i == 0 ? runBatchLane() : runLane(i)) == 0 ? 0 : 1);
+        if (pid < 0) {
+            fprintf(stderr, "CANNOT START LANE %d.\n", i);
+            failed = 1;
+        }
+        else
+            running++;
+    }
+    while (running > 0 && (pid = wait(&status)) > 0) {
+        if (pid == server) {
+            fprintf(stderr, "THE POS SERVER STOPPED BEFORE THE LANES.\n");
+            server = -1;
+            failed = 1;
+            continue;
+        }
+        running--;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed = 1;
+    }
+    if (server > 0 && (kill(server, SIGTERM) != 0 || waitpid(server, &status, 0) != server || !WIFEXITED(status) || WEXITSTATUS(status) != 0)) {
+        fprintf(stderr, "THE POS SERVER DID NOT STOP CLEANLY.\n");
+        failed = 1;
+    }
+    if (failed || checkLanes(lanes) != 0) {
+        fprintf(stderr, "STRESS TEST FAILED, THE RECORDS FILES ARE KEPT IN %s.\n", dirname);
+        return 1;
+    }
+    removeScratch(dirname);
+    printf("%d lanes and a batch lane: %d checkouts, %d products and %d tellers written without loss.\n", lanes, lanes * STRESS_SALES,
+        lanes * (STRESS_SALES / STRESS_PRODUCT_EVERY) + batchKept(STRESS_BATCH_PRODUCTS), batchKept(STRESS_BATCH_TELLERS));
+    return 0;
+}
+/**
+ * @brief Check out the sales and add the products of one lane, each in its own transaction
+ * An even lane allocates its sale IDs, checks out and looks up a product after each checkout through the POS server
+ *
+ * @param lane lane number, stored as the teller ID of its checkouts
+ * @return int 0 - success | -1 error
+ */
+int runLane(int lane) {
+    SaleHeader sale;
+    SaleTransaction items[STRESS_ITEMS];
+    Product product;
+    int i, k, first;
+    if (openLog(joinLanes()) < 0) // no redo while the lanes started first are running
+        return -1;
+    if (lane % 2 == 0 && (serverFd = connectServer(SERVERSOCKET)) < 0) {
+        fprintf(stderr, "LANE %d: CANNOT CONNECT TO THE POS SERVER.\n", lane);
+        return -1;
+    }
+    for (i = 0; i < STRESS_SALES; i++) {
+        if ((first = allocateSaleIDs(STRESS_ITEMS + 1)) < 0) {
+            fprintf(stderr, "LANE %d: CANNOT ALLOCATE THE IDS OF SALE %d.\n", lane, i);
+            return -1;
+        }
+        memset(&sale, 0, sizeof(sale));
+        sale.id = first;
+        sale.teller_id = lane;
+        sale.timestamp = (long long)time(NULL);
+        for (k = 0; k < STRESS_ITEMS; k++) {
+            memset(&items[k], 0, sizeof(items[k]));
+            items[k].id = first + 1 + k;
+            items[k].product_id = 1 + k;
+            items[k].quantity = 1;
+            items[k].unit_price = 100;
+            items[k].timestamp = sale.timestamp;
+            sale.total += items[k].unit_price;
+        }
+        if (checkoutSale(&sale, items, STRESS_ITEMS) != 0) {
+            fprintf(stderr, "LANE %d: CANNOT CHECK OUT SALE %d.\n", lane, i);
+            return -1;
+        }
+        // the server sees the products added and edited by the other lanes; an ID not stored yet or deleted is not found
+        if (serverFd >= 0 && requestServer(SERVER_PRODUCT, 1 + i % (STRESS_BATCH_PRODUCTS + STRESS_SALES / STRESS_PRODUCT_EVERY), NULL, 0, &product, sizeof(product)) == 0
+            && checkProduct(product.name, product.description) != 0) {
+            fprintf(stderr, "LANE %d: THE POS SERVER RETURNED THE TORN PRODUCT %d.\n", lane, product.id);
+            return -1;
+        }
+        if (i % STRESS_PRODUCT_EVERY == 0) {
+            memset(&product, 0, sizeof(product));
+            product.id = allocateID(PRODUCTRECORDS, sizeof(ProductRecord), 1);
+            snprintf(product.name, sizeof(product.name), "Lane %d item %d", lane, i);
+            snprintf(product.description, sizeof(product.description), "desc %d/%d", lane, i);
+            strcpy(product.category, "stress");
+            strcpy(product.unit, "pc");
+            product.unit_price = 100;
+            if (product.id < 0 || storeProduct(&product, -1) != 0) {
+                fprintf(stderr, "LANE %d: CANNOT ADD PRODUCT %d.\n", lane, i);
+                return -1;
+            }
+        }
+    }
+    if (lane % 2 == 0 && serverFd < 0) {
+        fprintf(stderr, "LANE %d: LOST CONNECTION TO THE POS SERVER.\n", lane);
+        return -1;
+    }
+    disconnectServer();
+    closeLog();
+    return 0;
+}
+/**
+ * @brief Add products and tellers with a first batch file, then update and delete some of them with a second one
+ * The second file needs the IDs given by the first, read back from the records files
+ *
+ * @return int 0 - success | -1 error
+ */
+int runBatchLane(void) {
+    FILE * fp;
+    const ProductRecord * products;
+    const TellerRecord * tellers;
+    int i, k, count;
+    if (openLog(joinLanes()) < 0)
+        return -1;
+    if ((fp = fopen("batch_add.txt", "w")) == NULL)
+        return -1;
+    for (k = 0; k < STRESS_BATCH_PRODUCTS; k++)
+        fprintf(fp, "product add Batch item %d|batch %d|stress|pc|1.00\n", k, k);
+    for (k = 0; k < STRESS_BATCH_TELLERS; k++)
+        fprintf(fp, "teller add Batch|%d|Teller\n", k);
+    if (fclose(fp) != 0 || runBatch("batch_add.txt") != 0 || (fp = fopen("batch_edit.txt", "w")) == NULL)
+        return -1;
+    count = refreshRecordView(&productView);
+    refreshRecordView(&productStringView);
+    products = productView.base;
+    for (i = 0; i < count; i++) {
+        if (products[i].id == DELETED_ID || sscanf(productString(products[i].name), "Batch item %d", &k) != 1)
+            continue;
+        if (!batchSurvives(k))
+            fprintf(fp, "product delete %d\n", products[i].id);
+        else if (k % 2 == 0)
+            fprintf(fp, "product update %d|Batch item %d|batch %d updated|stress|pc|2.00\n", products[i].id, k, k);
+    }
+    count = refreshRecordView(&tellerView);
+    refreshRecordView(&tellerStringView);
+    tellers = tellerView.base;
+    for (i = 0; i < count; i++) {
+        if (tellers[i].id == DELETED_ID || sscanf(tellerString(tellers[i].middle_name), "%d", &k) != 1)
+            continue;
+        if (!batchSurvives(k))
+            fprintf(fp, "teller delete %d\n", tellers[i].id);
+        else if (k % 2 == 0)
+            fprintf(fp, "teller update %d|Batch|%d|Updated\n", tellers[i].id, k);
+    }
+    if (fclose(fp) != 0 || runBatch("batch_edit.txt") != 0)
+        return -1;
+    closeLog();
+    return 0;
+}
+/**
+ * @brief Check that a product was written whole, its description matching its name
+ *
+ * @param name name of the product
+ * @param description description of the product
+ * @return int 0 - whole | -1 torn or not written by the test
+ */
+int checkProduct(const char * name, const char * description) {
+    char expected[MAX_NAME];
+    int lane, sale, k;
+    if (sscanf(name, "Lane %d item %d", &lane, &sale) == 2)
+        snprintf(expected, sizeof(expected), "desc %d/%d", lane, sale);
+    else if (sscanf(name, "Batch item %d", &k) == 1 && k % 2 == 0 && strstr(description, "updated") != NULL)
+        snprintf(expected, sizeof(expected), "batch %d updated", k);
+    else if (sscanf(name, "Batch item %d", &k) == 1)
+        snprintf(expected, sizeof(expected), "batch %d", k);
+    else
+        return -1;
+    return strcmp(expected, description) == 0 ? 0 : -1;
+}
+/**
+ * @brief Tell if the batch lane keeps its product or teller k, every fourth one is deleted
+ *
+ * @param k number of the product or teller in the batch files
+ * @return int 1 - kept | 0 - deleted
+ */
+int batchSurvives(int k) {
+    return k % 4 != 1;
+}
+/**
+ * @brief Count the products or tellers kept by the batch lane
+ *
+ * @param count count of products or tellers added by the batch lane
+ * @return int count of those not deleted
+ */
+int batchKept(int count) {
+    int k, kept = 0;
+    for (k = 0; k < count; k++)
+        kept += batchSurvives(k);
+    return kept;
+}
+/**
+ * @brief Check that the records written by all the lanes are there once each and not torn, and that
+ * the batch edits were all applied
+ *
+ * @param lanes count of lanes run
+ * @return int 0 - passed | -1 failed
+ */
+int checkLanes(int lanes) {
+    RecordView view;
+    DIR * dir;
+    struct dirent * entry;
+    const ProductRecord * products;
+    const TellerRecord * tellers;
+    char expected[MAX_NAME];
+    int * ids, i, k, n, count, isHeader, headers = 0, items = 0, duplicates, torn = 0, productCount, tellerCount = 0, nextID;
+    int sales = lanes * STRESS_SALES, productTotal = lanes * (STRESS_SALES / STRESS_PRODUCT_EVERY) + batchKept(STRESS_BATCH_PRODUCTS);
+    int tellerTotal = batchKept(STRESS_BATCH_TELLERS);
+    if (openLog(joinLanes()) < 0 || (ids = malloc(sizeof(int) * (size_t)(sales * (STRESS_ITEMS + 1) + productTotal))) == NULL)
+        return -1;
+    if ((dir = opendir(".")) == NULL) {
+        free(ids);
+        return -1;
+    }
+    n = 0;
+    while ((entry = readdir(dir)) != NULL) { // the sale IDs of every header and line item, from every segment
+        isHeader = strncmp(entry->d_name, "sale_headers_", 13) == 0;
+        if (!isHeader && strncmp(entry->d_name, "sale_records_", 13) != 0)
+            continue;
+        memset(&view, 0, sizeof(view));
+        view.filename = entry->d_name;
+        view.recordsize = isHeader ? sizeof(SaleHeader) : sizeof(SaleTransaction);
+        view.headersize = sizeof(RecordFileHeader);
+        view.magic = RECORD_MAGIC;
+        count = refreshRecordView(&view);
+        for (i = 0; i < count && n < sales * (STRESS_ITEMS + 1); i++)
+            ids[n++] = *(const int *)((const char *)view.base + (size_t)i * view.recordsize);
+        if (isHeader)
+            headers += count;
+        else
+            items += count;
+        closeRecordView(&view);
+    }
+    closedir(dir);
+    duplicates = countDuplicates(ids, n);
+    count = refreshRecordView(&productView);
+    refreshRecordView(&productStringView);
+    products = productView.base;
+    for (i = n = 0; i < count; i++) {
+        if (products[i].id == DELETED_ID)
+            continue; // deleted by the batch lane
+        if (n == productTotal) {
+            torn++; // a deleted product is still there
+            continue;
+        }
+        ids[n++] = products[i].id;
+        if (sscanf(productString(products[i].name), "Batch item %d", &k) == 1) { // the update of an even product must not be lost
+            snprintf(expected, sizeof(expected), "batch %d%s", k, k % 2 == 0 ? " updated" : "");
+            if (!batchSurvives(k) || strcmp(expected, productString(products[i].description)) != 0)
+                torn++;
+        }
+        else if (checkProduct(productString(products[i].name), productString(products[i].description)) != 0)
+            torn++;
+    }
+    productCount = n;
+    duplicates += countDuplicates(ids, n);
+    count = refreshRecordView(&tellerView);
+    refreshRecordView(&tellerStringView);
+    tellers = tellerView.base;
+    for (i = 0; i < count; i++) {
+        if (tellers[i].id == DELETED_ID)
+            continue;
+        tellerCount++;
+        if (sscanf(tellerString(tellers[i].middle_name), "%d", &k) != 1 || !batchSurvives(k) || strcmp(tellerString(tellers[i].first_name), "Batch") != 0
+            || strcmp(tellerString(tellers[i].last_name), k % 2 == 0 ? "Updated" : "Teller") != 0)
+            torn++;
+    }
+    free(ids);
+    refreshRecordView(&saleSegmentView);
+    nextID = saleSegmentView.header != NULL ? saleSegmentView.header->next_id : 0;
+    printf("headers %d items %d products %d tellers %d duplicates %d torn %d next sale ID %d\n", headers, items, productCount, tellerCount, duplicates, torn, nextID);
+    if (headers != sales || items != sales * STRESS_ITEMS || productCount != productTotal || tellerCount != tellerTotal || duplicates != 0 || torn != 0
+        || nextID != sales * (STRESS_ITEMS + 1) + 1 || checkSaleAggregates() != 0)
+        return -1;
+    closeLog();
+    return 0;
+}
+/**
+ * @brief Order ints (qsort comparator)
+ *
+ * @param a int
+ * @param b int
+ * @return int negative, 0 or positive as a is before, the same as or after b
+ */
+int compareInts(const void * a, const void * b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return x < y ? -1 : x > y;
+}
+/**
+ * @brief Count the repeated IDs
+ *
+ * @param ids IDs, sorted in place
+ * @param count count of IDs
+ * @return int count of IDs equal to the one before them
+ */
+int countDuplicates(int * ids, int count) {
+    int i, duplicates = 0;
+    qsort(ids, count, sizeof(int), compareInts);
+    for (i = 1; i < count; i++) {
+        if (ids[i] == ids[i - 1])
+            duplicates++;
+    }
+    return duplicates;
+}